@@ -0,0 +1,87 @@
+/* force evaluations of hermite with block time steps against the same
+ * integrator with one shared step, on the solar system. the shared run
+ * takes the smallest step any body asks for, the block run gives every
+ * body its own. both draw a frame every day, and a yoshida run at a ten
+ * minute step is the reference the errors are measured against: the worst
+ * position error of a planet relative to its distance from the sun and the
+ * moon's relative to its distance from the earth. leapfrog and yoshida at
+ * fixed steps of an hour and six hours are there for scale, their eta
+ * column is the step in hours
+ *
+ * usage: block_bench [years] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/integrator.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+struct block_run{
+	body_arrays b;
+	long long forces = 0;
+	long long blocks = 0;
+	double energy_error = 0;
+	double ms = 0;
+};
+
+/* eta only matters to the block scheme, frame is the step of the others */
+block_run run(int kind, double eta, bool shared, double frame, double span){
+	block_run r;
+	generate_solar_system(r.b);
+	gravity_solver g(1);
+	g.kind = GRAVITY_DIRECT;
+	integrator in;
+	in.kind = kind;
+	in.blocks.eta = eta;
+	in.blocks.shared = shared;
+	double e0 = total_energy(r.b, g.G);
+	long long frames = (long long)std::llround(span / frame);
+	auto t0 = std::chrono::steady_clock::now();
+	for(long long f=0;f<frames;f++){
+		in.step(r.b, g, frame);
+		r.energy_error = std::max(r.energy_error, std::fabs((total_energy(r.b, g.G) - e0) / e0));
+	}
+	r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	r.forces = in.forces;
+	r.blocks = in.blocks.blocks;
+	return r;
+}
+
+int main(int argc, char** argv){
+	double years = argc > 1 ? std::atof(argv[1]) : 1.0;
+	/* whole days, so the reference ends where the frames do */
+	double span = std::round(years * 365.25) * 86400.0;
+
+	block_run ref = run(INTEGRATOR_YOSHIDA4, 0, false, 600.0, span);
+	std::cout << "solar system, " << years << " years, frames of a day, reference yoshida4 at 600 s" << std::endl;
+	std::cout << "steps      eta   forces     blocks   max |dE/E|  planet error  moon error      ms" << std::endl;
+	auto report = [&](const char* name, const block_run& r, double eta){
+		double planet = 0;
+		for(int i=1;i<9;i++){
+			double dx = r.b.x[i] - ref.b.x[i], dy = r.b.y[i] - ref.b.y[i];
+			double rx = ref.b.x[i] - ref.b.x[0], ry = ref.b.y[i] - ref.b.y[0];
+			planet = std::max(planet, std::sqrt((dx*dx + dy*dy) / (rx*rx + ry*ry)));
+		}
+		double mx = (r.b.x[9] - r.b.x[3]) - (ref.b.x[9] - ref.b.x[3]);
+		double my = (r.b.y[9] - r.b.y[3]) - (ref.b.y[9] - ref.b.y[3]);
+		double rx = ref.b.x[9] - ref.b.x[3], ry = ref.b.y[9] - ref.b.y[3];
+		double moon = std::sqrt((mx*mx + my*my) / (rx*rx + ry*ry));
+		std::cout << std::setw(8) << std::left << name << std::right << "  "
+			<< std::setw(5) << std::fixed << std::setprecision(3) << eta << "  "
+			<< std::setw(7) << r.forces << "  " << std::setw(9) << r.blocks << "  "
+			<< std::scientific << std::setprecision(2) << std::setw(10) << r.energy_error << "  "
+			<< std::setw(12) << planet << "  " << std::setw(10) << moon << "  "
+			<< std::fixed << std::setprecision(1) << std::setw(6) << r.ms << std::endl;
+	};
+	for(double hours : {1.0, 6.0}){
+		report("leapfrog", run(INTEGRATOR_LEAPFROG, 0, false, hours * 3600.0, span), hours);
+		report("yoshida4", run(INTEGRATOR_YOSHIDA4, 0, false, hours * 3600.0, span), hours);
+	}
+	for(double eta : {0.005, 0.01, 0.02, 0.04}){
+		report("shared", run(INTEGRATOR_BLOCK, eta, true, 86400.0, span), eta);
+		report("block", run(INTEGRATOR_BLOCK, eta, false, 86400.0, span), eta);
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+/* pair interactions per second of the direct sum with every kernel this
+ * cpu runs, for a range of body counts, and the worst relative difference
+ * of an acceleration to the scalar kernel's. the bodies are the disk of
+ * gravity_bench
+ *
+ * usage: direct_bench [threads] [max bodies] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int threads = argc > 1 ? std::atoi(argv[1]) : 1;
+	int most = argc > 2 ? std::atoi(argv[2]) : 16000;
+	thread_pool pool(threads);
+	const double G = 6.674e-11;
+
+	std::cout << pool.size() << " threads, best kernel " << simd_level_name(simd_best()) << std::endl;
+	std::cout << "bodies  kernel   ms/pass  pairs/s   speedup  max rel error" << std::endl;
+	for(int n=1000;n<=most;n*=4){
+		disk_params params;
+		params.bodies = n - 1;
+		params.mass = 1e24;
+		params.center_mass = 10.0 * n * 1e24;
+		params.r_in = 1e10;
+		body_arrays b;
+		generate_disk(b, params);
+		double pairs = (double)n * (n - 1);
+		/* enough repeats for about a billion pairs */
+		int repeats = std::max(1, (int)(1e9 / pairs));
+
+		std::vector<double> ax, ay;
+		double scalar_ms = 0;
+		for(int level=0;level<SIMD_COUNT;level++){
+			if(!simd_supported(level)) continue;
+			direct_gravity(b, pool, G, 0, level);
+			auto t0 = std::chrono::steady_clock::now();
+			for(int r=0;r<repeats;r++) direct_gravity(b, pool, G, 0, level);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / repeats;
+			double error = 0;
+			if(level == SIMD_SCALAR){
+				ax = b.ax; ay = b.ay;
+				scalar_ms = ms;
+			}
+			for(int i=0;i<n;i++){
+				double dx = b.ax[i] - ax[i], dy = b.ay[i] - ay[i];
+				error = std::max(error, std::sqrt((dx*dx + dy*dy) / (ax[i]*ax[i] + ay[i]*ay[i])));
+			}
+			std::cout << std::setw(6) << n << "  " << std::setw(6) << std::left << simd_level_name(level) << std::right << "  "
+				<< std::setw(8) << std::fixed << std::setprecision(2) << ms << "  "
+				<< std::scientific << std::setprecision(2) << pairs / (ms * 1e-3) << "  "
+				<< std::fixed << std::setw(7) << scalar_ms / ms << "  "
+				<< std::scientific << std::setw(13) << error << std::endl;
+		}
+	}
+	return 0;
+}
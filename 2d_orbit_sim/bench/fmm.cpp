@@ -0,0 +1,128 @@
+/* the fast multipole method against the exact sum and the barnes-hut
+ * tree. first the error at every expansion order on one disk, then the
+ * cost per body from 10k bodies up, at order 8 and the tree at theta 0.5.
+ * the errors are those of bodies 1 to 2000, whose exact accelerations are
+ * summed directly, relative to their size: rms, 99th percentile and
+ * worst. the bodies are the disk of gravity_bench, body 0 is its center,
+ * where the pull of the disk nearly cancels.
+ *
+ * the worst errors sit next to the center. its pull reaches the cells
+ * around it through one local expansion, so there the error is the bound
+ * theta^(order + 1) of a single m2l rather than a sum of small ones. the
+ * more bodies, the finer the cells near the center and the more often
+ * that happens
+ *
+ * usage: fmm_bench [bodies] [max bodies] [threads] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+struct sample_error{
+	double rms, p99, max;
+};
+
+void make_disk(body_arrays& b, int n){
+	disk_params params;
+	params.bodies = n - 1;
+	params.mass = 1e24;
+	params.center_mass = 10.0 * n * 1e24;
+	params.r_in = 1e10;
+	generate_disk(b, params);
+}
+
+/* exact accelerations of the sample, the disk is random so the first
+ * bodies are a fair one. index 0 stays unused */
+void reference(const body_arrays& b, std::vector<double>& ax, std::vector<double>& ay, double G){
+	int k = std::min(2001, b.size());
+	ax.assign(k, 0.0);
+	ay.assign(k, 0.0);
+	gravity_block(b.x.data(), b.y.data(), 1, k, b.x.data(), b.y.data(), b.m.data(), 0, b.size(), ax.data(), ay.data(), 0, simd_best());
+	for(int i=1;i<k;i++){
+		ax[i] *= G;
+		ay[i] *= G;
+	}
+}
+
+sample_error error_of(const body_arrays& b, const std::vector<double>& ax, const std::vector<double>& ay){
+	std::vector<double> e(ax.size() - 1);
+	double sum = 0;
+	for(int i=1;i<(int)ax.size();i++){
+		double dx = b.ax[i] - ax[i], dy = b.ay[i] - ay[i];
+		e[i - 1] = std::sqrt((dx*dx + dy*dy) / (ax[i]*ax[i] + ay[i]*ay[i]));
+		sum += e[i - 1] * e[i - 1];
+	}
+	std::sort(e.begin(), e.end());
+	return {std::sqrt(sum / e.size()), e[(size_t)(0.99 * (e.size() - 1))], e.back()};
+}
+
+double time_pass(gravity_solver& solver, body_arrays& b){
+	solver.accelerations(b);
+	auto t0 = std::chrono::steady_clock::now();
+	solver.accelerations(b);
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 50000;
+	int most = argc > 2 ? std::atoi(argv[2]) : 1000000;
+	int threads = argc > 3 ? std::atoi(argv[3]) : 0;
+
+	gravity_solver solver(threads);
+	body_arrays b;
+	std::vector<double> ax, ay;
+	make_disk(b, n);
+	reference(b, ax, ay, solver.G);
+	solver.kind = GRAVITY_DIRECT;
+	double direct_ms = time_pass(solver, b);
+
+	std::cout << b.size() << " bodies, " << solver.pool.size() << " threads, direct " << std::fixed << std::setprecision(1) << direct_ms << " ms" << std::endl;
+	std::cout << "kind   order  ms/pass      m2l        p2p  rms error  p99 error  max error" << std::endl;
+	auto row = [&](const char* name, int order, double ms, long long m2l, long long p2p){
+		sample_error e = error_of(b, ax, ay);
+		std::cout << std::setw(5) << std::left << name << std::right << "  " << std::setw(5);
+		if(order > 0) std::cout << order;
+		else std::cout << "-";
+		std::cout << "  " << std::fixed << std::setprecision(2) << std::setw(7) << ms << "  "
+			<< std::setw(7) << m2l << "  " << std::setw(9) << p2p << "  "
+			<< std::scientific << std::setw(9) << e.rms << "  " << std::setw(9) << e.p99 << "  " << std::setw(9) << e.max << std::endl;
+	};
+	solver.kind = GRAVITY_TREE;
+	for(double theta : {0.5, 0.3}){
+		solver.tree.theta = theta;
+		double ms = time_pass(solver, b);
+		row(theta == 0.5 ? "bh.5" : "bh.3", 0, ms, 0, solver.interactions);
+	}
+	solver.kind = GRAVITY_FMM;
+	for(int order=2;order<=16;order+=2){
+		solver.fmm.order = order;
+		double ms = time_pass(solver, b);
+		row("fmm", order, ms, solver.fmm.m2l, solver.fmm.p2p);
+	}
+
+	solver.fmm.order = 8;
+	solver.tree.theta = 0.5;
+	std::cout << std::endl << "fmm order 8 against the tree at theta 0.5" << std::endl;
+	std::cout << " bodies   fmm ms  us/body  rms error    bh ms  us/body  rms error" << std::endl;
+	for(int size=10000;size<=most;size*=10){
+		make_disk(b, size);
+		reference(b, ax, ay, solver.G);
+		solver.kind = GRAVITY_FMM;
+		double fmm_ms = time_pass(solver, b);
+		sample_error fmm_error = error_of(b, ax, ay);
+		solver.kind = GRAVITY_TREE;
+		double bh_ms = time_pass(solver, b);
+		sample_error bh_error = error_of(b, ax, ay);
+		std::cout << std::setw(7) << size << "  " << std::fixed << std::setprecision(1)
+			<< std::setw(7) << fmm_ms << "  " << std::setprecision(2) << std::setw(7) << 1e3 * fmm_ms / size << "  "
+			<< std::scientific << std::setw(9) << fmm_error.rms << "  " << std::fixed << std::setprecision(1)
+			<< std::setw(7) << bh_ms << "  " << std::setprecision(2) << std::setw(7) << 1e3 * bh_ms / size << "  "
+			<< std::scientific << std::setw(9) << bh_error.rms << std::endl;
+	}
+	return 0;
+}
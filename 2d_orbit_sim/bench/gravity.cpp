@@ -0,0 +1,73 @@
+/* ms per force pass of the barnes-hut tree for a range of opening angles,
+ * against the exact direct sum on the same bodies. the error is the
+ * relative difference of every body's acceleration to the direct one, as
+ * rms, 99th percentile and worst over all bodies.
+ *
+ * the disk weighs a tenth of its center, so it still adds a good part of
+ * every force. an annulus as heavy as its center cancels most of the
+ * center's pull, and the small rest makes relative errors look huge
+ *
+ * usage: gravity_bench [bodies] [threads] [repeats] [seed] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+	int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+	int repeats = argc > 3 ? std::atoi(argv[3]) : 3;
+	unsigned seed = argc > 4 ? (unsigned)std::atoi(argv[4]) : 1234;
+
+	disk_params params;
+	params.bodies = n;
+	params.seed = seed;
+	params.mass = 1e24;
+	params.center_mass = 10.0 * n * 1e24;
+	params.r_in = 1e10;
+	body_arrays b;
+	generate_disk(b, params);
+
+	gravity_solver solver(threads);
+	auto time = [&](){
+		auto t0 = std::chrono::steady_clock::now();
+		for(int r=0;r<repeats;r++) solver.accelerations(b);
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / repeats;
+	};
+
+	solver.kind = GRAVITY_DIRECT;
+	double direct_ms = time();
+	std::vector<double> ax = b.ax, ay = b.ay;
+
+	std::cout << b.size() << " bodies, " << solver.pool.size() << " threads, " << repeats << " repeats" << std::endl;
+	std::cout << "kind    theta  ms/pass  speedup  terms/body  rms error  p99 error  max error" << std::endl;
+	std::cout << "direct      -  " << std::setw(7) << std::fixed << std::setprecision(2) << direct_ms
+		<< "     1.00  " << std::setw(10) << b.size() - 1 << "          0          0          0" << std::endl;
+
+	solver.kind = GRAVITY_TREE;
+	for(double theta : {0.2, 0.3, 0.5, 0.7, 1.0}){
+		solver.tree.theta = theta;
+		double ms = time();
+		std::vector<double> errors(b.size());
+		double sum = 0;
+		for(int i=0;i<b.size();i++){
+			double dx = b.ax[i] - ax[i], dy = b.ay[i] - ay[i];
+			errors[i] = std::sqrt((dx*dx + dy*dy) / (ax[i]*ax[i] + ay[i]*ay[i]));
+			sum += errors[i] * errors[i];
+		}
+		std::sort(errors.begin(), errors.end());
+		std::cout << "tree   " << std::setw(5) << std::setprecision(1) << theta << "  "
+			<< std::setw(7) << std::setprecision(2) << ms << "  "
+			<< std::setw(7) << direct_ms / ms << "  "
+			<< std::setw(10) << std::setprecision(0) << (double)solver.interactions / b.size() << "  "
+			<< std::scientific << std::setprecision(2) << std::sqrt(sum / b.size()) << "   "
+			<< errors[(size_t)(0.99 * (errors.size() - 1))] << "   " << errors.back()
+			<< std::fixed << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,82 @@
+/* accuracy of every integrator on the solar system for a range of time
+ * steps. a yoshida run at a ten minute step is the reference. for every
+ * run it prints the force passes it took (bodies whose force was computed
+ * over the body count, so block's partial passes add up the same way), the worst relative energy error
+ * seen along the way, and at the end the worst position error of a
+ * planet relative to its distance from the sun, and the moon's error
+ * relative to its distance from the earth
+ *
+ * usage: integrator_bench [years] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/integrator.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+struct integrator_run{
+	body_arrays b;
+	long long passes = 0;
+	double energy_error = 0;
+	double ms = 0;
+};
+
+integrator_run run(int kind, double dt, double span){
+	integrator_run r;
+	generate_solar_system(r.b);
+	gravity_solver g(1);
+	g.kind = GRAVITY_DIRECT;
+	integrator in;
+	in.kind = kind;
+	double e0 = total_energy(r.b, g.G);
+	/* whole steps and then what is left of the span, so every run ends
+	 * where the reference does */
+	long long steps = (long long)std::floor(span / dt + 1e-9);
+	double rest = span - steps * dt;
+	if(rest < 1e-6 * dt) rest = 0;
+	long long total = steps + (rest > 0);
+	auto t0 = std::chrono::steady_clock::now();
+	for(long long s=0;s<total;s++){
+		in.step(r.b, g, s < steps ? dt : rest);
+		/* the energy is only looked at now and then, it costs more than a step */
+		if(s % std::max(1ll, total / 200) == 0 || s == total - 1){
+			r.energy_error = std::max(r.energy_error, std::fabs((total_energy(r.b, g.G) - e0) / e0));
+		}
+	}
+	r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	r.passes = in.forces / r.b.size();
+	return r;
+}
+
+int main(int argc, char** argv){
+	double years = argc > 1 ? std::atof(argv[1]) : 1.0;
+	double span = years * 365.25 * 86400.0;
+
+	integrator_run ref = run(INTEGRATOR_YOSHIDA4, 600.0, span);
+	std::cout << "solar system, " << years << " years, reference yoshida4 at 600 s" << std::endl;
+	std::cout << "integrator  step h  force passes  max |dE/E|  planet error  moon error      ms" << std::endl;
+	for(int kind=0;kind<INTEGRATOR_COUNT;kind++){
+		for(double hours : {1.0, 6.0, 24.0, 96.0}){
+			integrator_run r = run(kind, hours * 3600.0, span);
+			double planet = 0;
+			for(int i=1;i<9;i++){
+				double dx = r.b.x[i] - ref.b.x[i], dy = r.b.y[i] - ref.b.y[i];
+				double rx = ref.b.x[i] - ref.b.x[0], ry = ref.b.y[i] - ref.b.y[0];
+				planet = std::max(planet, std::sqrt((dx*dx + dy*dy) / (rx*rx + ry*ry)));
+			}
+			double mx = (r.b.x[9] - r.b.x[3]) - (ref.b.x[9] - ref.b.x[3]);
+			double my = (r.b.y[9] - r.b.y[3]) - (ref.b.y[9] - ref.b.y[3]);
+			double rx = ref.b.x[9] - ref.b.x[3], ry = ref.b.y[9] - ref.b.y[3];
+			double moon = std::sqrt((mx*mx + my*my) / (rx*rx + ry*ry));
+			std::cout << std::setw(10) << std::left << integrator_kind_name(kind) << std::right << "  "
+				<< std::setw(6) << std::fixed << std::setprecision(0) << hours << "  "
+				<< std::setw(12) << r.passes << "  "
+				<< std::scientific << std::setprecision(2) << std::setw(10) << r.energy_error << "  "
+				<< std::setw(12) << planet << "  " << std::setw(10) << moon << "  "
+				<< std::fixed << std::setprecision(1) << std::setw(6) << r.ms << std::endl;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+/* test particles on the solar system: ms per step of the particle kernel
+ * with every instruction set this cpu runs, against one tree pass over
+ * the same bodies given mass, and then a year of fifteen minute leapfrog
+ * steps to see the belt and saturn's ring hold together: how far the
+ * belt's radii drifted, rms relative to where they started, and how much
+ * of the ring is still within twice its outer radius of saturn. the inner
+ * ring goes round in five hours, at one hour steps it starts to fall
+ * apart
+ *
+ * usage: particle_bench [particles] [threads] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/integrator.h"
+#include "../physics/scene.h"
+#include "../physics/test_particles.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+const double AU = 1.496e11;
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+	int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+	gravity_solver gravity(threads);
+	gravity.kind = GRAVITY_DIRECT;
+	double dt = 900.0;
+
+	body_arrays b;
+	generate_solar_system(b, gravity.G);
+	test_particles p;
+	int ring = n / 10;
+	generate_ring(p, b, 0, n - ring, 2.2 * AU, 3.3 * AU, 1234, gravity.G);
+	generate_ring(p, b, 6, ring, 7.0e7, 1.4e8, 4321, gravity.G);
+
+	std::cout << p.size() << " particles, " << b.size() << " massive bodies, " << gravity.pool.size() << " threads" << std::endl;
+	std::cout << "kernel   ms/step  pairs/s" << std::endl;
+	for(int level=0;level<SIMD_COUNT;level++){
+		if(!simd_supported(level)) continue;
+		test_particles q = p;
+		q.simd = level;
+		int steps = 20;
+		auto t0 = std::chrono::steady_clock::now();
+		for(int s=0;s<steps;s++){
+			q.begin_step(b, gravity.pool, gravity.G, dt);
+			q.end_step(b, gravity.pool, gravity.G, dt);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / steps;
+		std::cout << std::setw(6) << std::left << simd_level_name(level) << std::right << "  "
+			<< std::fixed << std::setprecision(2) << std::setw(7) << ms << "  "
+			<< std::scientific << std::setprecision(2) << (double)q.size() * b.size() / (ms * 1e-3) << std::endl;
+	}
+
+	body_arrays all = b;
+	int k = b.size();
+	all.resize(k + p.size());
+	for(int i=0;i<p.size();i++){
+		all.x[k + i] = p.x[i]; all.y[k + i] = p.y[i];
+		all.m[k + i] = 1e15;
+	}
+	gravity.kind = GRAVITY_TREE;
+	gravity.accelerations(all);
+	auto t0 = std::chrono::steady_clock::now();
+	gravity.accelerations(all);
+	double tree_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	std::cout << "as massive bodies, one tree pass at theta 0.5: " << std::fixed << std::setprecision(1) << tree_ms << " ms" << std::endl;
+
+	std::vector<double> r0(p.size());
+	for(int i=0;i<n-ring;i++) r0[i] = std::hypot(p.x[i] - b.x[0], p.y[i] - b.y[0]);
+	gravity.kind = GRAVITY_DIRECT;
+	integrator in;
+	in.kind = INTEGRATOR_LEAPFROG;
+	int steps = (int)(365.25 * 86400 / dt);
+	t0 = std::chrono::steady_clock::now();
+	for(int s=0;s<steps;s++){
+		p.begin_step(b, gravity.pool, gravity.G, dt);
+		in.step(b, gravity, dt);
+		p.end_step(b, gravity.pool, gravity.G, dt);
+	}
+	double year_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	double drift = 0;
+	for(int i=0;i<n-ring;i++){
+		double r = std::hypot(p.x[i] - b.x[0], p.y[i] - b.y[0]);
+		drift += (r / r0[i] - 1) * (r / r0[i] - 1);
+	}
+	int bound = 0;
+	for(int i=n-ring;i<n;i++){
+		if(std::hypot(p.x[i] - b.x[6], p.y[i] - b.y[6]) < 2.8e8) bound++;
+	}
+	std::cout << "one year in " << steps << " steps: " << std::setprecision(0) << year_ms << " ms, belt radius drift rms "
+		<< std::scientific << std::setprecision(2) << std::sqrt(drift / (n - ring)) << ", ring "
+		<< bound << " of " << ring << " bound" << std::endl;
+	return 0;
+}
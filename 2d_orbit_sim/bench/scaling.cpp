@@ -0,0 +1,68 @@
+/* thread scaling of the two exact force passes: direct_gravity, which
+ * sums every pair twice, once for each body, and the pairs kind, which
+ * sums it once and uses newton's third law. for every body count and
+ * thread count it prints ms per pass, the speedup over one thread of the
+ * same kind, and how much faster pairs is than direct at that thread
+ * count. the worst relative difference of the two is checked once per
+ * body count. the bodies are the disk of gravity_bench
+ *
+ * usage: scaling_bench [max bodies] [max threads] */
+#include "../physics/bodies.h"
+#include "../physics/gravity.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int most = argc > 1 ? std::atoi(argv[1]) : 100000;
+	int most_threads = argc > 2 ? std::atoi(argv[2]) : 32;
+
+	std::cout << "kernel " << simd_level_name(simd_best()) << ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	for(int n=1000;n<=most;n*=10){
+		disk_params params;
+		params.bodies = n - 1;
+		params.mass = 1e24;
+		params.center_mass = 10.0 * n * 1e24;
+		params.r_in = 1e10;
+		body_arrays b;
+		generate_disk(b, params);
+		int repeats = std::max(1, (int)(2e8 / ((double)n * n)));
+
+		double error = 0;
+		double base[2] = {0, 0};
+		std::cout << n << " bodies, " << repeats << " repeats" << std::endl;
+		std::cout << "threads  direct ms  speedup  pairs ms  speedup  pairs/direct" << std::endl;
+		for(int threads=1;threads<=most_threads;threads*=2){
+			gravity_solver solver(threads);
+			double ms[2];
+			std::vector<double> ax, ay;
+			for(int k=0;k<2;k++){
+				solver.kind = k == 0 ? GRAVITY_DIRECT : GRAVITY_PAIRS;
+				solver.accelerations(b);
+				auto t0 = std::chrono::steady_clock::now();
+				for(int r=0;r<repeats;r++) solver.accelerations(b);
+				ms[k] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / repeats;
+				if(threads == 1) base[k] = ms[k];
+				if(k == 0){
+					ax = b.ax; ay = b.ay;
+				}
+			}
+			if(threads == 1){
+				for(int i=0;i<n;i++){
+					double dx = b.ax[i] - ax[i], dy = b.ay[i] - ay[i];
+					error = std::max(error, std::sqrt((dx*dx + dy*dy) / (ax[i]*ax[i] + ay[i]*ay[i])));
+				}
+			}
+			std::cout << std::setw(7) << threads << "  " << std::fixed << std::setprecision(2)
+				<< std::setw(9) << ms[0] << "  " << std::setw(7) << base[0] / ms[0] << "  "
+				<< std::setw(8) << ms[1] << "  " << std::setw(7) << base[1] / ms[1] << "  "
+				<< std::setw(12) << ms[0] / ms[1] << std::endl;
+		}
+		std::cout << "max relative difference pairs to direct " << std::scientific << std::setprecision(2) << error << std::endl;
+	}
+	return 0;
+}
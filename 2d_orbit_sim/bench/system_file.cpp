@@ -0,0 +1,88 @@
+/* loading a catalog: the solar system and a belt of minor bodies written
+ * as csv and as the binary form, then ms to load each and whether both
+ * give back the same bodies
+ *
+ * usage: system_bench [bodies] [dir] */
+#include "../physics/scene.h"
+#include "../physics/system_file.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	std::string dir = argc > 2 ? argv[2] : "/tmp";
+	std::string csv = dir + "/catalog.csv", bin = dir + "/catalog.orb";
+
+	system_data s;
+	generate_solar_system(s.bodies);
+	disk_params params;
+	params.bodies = n;
+	params.mass = 1e15;
+	body_arrays disk;
+	generate_disk(disk, params);
+	int k = s.bodies.size();
+	body_arrays planets = s.bodies;
+	s.resize(k + n);
+	for(int i=0;i<k;i++) s.names[i] = "planet" + std::to_string(i);
+	for(int i=0;i<n;i++){
+		s.bodies.x[k + i] = disk.x[i + 1]; s.bodies.y[k + i] = disk.y[i + 1];
+		s.bodies.vx[k + i] = disk.vx[i + 1]; s.bodies.vy[k + i] = disk.vy[i + 1];
+		s.bodies.m[k + i] = disk.m[i + 1];
+		s.radius[k + i] = 1;
+	}
+	for(int i=0;i<s.size();i++){
+		s.color[3*i] = s.color[3*i + 1] = s.color[3*i + 2] = 0.5f;
+	}
+
+	FILE* f = std::fopen(csv.c_str(), "w");
+	if(!f){
+		std::cout << "cannot write " << csv << std::endl;
+		return 1;
+	}
+	std::fprintf(f, "# name,x,y,vx,vy,mass,radius,r,g,b\n");
+	for(int i=0;i<s.size();i++){
+		std::fprintf(f, "%s,%.17g,%.17g,%.17g,%.17g,%.17g,%.9g,%.9g,%.9g,%.9g\n", s.names[i].c_str(),
+			s.bodies.x[i], s.bodies.y[i], s.bodies.vx[i], s.bodies.vy[i], s.bodies.m[i],
+			s.radius[i], s.color[3*i], s.color[3*i + 1], s.color[3*i + 2]);
+	}
+	std::fclose(f);
+
+	std::string error;
+	system_data from_csv, from_bin;
+	auto t0 = std::chrono::steady_clock::now();
+	if(!load_system(csv.c_str(), from_csv, error)){
+		std::cout << error << std::endl;
+		return 1;
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	if(!save_system_binary(bin.c_str(), from_csv, error)){
+		std::cout << error << std::endl;
+		return 1;
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	if(!load_system(bin.c_str(), from_bin, error)){
+		std::cout << error << std::endl;
+		return 1;
+	}
+	auto t3 = std::chrono::steady_clock::now();
+
+	bool same = from_csv.size() == s.size() && from_bin.size() == s.size()
+		&& from_csv.bodies.x == s.bodies.x && from_csv.bodies.vy == s.bodies.vy && from_csv.bodies.m == s.bodies.m
+		&& from_bin.bodies.x == from_csv.bodies.x && from_bin.bodies.y == from_csv.bodies.y
+		&& from_bin.bodies.vx == from_csv.bodies.vx && from_bin.bodies.vy == from_csv.bodies.vy
+		&& from_bin.bodies.m == from_csv.bodies.m && from_bin.radius == from_csv.radius
+		&& from_bin.color == from_csv.color && from_csv.names[3] == "planet3";
+
+	typedef std::chrono::duration<double, std::milli> ms;
+	std::cout << s.size() << " bodies" << std::fixed << std::setprecision(1) << std::endl;
+	std::cout << "load csv     " << std::setw(8) << ms(t1 - t0).count() << " ms" << std::endl;
+	std::cout << "save binary  " << std::setw(8) << ms(t2 - t1).count() << " ms" << std::endl;
+	std::cout << "load binary  " << std::setw(8) << ms(t3 - t2).count() << " ms" << std::endl;
+	std::cout << "same bodies  " << (same ? "yes" : "no") << std::endl;
+	std::remove(csv.c_str());
+	std::remove(bin.c_str());
+	return same ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/* the simulation thread on the solar system and a massive belt: steps per
+ * second and simulated days per second flat out and at a few warps, and
+ * how many snapshots a reader polling every millisecond got, checking
+ * each one is whole: its time is its step count times the step and its
+ * path ends at its step. gap is the most steps between two path samples
+ * the reader got, 1 when the trails see every step
+ *
+ * usage: warp_bench [bodies] [threads] */
+#include "../physics/scene.h"
+#include "../physics/sim_thread.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 2000;
+	int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+	sim_thread sim(threads);
+	generate_solar_system(sim.bodies, sim.gravity.G);
+	disk_params params;
+	params.bodies = n;
+	params.mass = 1e17;
+	body_arrays disk;
+	generate_disk(disk, params, sim.gravity.G);
+	int k = sim.bodies.size();
+	sim.bodies.resize(k + disk.size() - 1);
+	for(int i=1;i<disk.size();i++){
+		sim.bodies.x[k + i - 1] = disk.x[i]; sim.bodies.y[k + i - 1] = disk.y[i];
+		sim.bodies.vx[k + i - 1] = disk.vx[i]; sim.bodies.vy[k + i - 1] = disk.vy[i];
+		sim.bodies.m[k + i - 1] = disk.m[i];
+	}
+
+	sim_controls c;
+	c.dt = 3600;
+	sim.set_controls(c);
+	sim.start();
+	std::cout << sim.bodies.size() << " bodies, " << sim.gravity.pool.size() << " threads, " << c.dt << " s steps" << std::endl;
+	std::cout << "warp days/s   steps/s  days/s  snapshots  torn  gap" << std::endl;
+
+	double warps[] = {0, 10, 100, 1000};
+	for(double warp : warps){
+		c.warp = warp * 86400.0;
+		sim.set_controls(c);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+		long long seen = 0, torn = 0, last = -1, gap = 0, sampled = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		while(std::chrono::steady_clock::now() - t0 < std::chrono::seconds(2)){
+			const sim_snapshot& s = sim.latest();
+			if(s.steps != last){
+				seen++;
+				last = s.steps;
+				if(s.time != s.steps * c.dt || (int)s.x.size() != sim.bodies.size()) torn++;
+				if(s.path_step.empty() || s.path_step.back() != s.steps
+					|| s.path_x.size() != s.path_step.size() * sim.bodies.size()) torn++;
+				/* the first two cover the wait before, thinned */
+				for(long long step : s.path_step){
+					if(step <= sampled) continue;
+					if(seen > 2) gap = std::max(gap, step - sampled);
+					sampled = step;
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::cout << std::fixed << std::setprecision(0) << std::setw(9);
+		if(warp > 0) std::cout << warp;
+		else std::cout << "max";
+		std::cout << "  " << std::setw(8) << sim.steps_per_second()
+			<< "  " << std::setprecision(1) << std::setw(6) << sim.days_per_second()
+			<< "  " << std::setw(9) << seen << "  " << std::setw(4) << torn << "  " << std::setw(3) << gap << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+	}
+	sim.stop();
+}
@@ -1,26 +1,58 @@
 #include "glad/glad.h"
 #include "shader/shader.h"
+#include "physics/bodies.h"
+#include "physics/gravity.h"
+#include "physics/integrator.h"
+#include "physics/scene.h"
+#include "physics/test_particles.h"
+#include "physics/sim_thread.h"
+#include "physics/system_file.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <chrono>
 #include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
 
 /* config variables */
 int scrWidth = 1920;
 int scrHeight = 1001;
 
-/* advances roughly at one hour per frame*/
+/* the simulation runs on its own thread in steps of an hour to start
+ * with, comma and period halve and double the step. it runs warp
+ * simulated seconds per second, minus and equals halve and double that,
+ * 0 lets it run as fast as it can */
 float time_change = 3600;
+double warp = 2.5 * 86400;
+bool warp_max = false;
 
 glm::mat4 projection = glm::ortho(0.0f, (float)scrWidth, (float)scrHeight, 0.0f); // left right up down
 glm::vec2 cameraPos;
 float cameraZoom = 0.1f;
 
+/* meters to the screen units the planets are placed in, around the
+ * center of the screen */
+const double draw_scale = std::pow(10, -5.5);
+
 /* constants */
 double G = 6.674 * std::pow(10, -11);
 
+/* gravity: G cycles through the exact sum, the tree, the exact sum over
+ * pairs and the fast multipole method, [ and ] change the tree's opening
+ * angle */
+int gravity_mode = GRAVITY_TREE;
+double theta = 0.5;
+
+/* I cycles through the integrators */
+int integrator_mode = INTEGRATOR_LEAPFROG;
+
+/* T shows and hides the orbit trails */
+bool show_trails = true;
+
 struct planet{
 	std::string name;
 	std::vector<float> position = {scrWidth / 2.0f, scrHeight / 2.0f};
@@ -29,16 +61,6 @@ struct planet{
 	glm::vec3 color;
 	float radius = 20;
 	double mass = 2.0f;
-	int segments = 100;
-	unsigned int VAO = 0;
-	unsigned int VBO = 0;
-	bool initialized = false;
-
-	void updatePos(float t){
-		position[0] += velocity[0] * t;
-		position[1] += velocity[1] * t;
-	}
-
 };
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
@@ -75,6 +97,45 @@ static void key_callback(GLFWwindow* win, int key, int scancode, int action, int
     if(key == GLFW_KEY_D && action == GLFW_REPEAT){
 	    cameraPos.x += 30;
     }
+	if(key == GLFW_KEY_G && action == GLFW_PRESS){
+		gravity_mode = (gravity_mode + 1) % GRAVITY_COUNT;
+		std::cout << "gravity: " << gravity_kind_name(gravity_mode) << std::endl;
+	}
+	if(key == GLFW_KEY_I && action == GLFW_PRESS){
+		integrator_mode = (integrator_mode + 1) % INTEGRATOR_COUNT;
+		std::cout << "integrator: " << integrator_kind_name(integrator_mode) << std::endl;
+	}
+	if(key == GLFW_KEY_COMMA && action == GLFW_PRESS){
+		time_change *= 0.5f;
+		std::cout << "step: " << time_change << " s" << std::endl;
+	}
+	if(key == GLFW_KEY_PERIOD && action == GLFW_PRESS){
+		time_change *= 2.0f;
+		std::cout << "step: " << time_change << " s" << std::endl;
+	}
+	if(key == GLFW_KEY_MINUS && action == GLFW_PRESS){
+		warp *= 0.5;
+		std::cout << "warp: " << warp / 86400 << " days/s" << std::endl;
+	}
+	if(key == GLFW_KEY_EQUAL && action == GLFW_PRESS){
+		warp *= 2.0;
+		std::cout << "warp: " << warp / 86400 << " days/s" << std::endl;
+	}
+	if(key == GLFW_KEY_0 && action == GLFW_PRESS){
+		warp_max = !warp_max;
+		std::cout << "warp: " << (warp_max ? "max" : "set") << std::endl;
+	}
+	if(key == GLFW_KEY_T && action == GLFW_PRESS){
+		show_trails = !show_trails;
+	}
+	if(key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS){
+		theta = std::max(0.0, theta - 0.1);
+		std::cout << "theta: " << theta << std::endl;
+	}
+	if(key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS){
+		theta = std::min(1.2, theta + 0.1);
+		std::cout << "theta: " << theta << std::endl;
+	}
 }
 
 /* basically what to do if window is resized */
@@ -92,78 +153,358 @@ void processInput(GLFWwindow* win){
 	}
 }
 
-std::vector<float> create_circle(planet c){
+/* every planet through a few shared unit circles: a triangle fan per
+ * mesh level in one buffer, and the center, radius and color of every
+ * planet in an instance buffer. each frame the planets are sorted into
+ * levels by their radius on screen and each level is one instanced draw.
+ * level 0 is for planets smaller than a pixel, drawn as points instead */
+const int planet_meshes = 6;
+const int mesh_segments[planet_meshes] = {8, 16, 32, 64, 128, 256};
+const int planet_floats = 6;    /* center, radius, color */
+
+struct planet_batch{
+	unsigned int VAO = 0;
+	unsigned int mesh = 0;
+	unsigned int instances = 0;
+	int capacity = 0;
+	int first[planet_meshes];
+	std::vector<float> levels[planet_meshes + 1];
+	std::vector<float> upload;
+};
+
+/* a chord of n segments sags r (pi/n)^2 / 2 inside the circle, the
+ * coarsest mesh that keeps it under half a pixel */
+int planet_level(float pixels){
+	if(pixels < 1.0f) return 0;
+	for(int l=0;l<planet_meshes;l++){
+		float sag = 0.5f * pixels * (float)(M_PI * M_PI) / (mesh_segments[l] * mesh_segments[l]);
+		if(sag < 0.5f) return l + 1;
+	}
+	return planet_meshes;
+}
+
+void init_planets(planet_batch& p){
 	std::vector<float> vertices;
-	float centerx = (scrWidth / 2), centery = (scrHeight / 2), x, y;
-	double pexp = 5.5;
+	for(int l=0;l<planet_meshes;l++){
+		p.first[l] = (int)vertices.size() / 2;
+		vertices.push_back(0.0f); vertices.push_back(0.0f);
+		for(int i=0;i<=mesh_segments[l];i++){
+			float angle = 2.0f * M_PI * i / mesh_segments[l];
+			vertices.push_back(std::cos(angle)); vertices.push_back(std::sin(angle));
+		}
+	}
 
-	vertices.push_back(c.position[0]*std::pow(10, -pexp) + centerx); vertices.push_back(c.position[1]*std::pow(10, -pexp) + centery);
+	glGenVertexArrays(1, &p.VAO);
+	glBindVertexArray(p.VAO);
+	glGenBuffers(1, &p.mesh);
+	glBindBuffer(GL_ARRAY_BUFFER, p.mesh);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
 
-	for(int i=0;i<=c.segments;i++){
-		float angle = 2.0f * M_PI * i / c.segments;
-		x = (c.position[0] * std::pow(10, -pexp) + centerx) + c.radius * std::cos(angle);
-		y = (c.position[1] * std::pow(10, -pexp) + centery) + c.radius * std::sin(angle);
-		vertices.push_back(x); vertices.push_back(y);
+	glGenBuffers(1, &p.instances);
+	glBindBuffer(GL_ARRAY_BUFFER, p.instances);
+	for(int a=1;a<=3;a++){
+		glEnableVertexAttribArray(a);
+		glVertexAttribDivisor(a, 1);
 	}
-	return vertices;
+	glBindVertexArray(0);
 }
 
-void init_planet(planet& c){
-	if(c.initialized) return;
+/* the instance attributes start at the first planet of a level, there is
+ * no base instance in 3.3 */
+void point_instances(int first){
+	size_t stride = planet_floats * sizeof(float);
+	size_t base = first * stride;
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)base);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(base + 2*sizeof(float)));
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + 3*sizeof(float)));
+}
 
-	std::vector<float> circleVertices = create_circle(c);
+/* planets entirely off screen are left out */
+void draw_planets(planet_batch& p, const std::vector<planet>& planets, Shader& shader){
+	float centerx = (scrWidth / 2), centery = (scrHeight / 2);
+	for(auto& l : p.levels) l.clear();
+	for(const planet& c : planets){
+		float x = c.position[0] * draw_scale + centerx;
+		float y = c.position[1] * draw_scale + centery;
+		float pixels = c.radius * cameraZoom;
+		float sx = x * cameraZoom - cameraPos.x, sy = y * cameraZoom - cameraPos.y;
+		if(sx < -pixels || sx > scrWidth + pixels || sy < -pixels || sy > scrHeight + pixels) continue;
+		std::vector<float>& v = p.levels[planet_level(pixels)];
+		v.push_back(x); v.push_back(y); v.push_back(c.radius);
+		v.push_back(c.color[0]); v.push_back(c.color[1]); v.push_back(c.color[2]);
+	}
 
-	c.VAO = 1;
-	c.VBO = 1;
-	glGenVertexArrays(1, &c.VAO);
-	glBindVertexArray(c.VAO);
+	p.upload.clear();
+	for(auto& l : p.levels) p.upload.insert(p.upload.end(), l.begin(), l.end());
+	int n = (int)p.upload.size() / planet_floats;
+	if(n == 0) return;
+	glBindBuffer(GL_ARRAY_BUFFER, p.instances);
+	if(n > p.capacity){
+		glBufferData(GL_ARRAY_BUFFER, p.upload.size() * sizeof(float), p.upload.data(), GL_STREAM_DRAW);
+		p.capacity = n;
+	}
+	else{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, p.upload.size() * sizeof(float), p.upload.data());
+	}
+
+	glBindVertexArray(p.VAO);
+	shader.setFloat("uPointSize", 2.0f);
+	int first = 0;
+	for(int l=0;l<=planet_meshes;l++){
+		int count = (int)p.levels[l].size() / planet_floats;
+		if(count == 0) continue;
+		point_instances(first);
+		/* the center of the first fan is a point at the origin */
+		if(l == 0) glDrawArraysInstanced(GL_POINTS, 0, 1, count);
+		else glDrawArraysInstanced(GL_TRIANGLE_FAN, p.first[l - 1], mesh_segments[l - 1] + 2, count);
+		first += count;
+	}
+	glBindVertexArray(0);
+}
 
-	glGenBuffers(1, &c.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, c.VBO);
-	glBufferData(GL_ARRAY_BUFFER, circleVertices.size() * sizeof(float), circleVertices.data(), GL_DYNAMIC_DRAW);
+/* every test particle in one vertex buffer, drawn as round point sprites
+ * with one draw call per group of the same color */
+struct point_batch{
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	int capacity = 0;
+	std::vector<float> vertices;
+};
 
+void init_points(point_batch& p){
+	glGenVertexArrays(1, &p.VAO);
+	glBindVertexArray(p.VAO);
+	glGenBuffers(1, &p.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, p.VBO);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
-
-	glBindVertexArray(c.VAO);
-	glDrawArrays(GL_TRIANGLE_FAN, 0, c.segments+2);
 	glBindVertexArray(0);
-	c.initialized = true;
 }
 
-void draw_circle(planet& c){
-	std::vector<float> circleVertices = create_circle(c);
+/* the particles in the same screen units as the planets */
+void upload_points(point_batch& p, const std::vector<double>& x, const std::vector<double>& y){
+	float centerx = (scrWidth / 2), centery = (scrHeight / 2);
+	double scale = draw_scale;
+	int n = (int)x.size();
+	p.vertices.resize(2 * n);
+	for(int i=0;i<n;i++){
+		p.vertices[2*i] = (float)(x[i] * scale) + centerx;
+		p.vertices[2*i + 1] = (float)(y[i] * scale) + centery;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, p.VBO);
+	if(n > p.capacity){
+		glBufferData(GL_ARRAY_BUFFER, p.vertices.size() * sizeof(float), p.vertices.data(), GL_STREAM_DRAW);
+		p.capacity = n;
+	}
+	else{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, p.vertices.size() * sizeof(float), p.vertices.data());
+	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, c.VBO);
-	glBufferData(GL_ARRAY_BUFFER, circleVertices.size() * sizeof(float), circleVertices.data(), GL_DYNAMIC_DRAW);
+void draw_points(point_batch& p, int first, int count){
+	if(count <= 0) return;
+	glBindVertexArray(p.VAO);
+	glDrawArrays(GL_POINTS, first, count);
+	glBindVertexArray(0);
+}
 
-	glBindVertexArray(c.VAO);
-	glDrawArrays(GL_TRIANGLE_FAN, 0, c.segments+2);
+/* the orbit of every body as a ring of line strip vertices, all rings in
+ * one vertex buffer. the rings are written in a copy in memory and once a
+ * frame the vertices that changed go up together, runs of them that are
+ * close merged into one upload, so it is a call or a few instead of some
+ * per body. a body's newest vertex is tentative and follows it, the one
+ * before becomes part of the trail when the path since the last kept
+ * vertex bends more than a pixel away from the chord. a circular arc of
+ * length s turning by phi sags s phi / 8 from its chord, so that is the
+ * test, with the length and the turning summed along the way so loops and
+ * wiggles count too. the tolerance is a pixel at the zoom of the time the
+ * vertex was kept.
+ *
+ * every ring has one slot more than its capacity and slot 0 is copied to
+ * the end, so a ring that wraps around is two strips that meet, and all
+ * of them are one glMultiDrawArrays */
+const int trail_budget = 1 << 22;   /* vertices over all bodies */
+const int trail_gap = 1024;         /* unchanged vertices cheaper to send again than a call */
+
+struct trail_batch{
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+	int capacity = 0;               /* vertices per body */
+	std::vector<float> vertices;    /* what is in the buffer, x y per vertex */
+	std::vector<int> dirty;         /* vertices written since the last upload */
+	std::vector<int> head, count;   /* tentative slot, kept vertices */
+	std::vector<float> lastx, lasty, sentx, senty;
+	std::vector<float> dirx, diry, length, turn;
+	long long step = -1;            /* the last simulation step in the trails */
+	std::vector<int> firsts;
+	std::vector<int> counts;
+};
+
+void init_trails(trail_batch& t, int bodies){
+	t.capacity = std::max(16, std::min(1024, trail_budget / std::max(bodies, 1) - 1));
+	t.head.assign(bodies, 0); t.count.assign(bodies, 0);
+	t.lastx.assign(bodies, 0); t.lasty.assign(bodies, 0);
+	t.sentx.assign(bodies, 0); t.senty.assign(bodies, 0);
+	t.dirx.assign(bodies, 0); t.diry.assign(bodies, 0);
+	t.length.assign(bodies, 0); t.turn.assign(bodies, 0);
+	t.step = -1;
+	t.vertices.assign((size_t)bodies * (t.capacity + 1) * 2, 0.0f);
+	t.dirty.clear();
+
+	glGenVertexArrays(1, &t.VAO);
+	glBindVertexArray(t.VAO);
+	glGenBuffers(1, &t.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, t.VBO);
+	glBufferData(GL_ARRAY_BUFFER, t.vertices.size() * sizeof(float), t.vertices.data(), GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
 	glBindVertexArray(0);
 }
 
-void planet_orbit(planet& p1, planet& p2){
-	/* distances */
-	double x = p2.position[0] - p1.position[0], y = p2.position[1] - p1.position[1];
-	std::vector<double> r = {x,y};
-	double v_length = std::sqrt(x*x + y*y);
-	std::vector<double> rdir = {x / v_length, y / v_length};
-
-	/* magnitude */
-	double force_magnitude = (G * p1.mass * p2.mass) / std::pow(v_length, 2);
-	std::vector<double> force_direction = {force_magnitude*rdir[0], force_magnitude*rdir[1]};
-	std::vector<double> a1 = { force_direction[0]/p1.mass, force_direction[1]/p1.mass };
-
-	/* apply velocity */
-	p1.velocity[0] += a1[0] * time_change;
-	p1.velocity[1] += a1[1] * time_change;
+void write_trail(trail_batch& t, int body, int slot, float x, float y){
+	int ring = body * (t.capacity + 1);
+	t.vertices[2*(ring + slot)] = x;
+	t.vertices[2*(ring + slot) + 1] = y;
+	t.dirty.push_back(ring + slot);
+	if(slot == 0){
+		t.vertices[2*(ring + t.capacity)] = x;
+		t.vertices[2*(ring + t.capacity) + 1] = y;
+		t.dirty.push_back(ring + t.capacity);
+	}
+}
+
+/* the written vertices in order, a run ends where the next one is more
+ * than trail_gap away */
+void upload_trails(trail_batch& t){
+	if(t.dirty.empty()) return;
+	std::sort(t.dirty.begin(), t.dirty.end());
+	glBindBuffer(GL_ARRAY_BUFFER, t.VBO);
+	size_t k = 0;
+	while(k < t.dirty.size()){
+		int first = t.dirty[k], last = first;
+		while(++k < t.dirty.size() && t.dirty[k] - last <= trail_gap) last = t.dirty[k];
+		glBufferSubData(GL_ARRAY_BUFFER, (size_t)first * 2 * sizeof(float),
+			(size_t)(last - first + 1) * 2 * sizeof(float), &t.vertices[2 * (size_t)first]);
+	}
+	t.dirty.clear();
+}
+
+/* one position of body i, in screen units */
+void append_trail(trail_batch& t, int i, float x, float y, float tolerance){
+	if(t.count[i] == 0){
+		write_trail(t, i, 0, x, y);
+		write_trail(t, i, 1, x, y);
+		t.head[i] = 1;
+		t.count[i] = 1;
+		t.lastx[i] = t.sentx[i] = x;
+		t.lasty[i] = t.senty[i] = y;
+		t.length[i] = t.turn[i] = 0;
+		t.dirx[i] = t.diry[i] = 0;
+	}
+
+	float dx = x - t.lastx[i], dy = y - t.lasty[i];
+	float step = std::sqrt(dx*dx + dy*dy);
+	if(step == 0) return;
+	if(t.length[i] > 0) t.turn[i] += std::fabs(std::atan2(t.dirx[i]*dy - t.diry[i]*dx, t.dirx[i]*dx + t.diry[i]*dy));
+	t.length[i] += step;
+
+	bool keep = t.length[i] * t.turn[i] / 8 > tolerance;
+	if(keep){
+		/* the last position is the end of a chord that was still good */
+		write_trail(t, i, t.head[i], t.lastx[i], t.lasty[i]);
+		t.head[i] = (t.head[i] + 1) % t.capacity;
+		t.count[i] = std::min(t.count[i] + 1, t.capacity - 1);
+		t.length[i] = step;
+		t.turn[i] = 0;
+	}
+	float sx = x - t.sentx[i], sy = y - t.senty[i];
+	if(keep || sx*sx + sy*sy > tolerance * tolerance){
+		write_trail(t, i, t.head[i], x, y);
+		t.sentx[i] = x;
+		t.senty[i] = y;
+	}
+	t.dirx[i] = dx;
+	t.diry[i] = dy;
+	t.lastx[i] = x;
+	t.lasty[i] = y;
+}
+
+/* every step of the snapshot's path the trails don't have yet, so the
+ * chords are judged on the orbit and not on where the bodies were one
+ * frame apart, which at full warp is days */
+void append_trails(trail_batch& t, const sim_snapshot& snap){
+	float centerx = (scrWidth / 2), centery = (scrHeight / 2);
+	float tolerance = 1.0f / cameraZoom;
+	int n = t.head.size();
+	for(int k=0;k<(int)snap.path_step.size();k++){
+		if(snap.path_step[k] <= t.step) continue;
+		for(int i=0;i<n;i++){
+			float x = (float)snap.path_x[(size_t)k * n + i] * draw_scale + centerx;
+			float y = (float)snap.path_y[(size_t)k * n + i] * draw_scale + centery;
+			append_trail(t, i, x, y, tolerance);
+		}
+		t.step = snap.path_step[k];
+	}
+	upload_trails(t);
+}
+
+void draw_trails(trail_batch& t){
+	t.firsts.clear();
+	t.counts.clear();
+	for(int i=0;i<(int)t.head.size();i++){
+		if(t.count[i] == 0) continue;
+		int ring = i * (t.capacity + 1);
+		int total = t.count[i] + 1;
+		int start = (t.head[i] - total + 1 + t.capacity) % t.capacity;
+		if(start <= t.head[i]){
+			t.firsts.push_back(ring + start);
+			t.counts.push_back(total);
+		}
+		else{
+			t.firsts.push_back(ring + start);
+			t.counts.push_back(t.capacity + 1 - start);
+			t.firsts.push_back(ring);
+			t.counts.push_back(t.head[i] + 1);
+		}
+	}
+	if(t.firsts.empty()) return;
+	glBindVertexArray(t.VAO);
+	glMultiDrawArrays(GL_LINE_STRIP, t.firsts.data(), t.counts.data(), (int)t.firsts.size());
+	glBindVertexArray(0);
 }
 
 void waitm(int m){
 	std::this_thread::sleep_for(std::chrono::milliseconds(m));
 }
 
-int main(void){
+/* usage: main [--system FILE] [--belt N] [--rings N] [--massive-belt N] [--threads N]
+ * --system loads the bodies from a csv or binary file instead of the
+ * built in solar system, see physics/system_file.h and
+ * systems/solar_system.csv. the planets are drawn ten times their size
+ * like the built in ones. rows with a mass of 0 become test particles,
+ * drawn as points after the belt and the rings.
+ * --belt adds N massless asteroids on circular orbits between mars and
+ * jupiter (around the heaviest body), --rings N massless particles around saturn. they only feel
+ * the planets, so hundreds of thousands are cheap. the inner ring goes
+ * round in five hours and wants steps of fifteen minutes or less.
+ * --massive-belt adds N asteroids with mass as full bodies, for the tree
+ * and the multipole solvers, around the heaviest body too */
+int main(int argc, char** argv){
+	int belt = 0;
+	int rings = 0;
+	int massive_belt = 0;
+	int threads = 0;
+	const char* system_path = NULL;
+	for(int i=1;i<argc;i++){
+		if(!std::strcmp(argv[i], "--system") && i + 1 < argc) system_path = argv[++i];
+		else if(!std::strcmp(argv[i], "--belt") && i + 1 < argc) belt = std::atoi(argv[++i]);
+		else if(!std::strcmp(argv[i], "--rings") && i + 1 < argc) rings = std::atoi(argv[++i]);
+		else if(!std::strcmp(argv[i], "--massive-belt") && i + 1 < argc) massive_belt = std::atoi(argv[++i]);
+		else if(!std::strcmp(argv[i], "--threads") && i + 1 < argc) threads = std::atoi(argv[++i]);
+	}
+
     if(!glfwInit()) { /* failed */ }
     
     GLFWwindow* win = glfwCreateWindow(scrWidth, scrHeight, "orbit", NULL, NULL);
@@ -322,16 +663,130 @@ int main(void){
 	solar_system.push_back(uranus);
 	solar_system.push_back(neptune);
 
-	for(int i=0;i<solar_system.size();i++){
-		init_planet(solar_system[i]);
+	system_data loaded;
+	std::vector<int> massive_rows, massless_rows;
+	if(system_path){
+		std::string error;
+		if(!load_system(system_path, loaded, error)){
+			std::cerr << error << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		for(int i=0;i<loaded.size();i++){
+			if(loaded.bodies.m[i] > 0) massive_rows.push_back(i);
+			else massless_rows.push_back(i);
+		}
+		if(massive_rows.empty()){
+			std::cerr << system_path << ": no body with mass" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		solar_system.clear();
+		solar_system.resize(massive_rows.size());
+		for(int k=0;k<(int)massive_rows.size();k++){
+			int i = massive_rows[k];
+			planet& p = solar_system[k];
+			p.name = loaded.names.empty() ? "Body" : loaded.names[i];
+			p.mass = loaded.bodies.m[i];
+			p.position = {(float)loaded.bodies.x[i], (float)loaded.bodies.y[i]};
+			p.velocity = {loaded.bodies.vx[i], loaded.bodies.vy[i]};
+			p.color = glm::vec3(loaded.color[3*i], loaded.color[3*i + 1], loaded.color[3*i + 2]);
+			p.radius = loaded.radius[i] / std::pow(10, pS);
+		}
+		std::cout << massive_rows.size() << " bodies and " << massless_rows.size() << " test particles from "
+			<< system_path << std::endl;
 	}
-	
+
+	/* the belts go around the heaviest body, the sun unless --system
+	 * replaced it */
+	int heaviest = 0;
+	for(int i=1;i<(int)solar_system.size();i++){
+		if(solar_system[i].mass > solar_system[heaviest].mass) heaviest = i;
+	}
+
+	if(massive_belt > 0){
+		int c = heaviest;
+		double cx = solar_system[c].position[0], cy = solar_system[c].position[1];
+		double cvx = solar_system[c].velocity[0], cvy = solar_system[c].velocity[1];
+		if(!massive_rows.empty()){
+			cx = loaded.bodies.x[massive_rows[c]];
+			cy = loaded.bodies.y[massive_rows[c]];
+		}
+		disk_params params;
+		params.bodies = massive_belt;
+		params.center_mass = solar_system[c].mass;
+		params.mass = 1e17;
+		params.seed = (unsigned)time(NULL);
+		body_arrays disk;
+		generate_disk(disk, params, G);
+		for(int i=1;i<disk.size();i++){
+			planet a;
+			a.name = "Asteroid";
+			a.mass = disk.m[i];
+			a.position = {(float)(cx + disk.x[i]), (float)(cy + disk.y[i])};
+			a.velocity = {disk.vx[i] + cvx, disk.vy[i] + cvy};
+			a.color = glm::vec3(0.45f, 0.4f, 0.35f);
+			a.radius = 10;
+			solar_system.push_back(a);
+		}
+	}
+
+	planet_batch planet_draw;
+	init_planets(planet_draw);
+
 	Shader shader("shader/shader.vs", "shader/shader.fs");
+	Shader point_shader("shader/points.vs", "shader/points.fs");
+	Shader trail_shader("shader/trails.vs", "shader/trails.fs");
+	glEnable(GL_PROGRAM_POINT_SIZE);
 
 	glm::mat4 view;
 	glm::mat4 vp;
 	double mx, my;
 
+	/* the simulation runs on flat arrays in double precision on its own
+	 * thread, the planets only get their position back for drawing */
+	sim_thread sim(threads);
+	sim.gravity.G = G;
+	body_arrays& bodies = sim.bodies;
+	bodies.resize((int)solar_system.size());
+	for(int i=0;i<bodies.size();i++){
+		bodies.x[i] = solar_system[i].position[0];
+		bodies.y[i] = solar_system[i].position[1];
+		bodies.vx[i] = solar_system[i].velocity[0];
+		bodies.vy[i] = solar_system[i].velocity[1];
+		bodies.m[i] = solar_system[i].mass;
+	}
+	/* the planets only hold floats */
+	for(int k=0;k<(int)massive_rows.size();k++){
+		bodies.x[k] = loaded.bodies.x[massive_rows[k]];
+		bodies.y[k] = loaded.bodies.y[massive_rows[k]];
+	}
+
+	/* belt first, then the rings, then the massless rows of the file, so
+	 * each is one range of the batch */
+	test_particles& particles = sim.particles;
+	generate_ring(particles, bodies, heaviest, belt, 2.2 * 1.496e11, 3.3 * 1.496e11, (unsigned)time(NULL), G);
+	for(int i=0;i<(int)solar_system.size();i++){
+		if(solar_system[i].name == "Saturn") generate_ring(particles, bodies, i, rings, 7.0e7, 1.4e8, (unsigned)time(NULL) + 1, G);
+	}
+	int ring_count = particles.size() - belt;
+	int first_loaded = particles.size();
+	particles.resize(first_loaded + (int)massless_rows.size());
+	for(int k=0;k<(int)massless_rows.size();k++){
+		int i = massless_rows[k], j = first_loaded + k;
+		particles.x[j] = loaded.bodies.x[i];
+		particles.y[j] = loaded.bodies.y[i];
+		particles.vx[j] = loaded.bodies.vx[i];
+		particles.vy[j] = loaded.bodies.vy[i];
+	}
+	point_batch points;
+	init_points(points);
+	trail_batch trails;
+	init_trails(trails, (int)solar_system.size());
+	int particle_count = particles.size();
+	sim.start();
+	double last_title = glfwGetTime();
+
     while(!glfwWindowShouldClose(win)){
 		view = glm::translate(glm::mat4(1.0f), glm::vec3(-cameraPos, 0.0f));
 		view = glm::scale(view, glm::vec3(cameraZoom, cameraZoom, 1.0f));
@@ -347,25 +802,63 @@ int main(void){
 		}
 
 		processInput(win);
-		shader.setUProjection("uProjection", vp);
 		glClear(GL_COLOR_BUFFER_BIT);
 		shader.use();
+		shader.setUProjection("uProjection", vp);
+
+		sim_controls controls;
+		controls.gravity = gravity_mode;
+		controls.theta = theta;
+		controls.integrator = integrator_mode;
+		controls.dt = time_change;
+		controls.warp = warp_max ? 0 : warp;
+		sim.set_controls(controls);
+
+		/* the bodies belong to the simulation thread now, only its
+		 * snapshots are read here */
+		const sim_snapshot& snap = sim.latest();
+		for(int i=0;i<(int)solar_system.size();i++){
+			solar_system[i].position[0] = (float)snap.x[i];
+			solar_system[i].position[1] = (float)snap.y[i];
+		}
+		if(glfwGetTime() - last_title >= 1.0){
+			char title[128];
+			std::snprintf(title, sizeof(title), "orbit  day %.0f  %.0f steps/s  %.1f days/s",
+				snap.time / 86400, sim.steps_per_second(), sim.days_per_second());
+			glfwSetWindowTitle(win, title);
+			last_title = glfwGetTime();
+		}
 
-		for(int i=0;i<solar_system.size();i++){
-			for(int j=0;j<solar_system.size();j++){
-				if(j!=i){
-					planet_orbit(solar_system[i], solar_system[j]);
-				}
-			}
-			shader.setPlanetColor("planetColor", solar_system[i].color);
-			draw_circle(solar_system[i]);
-			solar_system[i].updatePos(time_change);
+		/* under the planets */
+		append_trails(trails, snap);
+		if(show_trails){
+			trail_shader.use();
+			trail_shader.setUProjection("uProjection", vp);
+			trail_shader.setPlanetColor("trailColor", glm::vec3(0.3f, 0.3f, 0.35f));
+			draw_trails(trails);
+			shader.use();
+		}
+		draw_planets(planet_draw, solar_system, shader);
+
+		/* over the planets, saturn is drawn far bigger than its rings */
+		if(particle_count > 0){
+			upload_points(points, snap.px, snap.py);
+			point_shader.use();
+			point_shader.setUProjection("uProjection", vp);
+			point_shader.setFloat("uPointSize", 2.0f);
+			point_shader.setPlanetColor("planetColor", glm::vec3(0.45f, 0.4f, 0.35f));
+			draw_points(points, 0, belt);
+			point_shader.setPlanetColor("planetColor", glm::vec3(0.8f, 0.75f, 0.6f));
+			draw_points(points, belt, ring_count);
+			point_shader.setPlanetColor("planetColor", glm::vec3(0.7f, 0.7f, 0.75f));
+			draw_points(points, first_loaded, particle_count - first_loaded);
 		}
 
 		glfwSwapBuffers(win);
 		glfwPollEvents();
     }
 
+	sim.stop();
     glfwDestroyWindow(win);
     glfwTerminate();
     return 0;
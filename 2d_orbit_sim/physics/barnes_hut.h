@@ -0,0 +1,300 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include "bodies.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* 31 bits of a cell coordinate spread over the even bits of a 64 bit key */
+inline unsigned long long morton_spread(unsigned long long v){
+	v &= 0x7fffffffull;
+	v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+	v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+	v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+	v = (v | (v << 2)) & 0x3333333333333333ull;
+	v = (v | (v << 1)) & 0x5555555555555555ull;
+	return v;
+}
+
+/* one square cell of the tree. an inner node has up to four children, a
+ * leaf holds the bodies [begin, end) of the sorted order. mass and center
+ * of mass are the monopole every far away body sees */
+struct bh_node{
+	double x0, y0, size; /* lower left corner and side of the cell */
+	double cx, cy, m;    /* center of mass and total mass */
+	double offset;       /* distance from the center of mass to the middle of the cell */
+	int child[4];        /* -1 for an empty quadrant */
+	int begin, end;
+	bool leaf;
+};
+
+/* barnes-hut quadtree, rebuilt every step from the body arrays.
+ *
+ * the bodies are sorted by the morton key of their position on a 2^31 grid
+ * over the bounding square, so every cell of the tree is a contiguous run
+ * of the sorted order and its four children are found by binary search.
+ * the levels above task_level are split on the calling thread, the
+ * subtrees below are built on the pool into their own node lists and
+ * spliced in, then the monopoles of the top levels are summed.
+ *
+ * a cell is used as one point mass when the body is further from its
+ * center of mass than size / theta plus how far that center is from the
+ * middle of the cell, otherwise it is opened. the offset keeps cells whose
+ * mass sits in one corner from being taken as a point too early. theta 0
+ * opens everything and gives the exact sum */
+struct barnes_hut{
+	double theta = 0.5;
+	int leaf_size = 8;
+	double softening = 0; /* meters, added to every distance squared */
+
+	std::vector<bh_node> nodes;
+	std::vector<unsigned long long> keys, keys2;
+	std::vector<int> order, order2;       /* sorted position -> body */
+	std::vector<double> sx, sy, sm;       /* bodies in sorted order */
+	std::vector<int> counts;              /* radix sort, 256 per thread */
+	long long interactions = 0;           /* body-body and body-cell terms of the last pass */
+
+	struct task{
+		int node, begin, end, level;
+		double x0, y0, size;
+	};
+	std::vector<task> tasks;
+	std::vector<std::vector<bh_node>> subtrees;
+	std::vector<char> spliced;
+	std::vector<long long> thread_interactions;
+
+	void build(const body_arrays& b, thread_pool& pool){
+		int n = b.size();
+		nodes.clear();
+		if(n == 0) return;
+
+		/* bounding square, a bit bigger so no body sits on the far edge */
+		double minx = b.x[0], maxx = b.x[0], miny = b.y[0], maxy = b.y[0];
+		for(int i=1;i<n;i++){
+			minx = std::min(minx, b.x[i]); maxx = std::max(maxx, b.x[i]);
+			miny = std::min(miny, b.y[i]); maxy = std::max(maxy, b.y[i]);
+		}
+		double size = std::max(maxx - minx, maxy - miny) * 1.0001 + 1.0;
+		double scale = 2147483648.0 / size;
+
+		keys.resize(n);
+		order.resize(n);
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				unsigned long long qx = (unsigned long long)std::min((b.x[i] - minx) * scale, 2147483647.0);
+				unsigned long long qy = (unsigned long long)std::min((b.y[i] - miny) * scale, 2147483647.0);
+				keys[i] = morton_spread(qx) | (morton_spread(qy) << 1);
+				order[i] = i;
+			}
+		}, 1024);
+		sort(pool);
+
+		sx.resize(n); sy.resize(n); sm.resize(n);
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int k=begin;k<end;k++){
+				sx[k] = b.x[order[k]]; sy[k] = b.y[order[k]]; sm[k] = b.m[order[k]];
+			}
+		}, 1024);
+
+		/* enough subtrees to keep every thread busy */
+		int task_level = 0;
+		while((1 << (2 * task_level)) < 8 * pool.size() && task_level < 6) task_level++;
+		if(pool.size() == 1) task_level = 0;
+
+		tasks.clear();
+		split(nodes, 0, n, 0, minx, miny, size, task_level);
+		int top = (int)nodes.size();
+
+		subtrees.resize(tasks.size());
+		pool.parallel_for((int)tasks.size(), [&](int begin, int end, int){
+			for(int t=begin;t<end;t++){
+				const task& k = tasks[t];
+				subtrees[t].clear();
+				split(subtrees[t], k.begin, k.end, k.level, k.x0, k.y0, k.size, -1);
+			}
+		}, 1);
+
+		/* the root of every subtree replaces its placeholder, the rest is
+		 * appended with the child indices moved */
+		std::vector<int> offset(tasks.size());
+		int total = top;
+		for(int t=0;t<(int)tasks.size();t++){
+			offset[t] = total;
+			total += (int)subtrees[t].size() - 1;
+		}
+		nodes.resize(total);
+		pool.parallel_for((int)tasks.size(), [&](int begin, int end, int){
+			for(int t=begin;t<end;t++){
+				const std::vector<bh_node>& sub = subtrees[t];
+				auto move = [&](int i){ return i < 0 ? -1 : (i == 0 ? tasks[t].node : offset[t] + i - 1); };
+				for(int i=0;i<(int)sub.size();i++){
+					bh_node d = sub[i];
+					for(int c=0;c<4;c++) d.child[c] = move(d.child[c]);
+					nodes[move(i)] = d;
+				}
+			}
+		}, 1);
+
+		/* parents come before their children, so summing backwards goes
+		 * bottom up. leaves and spliced subtrees have theirs already */
+		spliced.assign(top, 0);
+		for(const task& k : tasks) spliced[k.node] = 1;
+		for(int i=top-1;i>=0;i--){
+			if(!nodes[i].leaf && !spliced[i]) monopole(nodes, nodes[i]);
+		}
+	}
+
+	/* gravitational acceleration on every body, written to b.ax and b.ay */
+	void accelerations(body_arrays& b, thread_pool& pool, double G){
+		int n = b.size();
+		if(n == 0) return;
+		thread_interactions.assign(pool.size(), 0);
+		double eps2 = softening * softening;
+		double inv_theta = theta > 0 ? 1.0 / theta : 1e300;
+		pool.parallel_for(n, [&](int begin, int end, int t){
+			int stack[256];
+			long long terms = 0;
+			for(int k=begin;k<end;k++){
+				double px = sx[k], py = sy[k];
+				double ax = 0, ay = 0;
+				int top = 0;
+				stack[top++] = 0;
+				while(top > 0){
+					const bh_node& d = nodes[stack[--top]];
+					if(d.leaf){
+						for(int j=d.begin;j<d.end;j++){
+							if(j == k) continue;
+							double dx = sx[j] - px, dy = sy[j] - py;
+							double r2 = dx*dx + dy*dy + eps2;
+							double inv = sm[j] / (r2 * std::sqrt(r2));
+							ax += dx * inv; ay += dy * inv;
+						}
+						terms += d.end - d.begin;
+						continue;
+					}
+					double dx = d.cx - px, dy = d.cy - py;
+					double r2 = dx*dx + dy*dy;
+					double open = d.size * inv_theta + d.offset;
+					if(r2 > open * open){
+						r2 += eps2;
+						double inv = d.m / (r2 * std::sqrt(r2));
+						ax += dx * inv; ay += dy * inv;
+						terms++;
+						continue;
+					}
+					for(int c=0;c<4;c++){
+						if(d.child[c] >= 0) stack[top++] = d.child[c];
+					}
+				}
+				b.ax[order[k]] = G * ax;
+				b.ay[order[k]] = G * ay;
+			}
+			thread_interactions[t] += terms;
+		}, 64);
+		interactions = 0;
+		for(long long t : thread_interactions) interactions += t;
+	}
+
+private:
+	/* stable lsd radix sort of keys and order, eight bits per pass, the
+	 * same for any thread count */
+	void sort(thread_pool& pool){
+		int n = (int)keys.size();
+		unsigned long long top = 0;
+		for(unsigned long long k : keys) top |= k;
+		keys2.resize(n);
+		order2.resize(n);
+		for(int shift=0;shift<64 && (top >> shift) != 0;shift+=8){
+			counts.assign(256 * pool.size(), 0);
+			pool.parallel_for(n, [&](int begin, int end, int t){
+				int* c = &counts[256 * t];
+				for(int i=begin;i<end;i++) c[(keys[i] >> shift) & 255]++;
+			}, 4096);
+			int sum = 0;
+			for(int d=0;d<256;d++){
+				for(int t=0;t<pool.size();t++){
+					int c = counts[256 * t + d];
+					counts[256 * t + d] = sum;
+					sum += c;
+				}
+			}
+			pool.parallel_for(n, [&](int begin, int end, int t){
+				int* c = &counts[256 * t];
+				for(int i=begin;i<end;i++){
+					int at = c[(keys[i] >> shift) & 255]++;
+					keys2[at] = keys[i];
+					order2[at] = order[i];
+				}
+			}, 4096);
+			keys.swap(keys2);
+			order.swap(order2);
+		}
+	}
+
+	static void monopole(const std::vector<bh_node>& list, bh_node& d){
+		double m = 0, cx = 0, cy = 0;
+		for(int c=0;c<4;c++){
+			if(d.child[c] < 0) continue;
+			const bh_node& e = list[d.child[c]];
+			m += e.m; cx += e.m * e.cx; cy += e.m * e.cy;
+		}
+		d.m = m;
+		d.cx = m > 0 ? cx / m : d.x0 + 0.5 * d.size;
+		d.cy = m > 0 ? cy / m : d.y0 + 0.5 * d.size;
+		set_offset(d);
+	}
+
+	static void set_offset(bh_node& d){
+		d.offset = std::hypot(d.cx - (d.x0 + 0.5 * d.size), d.cy - (d.y0 + 0.5 * d.size));
+	}
+
+	/* builds the cell of the sorted bodies [begin, end) into list, children
+	 * after their parent. at stop_level the cell is left as a placeholder
+	 * and queued as a task instead, -1 never stops */
+	int split(std::vector<bh_node>& list, int begin, int end, int level, double x0, double y0, double size, int stop_level){
+		int at = (int)list.size();
+		list.push_back(bh_node());
+		bh_node d;
+		d.x0 = x0; d.y0 = y0; d.size = size;
+		d.begin = begin; d.end = end;
+		d.child[0] = d.child[1] = d.child[2] = d.child[3] = -1;
+		d.leaf = end - begin <= leaf_size || level >= 31;
+		d.m = d.cx = d.cy = d.offset = 0;
+		if(level == stop_level && !d.leaf){
+			list[at] = d;
+			tasks.push_back({at, begin, end, level, x0, y0, size});
+			return at;
+		}
+		if(d.leaf){
+			for(int j=begin;j<end;j++){
+				d.m += sm[j]; d.cx += sm[j] * sx[j]; d.cy += sm[j] * sy[j];
+			}
+			d.cx = d.m > 0 ? d.cx / d.m : x0 + 0.5 * size;
+			d.cy = d.m > 0 ? d.cy / d.m : y0 + 0.5 * size;
+			set_offset(d);
+			list[at] = d;
+			return at;
+		}
+		/* the two key bits of this level pick the quadrant, x in the low bit */
+		int shift = 2 * (30 - level);
+		double half = 0.5 * size;
+		int from = begin;
+		for(int q=0;q<4;q++){
+			int to = (int)(std::upper_bound(keys.begin() + from, keys.begin() + end, (unsigned long long)q,
+				[shift](unsigned long long v, unsigned long long key){ return v < ((key >> shift) & 3); }) - keys.begin());
+			if(to > from){
+				int c = split(list, from, to, level + 1, x0 + (q & 1) * half, y0 + (q >> 1) * half, half, stop_level);
+				d.child[q] = c;
+			}
+			from = to;
+		}
+		/* above the subtrees the children are not built yet */
+		if(stop_level < 0) monopole(list, d);
+		list[at] = d;
+		return at;
+	}
+};
+
+#endif
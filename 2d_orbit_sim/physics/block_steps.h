@@ -0,0 +1,196 @@
+#ifndef BLOCK_STEPS_H
+#define BLOCK_STEPS_H
+
+#include "bodies.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* individual time steps on a power of two hierarchy, integrated with the
+ * fourth order hermite predictor-corrector.
+ *
+ * every body steps by max_step / 2^level and its level is picked after
+ * each of its steps from eta * |a| / |jerk|, so the moon takes hundreds of
+ * steps while neptune takes one. time is counted in ticks of
+ * max_step / 2^max_level, so steps of every level line up exactly. the
+ * next block is the earliest time a body is due: every body is predicted
+ * to it, only the due ones get their acceleration and jerk from the
+ * predicted positions and are corrected. a body may halve its step at
+ * any time but only doubles it where the bigger step lines up with the
+ * block it is in.
+ *
+ * the state of every body lives here at its own last time. advance()
+ * runs every block up to the end of the frame and writes the predicted
+ * positions and velocities of that moment back into the body arrays.
+ * anything that changes the bodies from outside has to call reset() */
+struct block_steps{
+	double eta = 0.01;          /* step = eta * |a| / |jerk| */
+	double max_step = 8 * 86400.0;
+	int max_level = 30;
+	bool shared = false;        /* every body takes the smallest step, for comparison */
+	long long forces = 0;       /* bodies whose acceleration was computed */
+	long long blocks = 0;
+
+	void reset(){
+		ready = false;
+	}
+
+	void advance(body_arrays& b, thread_pool& pool, double G, double span){
+		int n = b.size();
+		if(!ready) start(b, pool, G);
+		double tick_len = max_step / (double)(1ll << max_level);
+		double end = time + span;
+		long long end_tick = (long long)std::floor(end / tick_len);
+
+		for(;;){
+			long long next = -1;
+			for(int i=0;i<n;i++){
+				long long due = t[i] + ticks(level[i]);
+				if(next < 0 || due < next) next = due;
+			}
+			if(n == 0 || next > end_tick) break;
+			active.clear();
+			for(int i=0;i<n;i++){
+				if(t[i] + ticks(level[i]) == next) active.push_back(i);
+			}
+			predict(next * tick_len, tick_len, pool);
+			evaluate(pool, G);
+			for(int k=0;k<(int)active.size();k++) correct(k, next, tick_len);
+			if(shared) share();
+			blocks++;
+		}
+
+		time = end;
+		predict(end, tick_len, pool);
+		for(int i=0;i<n;i++){
+			b.x[i] = px[i]; b.y[i] = py[i];
+			b.vx[i] = pvx[i]; b.vy[i] = pvy[i];
+		}
+	}
+
+	/* the smallest step a body takes right now, in seconds */
+	double smallest_step() const{
+		int top = 0;
+		for(int l : level) top = std::max(top, l);
+		return max_step / (double)(1ll << top);
+	}
+
+private:
+	bool ready = false;
+	double time = 0;                        /* seconds since start() */
+	std::vector<double> x, y, vx, vy, m;    /* at each body's own time */
+	std::vector<double> ax, ay, jx, jy;
+	std::vector<long long> t;               /* ticks */
+	std::vector<int> level;
+	std::vector<double> px, py, pvx, pvy;   /* predicted to the block */
+	std::vector<int> active;
+	std::vector<double> nax, nay, njx, njy; /* of the active bodies */
+
+	long long ticks(int l) const{
+		return 1ll << (max_level - l);
+	}
+
+	void start(const body_arrays& b, thread_pool& pool, double G){
+		int n = b.size();
+		x = b.x; y = b.y; vx = b.vx; vy = b.vy; m = b.m;
+		ax.assign(n, 0); ay.assign(n, 0); jx.assign(n, 0); jy.assign(n, 0);
+		t.assign(n, 0);
+		level.assign(n, 0);
+		px = x; py = y; pvx = vx; pvy = vy;
+		active.resize(n);
+		for(int i=0;i<n;i++) active[i] = i;
+		evaluate(pool, G);
+		for(int i=0;i<n;i++){
+			ax[i] = nax[i]; ay[i] = nay[i]; jx[i] = njx[i]; jy[i] = njy[i];
+			level[i] = pick(i, 0, max_level);
+		}
+		if(shared) share();
+		time = 0;
+		ready = true;
+	}
+
+	/* every body to time s, from its own time with the hermite predictor */
+	void predict(double s, double tick_len, thread_pool& pool){
+		int n = (int)x.size();
+		px.resize(n); py.resize(n); pvx.resize(n); pvy.resize(n);
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				double h = s - t[i] * tick_len;
+				double h2 = 0.5 * h * h, h3 = h * h * h / 6.0;
+				px[i] = x[i] + vx[i] * h + ax[i] * h2 + jx[i] * h3;
+				py[i] = y[i] + vy[i] * h + ay[i] * h2 + jy[i] * h3;
+				pvx[i] = vx[i] + ax[i] * h + jx[i] * h2;
+				pvy[i] = vy[i] + ay[i] * h + jy[i] * h2;
+			}
+		}, 256);
+	}
+
+	/* acceleration and jerk of the active bodies from every predicted one */
+	void evaluate(thread_pool& pool, double G){
+		int n = (int)x.size(), na = (int)active.size();
+		nax.resize(na); nay.resize(na); njx.resize(na); njy.resize(na);
+		pool.parallel_for(na, [&](int begin, int end, int){
+			for(int k=begin;k<end;k++){
+				int i = active[k];
+				double sax = 0, say = 0, sjx = 0, sjy = 0;
+				for(int j=0;j<n;j++){
+					if(j == i) continue;
+					double dx = px[j] - px[i], dy = py[j] - py[i];
+					double dvx = pvx[j] - pvx[i], dvy = pvy[j] - pvy[i];
+					double r2 = dx*dx + dy*dy;
+					double inv2 = 1.0 / r2;
+					double inv3 = m[j] * inv2 * std::sqrt(inv2);
+					double rv = 3.0 * (dx*dvx + dy*dvy) * inv2;
+					sax += dx * inv3; say += dy * inv3;
+					sjx += (dvx - rv * dx) * inv3;
+					sjy += (dvy - rv * dy) * inv3;
+				}
+				nax[k] = G * sax; nay[k] = G * say;
+				njx[k] = G * sjx; njy[k] = G * sjy;
+			}
+		}, 4);
+		forces += na;
+	}
+
+	/* hermite corrector of the k-th active body, then its next level */
+	void correct(int k, long long now, double tick_len){
+		int i = active[k];
+		double h = ticks(level[i]) * tick_len;
+		double h2 = h * h / 12.0;
+		double nvx = vx[i] + 0.5 * (ax[i] + nax[k]) * h + (jx[i] - njx[k]) * h2;
+		double nvy = vy[i] + 0.5 * (ay[i] + nay[k]) * h + (jy[i] - njy[k]) * h2;
+		x[i] += 0.5 * (vx[i] + nvx) * h + (ax[i] - nax[k]) * h2;
+		y[i] += 0.5 * (vy[i] + nvy) * h + (ay[i] - nay[k]) * h2;
+		vx[i] = nvx; vy[i] = nvy;
+		ax[i] = nax[k]; ay[i] = nay[k];
+		jx[i] = njx[k]; jy[i] = njy[k];
+		t[i] = now;
+
+		/* one level up at most, and only where that step lines up. every
+		 * deeper level lines up, now is a multiple of the current step */
+		int up = level[i];
+		if(up > 0 && now % ticks(up - 1) == 0) up--;
+		level[i] = pick(i, up, max_level);
+	}
+
+	/* the biggest step from lowest up to max_level that the criterion allows */
+	int pick(int i, int lowest, int highest) const{
+		double a = std::sqrt(ax[i]*ax[i] + ay[i]*ay[i]);
+		double j = std::sqrt(jx[i]*jx[i] + jy[i]*jy[i]);
+		double want = j > 0 ? eta * a / j : max_step;
+		int l = lowest;
+		while(l < highest && max_step / (double)(1ll << l) > want) l++;
+		return l;
+	}
+
+	/* the shared step: everyone on the deepest level. only called at times
+	 * every body is synchronized on, so any level lines up */
+	void share(){
+		int top = 0;
+		for(int l : level) top = std::max(top, l);
+		for(int& l : level) l = top;
+	}
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef BODIES_H
+#define BODIES_H
+
+#include <vector>
+
+/* the state of every body in flat arrays: position, velocity and mass,
+ * and the accelerations the gravity passes write. meters, meters per
+ * second, kilograms and meters per second squared */
+struct body_arrays{
+	std::vector<double> x, y;
+	std::vector<double> vx, vy;
+	std::vector<double> m;
+	std::vector<double> ax, ay;
+
+	int size() const{
+		return (int)x.size();
+	}
+
+	void resize(int n){
+		x.resize(n); y.resize(n);
+		vx.resize(n); vy.resize(n);
+		m.resize(n);
+		ax.resize(n); ay.resize(n);
+	}
+};
+
+#endif
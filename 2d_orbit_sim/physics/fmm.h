@@ -0,0 +1,322 @@
+#ifndef FMM_H
+#define FMM_H
+
+#include "bodies.h"
+#include "barnes_hut.h"
+#include "thread_pool.h"
+#include "simd_gravity.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* fast multipole method on the barnes-hut quadtree.
+ *
+ * every cell gets a multipole expansion of its bodies about its center of
+ * mass and a local expansion of the field of far away cells about the
+ * same point, both as taylor coefficients in x and y up to total order
+ * `order`. the forces are newton's 1/r^2 in the plane, the gradient of the
+ * 3d potential 1/r, so the expansions are the cartesian ones of 1/r. the
+ * complex laurent series of the 2d fmm belong to the log potential and
+ * would change the physics.
+ *
+ * one pass is:
+ *  - upward, level by level from the deepest: leaves sum their bodies
+ *    into a multipole (p2m), inner cells shift their children's (m2m)
+ *  - a traversal of every target cell against the source tree: a pair of
+ *    cells further apart than (r_a + r_b) / theta turns the source's
+ *    multipole into a local of the target (m2l), two leaves that are not
+ *    sum their bodies directly (p2p), anything else splits the bigger
+ *    cell. the targets are disjoint subtrees on the pool, so nothing is
+ *    written by two threads
+ *  - downward, level by level from the root: every cell shifts its
+ *    parent's local onto itself (l2l), leaves add the gradient of theirs
+ *    to their bodies (l2p)
+ *
+ * with order and theta fixed every cell does a bounded number of m2l and
+ * every leaf a bounded number of p2p, so the cost grows with n. the error
+ * falls roughly as theta^(order+1). softening only applies to the direct
+ * pairs */
+struct fast_multipole{
+	int order = 8;          /* 1 to 16, higher overflows doubles on wide scenes */
+	double theta = 0.5;
+	int leaf_size = 64;
+	double softening = 0;
+	int simd = simd_best();     /* kernel of the direct pairs */
+	long long m2l = 0, p2p = 0; /* cell-cell and body-body terms of the last pass */
+
+	void accelerations(body_arrays& b, thread_pool& pool, double G){
+		int n = b.size();
+		if(n == 0) return;
+		setup();
+		tree.leaf_size = leaf_size;
+		tree.build(b, pool);
+		int count = (int)tree.nodes.size();
+		radius.assign(count, 0);
+		multipole.assign((size_t)count * coefs, 0.0);
+		local.assign((size_t)count * coefs, 0.0);
+		fx.assign(n, 0.0);
+		fy.assign(n, 0.0);
+		levels_of_tree(pool.size());
+
+		for(int d=(int)levels.size()-1;d>=0;d--){
+			pool.parallel_for((int)levels[d].size(), [&](int begin, int end, int){
+				for(int k=begin;k<end;k++) upward(levels[d][k]);
+			}, 16);
+		}
+
+		thread_m2l.assign(pool.size(), 0);
+		thread_p2p.assign(pool.size(), 0);
+		double eps2 = softening * softening;
+		pool.parallel_for((int)targets.size(), [&](int begin, int end, int t){
+			std::vector<double> T(coefs), W(coefs);
+			for(int k=begin;k<end;k++) interact(targets[k], 0, T.data(), W.data(), eps2, t);
+		}, 1);
+		m2l = p2p = 0;
+		for(long long c : thread_m2l) m2l += c;
+		for(long long c : thread_p2p) p2p += c;
+
+		for(int d=0;d<(int)levels.size();d++){
+			pool.parallel_for((int)levels[d].size(), [&](int begin, int end, int){
+				for(int k=begin;k<end;k++) downward(levels[d][k]);
+			}, 16);
+		}
+
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int k=begin;k<end;k++){
+				b.ax[tree.order[k]] = G * fx[k];
+				b.ay[tree.order[k]] = G * fy[k];
+			}
+		}, 1024);
+	}
+
+private:
+	barnes_hut tree;
+	int coefs = 0, built_order = -1;
+	std::vector<double> binom;              /* pascal's triangle up to order */
+	double fact[17], inv_fact[17];
+	std::vector<double> radius;             /* of every cell around its center of mass */
+	std::vector<double> multipole, local;   /* coefs per cell */
+	std::vector<double> fx, fy;             /* per sorted body, without G */
+	std::vector<int> parent;
+	std::vector<std::vector<int>> levels;   /* cells by depth */
+	std::vector<int> targets;               /* disjoint subtrees covering every body */
+	std::vector<long long> thread_m2l, thread_p2p;
+
+	/* coefficient (a, b) of x^a y^b, ordered by total order */
+	static int at(int a, int b){
+		int k = a + b;
+		return k * (k + 1) / 2 + b;
+	}
+
+	double choose(int n, int k) const{
+		return binom[n * (order + 1) + k];
+	}
+
+	void setup(){
+		order = std::max(1, std::min(16, order));
+		if(order == built_order) return;
+		built_order = order;
+		coefs = (order + 1) * (order + 2) / 2;
+		fact[0] = inv_fact[0] = 1;
+		for(int k=1;k<=order;k++){
+			fact[k] = fact[k - 1] * k;
+			inv_fact[k] = 1.0 / fact[k];
+		}
+		binom.assign((order + 1) * (order + 1), 0.0);
+		for(int i=0;i<=order;i++){
+			binom[i * (order + 1)] = 1;
+			for(int k=1;k<=i;k++) binom[i * (order + 1) + k] = binom[(i - 1) * (order + 1) + k - 1] + binom[(i - 1) * (order + 1) + k];
+		}
+	}
+
+	/* depth and parent of every cell, and the subtrees the traversal is
+	 * split into: every cell at a depth with enough of them for the pool,
+	 * or a leaf above it */
+	void levels_of_tree(int threads){
+		int count = (int)tree.nodes.size();
+		int split_depth = 0;
+		while((1 << (2 * split_depth)) < 8 * threads && split_depth < 6) split_depth++;
+		if(threads == 1) split_depth = 0;
+		parent.assign(count, -1);
+		for(auto& l : levels) l.clear();
+		targets.clear();
+		std::vector<std::pair<int, int>> stack = {{0, 0}};
+		while(!stack.empty()){
+			auto [i, d] = stack.back();
+			stack.pop_back();
+			if((int)levels.size() <= d) levels.resize(d + 1);
+			levels[d].push_back(i);
+			const bh_node& c = tree.nodes[i];
+			if(d == split_depth || (c.leaf && d < split_depth)) targets.push_back(i);
+			if(c.leaf) continue;
+			for(int q=0;q<4;q++){
+				if(c.child[q] < 0) continue;
+				parent[c.child[q]] = i;
+				stack.push_back({c.child[q], d + 1});
+			}
+		}
+		while(!levels.empty() && levels.back().empty()) levels.pop_back();
+	}
+
+	/* p2m for a leaf, m2m from the children for an inner cell */
+	void upward(int i){
+		const bh_node& c = tree.nodes[i];
+		double* M = &multipole[(size_t)i * coefs];
+		double px[17], py[17];
+		if(c.leaf){
+			double r = 0;
+			for(int j=c.begin;j<c.end;j++){
+				double dx = tree.sx[j] - c.cx, dy = tree.sy[j] - c.cy;
+				r = std::max(r, dx*dx + dy*dy);
+				powers(dx, dy, px, py);
+				for(int a=0;a<=order;a++){
+					for(int e=0;a+e<=order;e++) M[at(a, e)] += tree.sm[j] * px[a] * py[e];
+				}
+			}
+			radius[i] = std::sqrt(r);
+			return;
+		}
+		double r = 0;
+		for(int q=0;q<4;q++){
+			int k = c.child[q];
+			if(k < 0) continue;
+			const bh_node& h = tree.nodes[k];
+			const double* C = &multipole[(size_t)k * coefs];
+			double dx = h.cx - c.cx, dy = h.cy - c.cy;
+			r = std::max(r, std::sqrt(dx*dx + dy*dy) + radius[k]);
+			powers(dx, dy, px, py);
+			/* (d + s)^k summed over the child's moments s^m */
+			for(int a=0;a<=order;a++){
+				for(int e=0;a+e<=order;e++){
+					double sum = 0;
+					for(int u=0;u<=a;u++){
+						for(int v=0;v<=e;v++) sum += choose(a, u) * choose(e, v) * px[a - u] * py[e - v] * C[at(u, v)];
+					}
+					M[at(a, e)] += sum;
+				}
+			}
+		}
+		radius[i] = r;
+	}
+
+	/* everything source cell s does to the bodies of target cell t */
+	void interact(int t, int s, double* T, double* W, double eps2, int thread){
+		const bh_node& a = tree.nodes[t];
+		const bh_node& c = tree.nodes[s];
+		double dx = a.cx - c.cx, dy = a.cy - c.cy;
+		double d2 = dx*dx + dy*dy;
+		double reach = radius[t] + radius[s];
+		if(reach * reach < theta * theta * d2){
+			multipole_to_local(t, s, dx, dy, T, W);
+			thread_m2l[thread]++;
+			return;
+		}
+		if(a.leaf && c.leaf){
+			gravity_block(tree.sx.data(), tree.sy.data(), a.begin, a.end, tree.sx.data(), tree.sy.data(), tree.sm.data(), c.begin, c.end, fx.data(), fy.data(), eps2, simd);
+			thread_p2p[thread] += (long long)(a.end - a.begin) * (c.end - c.begin);
+			return;
+		}
+		if(c.leaf || (!a.leaf && radius[t] > radius[s])){
+			for(int q=0;q<4;q++){
+				if(a.child[q] >= 0) interact(a.child[q], s, T, W, eps2, thread);
+			}
+		}
+		else{
+			for(int q=0;q<4;q++){
+				if(c.child[q] >= 0) interact(t, c.child[q], T, W, eps2, thread);
+			}
+		}
+	}
+
+	/* the taylor coefficients T(a, b) = d^a/dx^a d^b/dy^b (1/r) / (a! b!)
+	 * by the recurrence n r^2 T(n) = -(2n - 1) (x T(n - e_x) + y T(n - e_y))
+	 * - (n - 1) (T(n - 2 e_x) + T(n - 2 e_y)) */
+	void derivatives(double x, double y, double* T) const{
+		double inv2 = 1.0 / (x*x + y*y);
+		T[0] = std::sqrt(inv2);
+		for(int k=1;k<=order;k++){
+			for(int e=0;e<=k;e++){
+				int a = k - e;
+				double first = 0, second = 0;
+				if(a > 0) first += x * T[at(a - 1, e)];
+				if(e > 0) first += y * T[at(a, e - 1)];
+				if(a > 1) second += T[at(a - 2, e)];
+				if(e > 1) second += T[at(a, e - 2)];
+				T[at(a, e)] = -((2 * k - 1) * first + (k - 1) * second) * inv2 / k;
+			}
+		}
+	}
+
+	/* the field of source s about the center of t, which is d from it:
+	 * 1/|d + x - y| summed over the source's moments y^m, as a series in
+	 * x. with D(k) = T(k) k! the binomials cancel into factorials,
+	 * L(k) k! = sum over m of D(k + m) (-1)^|m| M(m) / m! */
+	void multipole_to_local(int t, int s, double dx, double dy, double* T, double* W){
+		derivatives(dx, dy, T);
+		const double* M = &multipole[(size_t)s * coefs];
+		double* L = &local[(size_t)t * coefs];
+		for(int k=0;k<=order;k++){
+			for(int e=0;e<=k;e++){
+				int a = k - e;
+				T[at(a, e)] *= fact[a] * fact[e];
+				W[at(a, e)] = (k & 1 ? -M[at(a, e)] : M[at(a, e)]) * inv_fact[a] * inv_fact[e];
+			}
+		}
+		/* for one total order q of m both T(k + m) and W(m) are contiguous */
+		for(int a=0;a<=order;a++){
+			for(int e=0;a+e<=order;e++){
+				double sum = 0;
+				for(int q=0;a+e+q<=order;q++){
+					const double* t = T + at(a + q, e);
+					const double* w = W + at(q, 0);
+					for(int v=0;v<=q;v++) sum += t[v] * w[v];
+				}
+				L[at(a, e)] += sum * inv_fact[a] * inv_fact[e];
+			}
+		}
+	}
+
+	/* l2l from the parent, then l2p for a leaf */
+	void downward(int i){
+		const bh_node& c = tree.nodes[i];
+		double* L = &local[(size_t)i * coefs];
+		double px[17], py[17];
+		if(parent[i] >= 0){
+			const bh_node& h = tree.nodes[parent[i]];
+			const double* P = &local[(size_t)parent[i] * coefs];
+			powers(c.cx - h.cx, c.cy - h.cy, px, py);
+			for(int u=0;u<=order;u++){
+				for(int v=0;u+v<=order;v++){
+					double sum = 0;
+					for(int a=u;a<=order;a++){
+						for(int e=v;a+e<=order;e++) sum += choose(a, u) * choose(e, v) * px[a - u] * py[e - v] * P[at(a, e)];
+					}
+					L[at(u, v)] += sum;
+				}
+			}
+		}
+		if(!c.leaf) return;
+		for(int k=c.begin;k<c.end;k++){
+			powers(tree.sx[k] - c.cx, tree.sy[k] - c.cy, px, py);
+			double ax = 0, ay = 0;
+			for(int a=0;a<=order;a++){
+				for(int e=0;a+e<=order;e++){
+					if(a > 0) ax += a * L[at(a, e)] * px[a - 1] * py[e];
+					if(e > 0) ay += e * L[at(a, e)] * px[a] * py[e - 1];
+				}
+			}
+			fx[k] += ax;
+			fy[k] += ay;
+		}
+	}
+
+	void powers(double x, double y, double* px, double* py) const{
+		px[0] = py[0] = 1;
+		for(int k=1;k<=order;k++){
+			px[k] = px[k - 1] * x;
+			py[k] = py[k - 1] * y;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include "bodies.h"
+#include "barnes_hut.h"
+#include "fmm.h"
+#include "simd_gravity.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* how the accelerations are computed, switched at runtime */
+enum gravity_kind{
+	GRAVITY_DIRECT,     /* every pair, exact, O(n^2) */
+	GRAVITY_TREE,       /* barnes-hut, O(n log n) */
+	GRAVITY_PAIRS,      /* every pair once, newton's third law gives the other half */
+	GRAVITY_FMM,        /* fast multipole, O(n) */
+	GRAVITY_COUNT
+};
+
+inline const char* gravity_kind_name(int kind){
+	static const char* names[GRAVITY_COUNT] = {"direct", "tree", "pairs", "fmm"};
+	return kind >= 0 && kind < GRAVITY_COUNT ? names[kind] : "?";
+}
+
+/* exact sum over every other body, in groups of eight targets on the
+ * pool so a vector never straddles two chunks. the reference the tree is
+ * checked against. level picks the kernel, see simd_gravity.h */
+inline void direct_gravity(body_arrays& b, thread_pool& pool, double G, double softening = 0, int level = simd_best()){
+	int n = b.size();
+	double eps2 = softening * softening;
+	if(!simd_supported(level)) level = SIMD_SCALAR;
+	pool.parallel_for((n + 7) / 8, [&](int begin, int end, int){
+		direct_gravity_range(b, begin * 8, std::min(n, end * 8), G, eps2, level);
+	}, 2);
+}
+
+/* the exact sum with every pair computed once and applied to both bodies
+ * with opposite signs, half the pairs of direct_gravity. the triangle of
+ * pairs is cut into square tiles, small enough that the columns of a
+ * tile stay in cache while all of its rows run over them.
+ * block rows go to the pool two at a time, block k with the one mirrored
+ * to it, so every unit holds the same number of tiles and the plain
+ * chunking stays balanced. the contributions land in accumulators owned
+ * by the thread, and a second pass adds up the accumulators of the
+ * threads that ran, so no two threads ever write the same memory and
+ * nothing is atomic. the memory is threads * n * 2 doubles */
+struct pair_gravity{
+	int tile = 1024;    /* largest tile, smaller ones keep four block rows per thread */
+
+	void accelerations(body_arrays& b, thread_pool& pool, double G, double softening = 0, int level = simd_best()){
+		int n = b.size();
+		int threads = pool.size();
+		size = std::max(64, std::min(tile, n / (4 * threads)) / 8 * 8);
+		int blocks = (n + size - 1) / size;
+		double eps2 = softening * softening;
+		if(!simd_supported(level)) level = SIMD_SCALAR;
+		if((int)accx.size() < threads){
+			accx.resize(threads);
+			accy.resize(threads);
+		}
+		ran.assign(threads, 0);
+		pool.parallel_for((blocks + 1) / 2, [&](int begin, int end, int t){
+			std::vector<double>& sx = accx[t];
+			std::vector<double>& sy = accy[t];
+			sx.assign(n, 0.0);
+			sy.assign(n, 0.0);
+			ran[t] = 1;
+			for(int k=begin;k<end;k++){
+				block_row(b, k, n, sx.data(), sy.data(), eps2, level);
+				if(blocks - 1 - k != k) block_row(b, blocks - 1 - k, n, sx.data(), sy.data(), eps2, level);
+			}
+		}, 1);
+		used.clear();
+		for(int t=0;t<threads;t++){
+			if(ran[t]) used.push_back(t);
+		}
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				double ax = 0, ay = 0;
+				for(int t : used){
+					ax += accx[t][i];
+					ay += accy[t][i];
+				}
+				b.ax[i] = G * ax;
+				b.ay[i] = G * ay;
+			}
+		}, 1024);
+	}
+
+private:
+	/* the triangle inside block i, then its tiles with every later block */
+	void block_row(const body_arrays& b, int block, int n, double* sx, double* sy, double eps2, int level) const{
+		int begin = block * size, end = std::min(n, begin + size);
+		for(int i=begin;i<end;i++) pair_row(b, i, i + 1, end, sx, sy, eps2, level);
+		for(int j=end;j<n;j+=size) pair_rows(b, begin, end, j, std::min(n, j + size), sx, sy, eps2, level);
+	}
+
+	int size = 0;
+	std::vector<std::vector<double>> accx, accy;
+	std::vector<char> ran;
+	std::vector<int> used;
+};
+
+struct gravity_solver{
+	int kind = GRAVITY_TREE;
+	double G = 6.674e-11;
+	double softening = 0;
+	int simd = simd_best();     /* kernel of the direct sum */
+	thread_pool pool;
+	barnes_hut tree;
+	pair_gravity pairs;
+	fast_multipole fmm;
+	long long interactions = 0; /* terms summed by the last pass */
+
+	explicit gravity_solver(int threads = 0) : pool(threads){}
+
+	void accelerations(body_arrays& b){
+		if(kind == GRAVITY_TREE){
+			tree.softening = softening;
+			tree.build(b, pool);
+			tree.accelerations(b, pool, G);
+			interactions = tree.interactions;
+		}
+		else if(kind == GRAVITY_FMM){
+			fmm.softening = softening;
+			fmm.simd = simd;
+			fmm.accelerations(b, pool, G);
+			interactions = fmm.m2l + fmm.p2p;
+		}
+		else if(kind == GRAVITY_PAIRS){
+			pairs.accelerations(b, pool, G, softening, simd);
+			interactions = (long long)b.size() * (b.size() - 1) / 2;
+		}
+		else{
+			direct_gravity(b, pool, G, softening, simd);
+			interactions = (long long)b.size() * (b.size() - 1);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "bodies.h"
+#include "gravity.h"
+#include "block_steps.h"
+#include <cmath>
+
+/* how a step advances positions and velocities. every scheme computes all
+ * accelerations from one consistent set of positions */
+enum integrator_kind{
+	INTEGRATOR_EULER,    /* semi-implicit euler: kick, drift. first order */
+	INTEGRATOR_LEAPFROG, /* kick half, drift, kick half. second order */
+	INTEGRATOR_VERLET,   /* velocity verlet, second order */
+	INTEGRATOR_YOSHIDA4, /* three leapfrogs of yoshida's weights, fourth order */
+	INTEGRATOR_BLOCK,    /* hermite with a step per body, see block_steps.h */
+	INTEGRATOR_COUNT
+};
+
+inline const char* integrator_kind_name(int kind){
+	static const char* names[INTEGRATOR_COUNT] = {"euler", "leapfrog", "verlet", "yoshida4", "block"};
+	return kind >= 0 && kind < INTEGRATOR_COUNT ? names[kind] : "?";
+}
+
+/* the fixed step schemes are symplectic, so the energy error stays
+ * bounded instead of drifting. leapfrog and verlet are the same
+ * trajectory written two ways, and both reuse the accelerations of the
+ * end of the last step, so they cost one force pass per step like euler.
+ * yoshida costs three, but its error falls with dt^4, which buys far
+ * longer steps for the same error.
+ * the block scheme is not symplectic but gives every body the step it
+ * needs, the frame step only says when to draw. it takes jerks, so it
+ * always sums directly and ignores the tree.
+ *
+ * b.ax and b.ay are trusted to belong to the current positions while
+ * have_accel is set. anything that moves bodies or changes masses or the
+ * force between steps has to call invalidate() */
+struct integrator{
+	int kind = INTEGRATOR_LEAPFROG;
+	bool have_accel = false;
+	long long force_passes = 0;
+	long long forces = 0;       /* bodies whose acceleration was computed */
+	block_steps blocks;
+
+	void invalidate(){
+		have_accel = false;
+		blocks.reset();
+	}
+
+	void step(body_arrays& b, gravity_solver& g, double dt){
+		if(kind != last_kind) invalidate();
+		last_kind = kind;
+		switch(kind){
+		case INTEGRATOR_EULER:
+			accelerations(b, g);
+			kick(b, dt);
+			drift(b, dt);
+			have_accel = false;
+			break;
+		case INTEGRATOR_LEAPFROG:
+			if(!have_accel) accelerations(b, g);
+			kick(b, 0.5 * dt);
+			drift(b, dt);
+			accelerations(b, g);
+			kick(b, 0.5 * dt);
+			break;
+		case INTEGRATOR_VERLET:
+			verlet(b, g, dt);
+			break;
+		case INTEGRATOR_YOSHIDA4:
+			yoshida4(b, g, dt);
+			break;
+		case INTEGRATOR_BLOCK:{
+			long long before = blocks.forces;
+			blocks.advance(b, g.pool, g.G, dt);
+			forces += blocks.forces - before;
+			have_accel = false;
+			break;
+		}
+		}
+	}
+
+private:
+	int last_kind = -1;
+
+	void accelerations(body_arrays& b, gravity_solver& g){
+		g.accelerations(b);
+		force_passes++;
+		forces += b.size();
+		have_accel = true;
+	}
+
+	static void kick(body_arrays& b, double dt){
+		for(int i=0;i<b.size();i++){
+			b.vx[i] += b.ax[i] * dt;
+			b.vy[i] += b.ay[i] * dt;
+		}
+	}
+
+	static void drift(body_arrays& b, double dt){
+		for(int i=0;i<b.size();i++){
+			b.x[i] += b.vx[i] * dt;
+			b.y[i] += b.vy[i] * dt;
+		}
+	}
+
+	/* x += v dt + a dt^2 / 2, then v += (a + a') dt / 2 */
+	void verlet(body_arrays& b, gravity_solver& g, double dt){
+		if(!have_accel) accelerations(b, g);
+		int n = b.size();
+		old_ax.assign(b.ax.begin(), b.ax.end());
+		old_ay.assign(b.ay.begin(), b.ay.end());
+		for(int i=0;i<n;i++){
+			b.x[i] += (b.vx[i] + 0.5 * b.ax[i] * dt) * dt;
+			b.y[i] += (b.vy[i] + 0.5 * b.ay[i] * dt) * dt;
+		}
+		accelerations(b, g);
+		for(int i=0;i<n;i++){
+			b.vx[i] += 0.5 * (old_ax[i] + b.ax[i]) * dt;
+			b.vy[i] += 0.5 * (old_ay[i] + b.ay[i]) * dt;
+		}
+	}
+
+	/* yoshida's fourth order composition as drift, kick, drift, kick,
+	 * drift, kick, drift. the middle kick has a negative weight, so it
+	 * steps back in time */
+	void yoshida4(body_arrays& b, gravity_solver& g, double dt){
+		const double cbrt2 = std::cbrt(2.0);
+		const double w1 = 1.0 / (2.0 - cbrt2), w0 = -cbrt2 / (2.0 - cbrt2);
+		const double c[4] = {0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1};
+		const double d[3] = {w1, w0, w1};
+		for(int k=0;k<3;k++){
+			drift(b, c[k] * dt);
+			accelerations(b, g);
+			kick(b, d[k] * dt);
+		}
+		drift(b, c[3] * dt);
+		have_accel = false;
+	}
+
+	std::vector<double> old_ax, old_ay;
+};
+
+/* kinetic plus potential energy by the exact pair sum, to measure how far
+ * an integrator drifts. O(n^2), meant for small systems */
+inline double total_energy(const body_arrays& b, double G){
+	double kinetic = 0, potential = 0;
+	int n = b.size();
+	for(int i=0;i<n;i++){
+		kinetic += 0.5 * b.m[i] * (b.vx[i]*b.vx[i] + b.vy[i]*b.vy[i]);
+		for(int j=i+1;j<n;j++){
+			double dx = b.x[j] - b.x[i], dy = b.y[j] - b.y[i];
+			potential -= G * b.m[i] * b.m[j] / std::sqrt(dx*dx + dy*dy);
+		}
+	}
+	return kinetic + potential;
+}
+
+#endif
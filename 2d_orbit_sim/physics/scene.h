@@ -0,0 +1,102 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "bodies.h"
+#include "test_particles.h"
+#include <vector>
+#include <random>
+#include <cmath>
+
+/* a flat disk of small bodies on circular orbits around one heavy center,
+ * for asteroid belts and galaxy sized tests. radii are uniform in area
+ * between r_in and r_out, masses uniform in [0.5, 1.5] * m */
+struct disk_params{
+	int bodies = 10000;
+	double center_mass = 1.9885e30;   /* the sun */
+	double mass = 1e20;
+	double r_in = 3.3e11, r_out = 4.9e11;
+	unsigned seed = 1234;
+};
+
+/* body 0 is the center, at rest at the origin */
+inline void generate_disk(body_arrays& b, const disk_params& p, double G = 6.674e-11){
+	std::mt19937 rng(p.seed);
+	std::uniform_real_distribution<double> u(0.0, 1.0);
+	int n = p.bodies + 1;
+	b.resize(n);
+	b.x[0] = b.y[0] = 0;
+	b.vx[0] = b.vy[0] = 0;
+	b.m[0] = p.center_mass;
+	for(int i=1;i<n;i++){
+		double r = std::sqrt(p.r_in * p.r_in + u(rng) * (p.r_out * p.r_out - p.r_in * p.r_in));
+		double a = 2.0 * M_PI * u(rng);
+		b.x[i] = r * std::cos(a);
+		b.y[i] = r * std::sin(a);
+		b.m[i] = p.mass * (0.5 + u(rng));
+		double v = std::sqrt(G * p.center_mass / r);
+		b.vx[i] = -v * std::sin(a);
+		b.vy[i] = v * std::cos(a);
+	}
+}
+
+/* the sun, the eight planets and the moon, every planet at perihelion on
+ * the -x axis moving in +y, the moon at perigee beyond the earth. the sun
+ * gets the opposite momentum so the system's center of mass stays put.
+ * the same numbers the window starts from */
+inline void generate_solar_system(body_arrays& b, double G = 6.674e-11){
+	struct orbit{ double mass, axis, e; };
+	const double sun = 1.9885e30;
+	const orbit planets[8] = {
+		{3.30e23, 57910000000.0, 0.2056},   /* mercury */
+		{4.867e24, 108200000000.0, 0.0068}, /* venus */
+		{5.972e24, 149600000000.0, 0.0167}, /* earth */
+		{6.42e23, 227900000000.0, 0.0934},  /* mars */
+		{1.896e27, 778600000000.0, 0.0489}, /* jupiter */
+		{5.683e26, 1433500000000.0, 0.0565},/* saturn */
+		{8.681e25, 2872500000000.0, 0.0457},/* uranus */
+		{1.024e26, 4495100000000.0, 0.0113} /* neptune */
+	};
+	const orbit moon = {7.348e22, 384400000.0, 0.0549};
+	b.resize(10);
+	b.x[0] = b.y[0] = 0;
+	b.vx[0] = b.vy[0] = 0;
+	b.m[0] = sun;
+	for(int k=0;k<8;k++){
+		double perihelion = planets[k].axis * (1 - planets[k].e);
+		b.x[k + 1] = -perihelion;
+		b.y[k + 1] = 0;
+		b.vx[k + 1] = 0;
+		b.vy[k + 1] = std::sqrt(G * sun * (2 / perihelion - 1 / planets[k].axis));
+		b.m[k + 1] = planets[k].mass;
+	}
+	double perigee = moon.axis * (1 - moon.e);
+	double vmoon = std::sqrt(G * b.m[3] * (2 / perigee - 1 / moon.axis));
+	b.x[9] = b.x[3] - perigee;
+	b.y[9] = 0;
+	b.vx[9] = 0;
+	b.vy[9] = b.vy[3] + vmoon;
+	b.m[9] = moon.mass;
+	b.vy[3] -= vmoon * moon.mass / b.m[3];
+	for(int i=1;i<10;i++) b.vy[0] -= b.vy[i] * b.m[i] / sun;
+}
+
+/* count test particles on circular orbits around body host of b, radii
+ * uniform in area between r_in and r_out, added to the ones in p. a belt
+ * is a ring around the sun */
+inline void generate_ring(test_particles& p, const body_arrays& b, int host, int count, double r_in, double r_out, unsigned seed, double G = 6.674e-11){
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> u(0.0, 1.0);
+	int first = p.size();
+	p.resize(first + count);
+	for(int i=first;i<first+count;i++){
+		double r = std::sqrt(r_in * r_in + u(rng) * (r_out * r_out - r_in * r_in));
+		double a = 2.0 * M_PI * u(rng);
+		double v = std::sqrt(G * b.m[host] / r);
+		p.x[i] = b.x[host] + r * std::cos(a);
+		p.y[i] = b.y[host] + r * std::sin(a);
+		p.vx[i] = b.vx[host] - v * std::sin(a);
+		p.vy[i] = b.vy[host] + v * std::cos(a);
+	}
+}
+
+#endif
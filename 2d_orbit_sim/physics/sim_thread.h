@@ -0,0 +1,291 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include "bodies.h"
+#include "gravity.h"
+#include "integrator.h"
+#include "test_particles.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* a value handed from one writer thread to one reader thread without
+ * locks or waiting. the writer fills the back slot and swaps it with the
+ * middle one, the reader swaps the middle one with its front slot when
+ * there is something new in it. neither ever touches the slot the other
+ * is working on, and the reader always has the newest whole value */
+template<class T>
+struct triple_buffer{
+	T& back(){
+		return slots[back_slot];
+	}
+
+	void publish(){
+		back_slot = middle.exchange(back_slot | fresh) & 3;
+	}
+
+	/* true when front() changed */
+	bool update(){
+		if(!(middle.load() & fresh)) return false;
+		front_slot = middle.exchange(front_slot) & 3;
+		return true;
+	}
+
+	const T& front() const{
+		return slots[front_slot];
+	}
+
+	/* the same value in every slot, before the threads start */
+	void fill(const T& value){
+		for(T& s : slots) s = value;
+	}
+
+private:
+	static const int fresh = 4;
+	T slots[3];
+	int back_slot = 0;
+	std::atomic<int> middle{1};
+	int front_slot = 2;
+};
+
+/* what the renderer gets: where everything is after the last step, and
+ * where the massive bodies were at the steps since the last snapshot the
+ * renderer took, so the trails follow every step and not a chord per
+ * frame. sample k of body i is path_x[k * bodies + i], taken after step
+ * path_step[k]; the last sample is the current position. a snapshot the
+ * renderer skipped is covered by the next one, which can repeat samples
+ * the renderer already has */
+struct sim_snapshot{
+	std::vector<double> x, y;   /* massive bodies */
+	std::vector<double> px, py; /* test particles */
+	std::vector<double> path_x, path_y;
+	std::vector<long long> path_step;
+	double time = 0;            /* simulated seconds */
+	long long steps = 0;
+};
+
+/* positions kept for the path between two snapshots the renderer takes,
+ * over all bodies. past this every other sample is dropped and only every
+ * second step is kept from then on, and so on */
+const int path_budget = 1 << 16;
+
+/* what the renderer sets */
+struct sim_controls{
+	int gravity = GRAVITY_TREE;
+	double theta = 0.5;
+	int integrator = INTEGRATOR_LEAPFROG;
+	double dt = 3600;
+	double warp = 0;            /* simulated seconds per second, 0 runs flat out */
+};
+
+/* the integrator on a thread of its own, so simulated time is not tied
+ * to the frame rate. it steps until the simulated time has caught up with
+ * warp times the time since the warp was set, sleeping when it is ahead,
+ * and at most every few milliseconds publishes a snapshot through a
+ * triple buffer. a machine too slow for the warp runs as fast as it can
+ * without building up a debt. the bodies, particles, solver and
+ * integrator belong to the thread once start() is called */
+struct sim_thread{
+	body_arrays bodies;
+	test_particles particles;
+	gravity_solver gravity;
+	integrator integ;
+
+	explicit sim_thread(int threads = 0) : gravity(threads){}
+
+	~sim_thread(){
+		stop();
+	}
+
+	void start(){
+		if(worker.joinable()) return;
+		sim_snapshot first;
+		snapshot(first);
+		snapshots.fill(first);
+		running = true;
+		worker = std::thread([this]{ loop(); });
+	}
+
+	void stop(){
+		running = false;
+		if(worker.joinable()) worker.join();
+	}
+
+	void set_controls(const sim_controls& c){
+		std::lock_guard<std::mutex> lock(controls_mutex);
+		next_controls = c;
+	}
+
+	/* the newest snapshot, for the reader thread only */
+	const sim_snapshot& latest(){
+		if(snapshots.update()) taken = snapshots.front().steps;
+		return snapshots.front();
+	}
+
+	/* over the last second or so */
+	double steps_per_second() const{
+		return step_rate.load();
+	}
+
+	double days_per_second() const{
+		return time_rate.load() / 86400.0;
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	std::thread worker;
+	std::atomic<bool> running{false};
+	std::mutex controls_mutex;
+	sim_controls next_controls;
+	triple_buffer<sim_snapshot> snapshots;
+	std::atomic<double> step_rate{0}, time_rate{0};
+	std::atomic<long long> taken{0};  /* steps of the last snapshot the renderer took */
+
+	/* the path not yet known to be with the renderer */
+	std::vector<double> path_x, path_y;
+	std::vector<long long> path_step;
+	int stride = 1, since_sample = 0;
+
+	void snapshot(sim_snapshot& s) const{
+		s.x = bodies.x; s.y = bodies.y;
+		s.px = particles.x; s.py = particles.y;
+		s.path_x = path_x; s.path_y = path_y;
+		s.path_step = path_step;
+	}
+
+	void sample(long long steps){
+		path_x.insert(path_x.end(), bodies.x.begin(), bodies.x.end());
+		path_y.insert(path_y.end(), bodies.y.begin(), bodies.y.end());
+		path_step.push_back(steps);
+	}
+
+	/* samples the path may hold */
+	int path_limit() const{
+		return std::max(2, path_budget / std::max(bodies.size(), 1));
+	}
+
+	void record(long long steps){
+		if(++since_sample < stride) return;
+		since_sample = 0;
+		sample(steps);
+		int n = bodies.size();
+		if((int)path_step.size() < path_limit()) return;
+		/* keeps the odd samples, so the newest one stays */
+		int kept = 0;
+		for(int k=1;k<(int)path_step.size();k+=2){
+			std::copy(path_x.begin() + (size_t)k * n, path_x.begin() + (size_t)(k + 1) * n, path_x.begin() + (size_t)kept * n);
+			std::copy(path_y.begin() + (size_t)k * n, path_y.begin() + (size_t)(k + 1) * n, path_y.begin() + (size_t)kept * n);
+			path_step[kept++] = path_step[k];
+		}
+		path_x.resize((size_t)kept * n);
+		path_y.resize((size_t)kept * n);
+		path_step.resize(kept);
+		stride *= 2;
+	}
+
+	/* drops the samples the renderer has, they are in a snapshot it took,
+	 * and goes back to every step once the renderer keeps up again */
+	void forget_taken(){
+		long long t = taken.load();
+		int k = 0;
+		while(k < (int)path_step.size() && path_step[k] <= t) k++;
+		if(k == 0) return;
+		size_t n = bodies.size();
+		path_x.erase(path_x.begin(), path_x.begin() + k * n);
+		path_y.erase(path_y.begin(), path_y.begin() + k * n);
+		path_step.erase(path_step.begin(), path_step.begin() + k);
+		if((int)path_step.size() * 4 < path_limit()){
+			stride = 1;
+			since_sample = 0;
+		}
+	}
+
+	void loop(){
+		sim_controls c;
+		bool first = true;
+		double time = 0;
+		long long steps = 0, published_steps = 0;
+		clock::time_point anchor = clock::now(), published = anchor, window = anchor;
+		double anchor_time = 0;
+		long long window_steps = 0;
+		double window_time = 0;
+
+		while(running){
+			sim_controls want;
+			{
+				std::lock_guard<std::mutex> lock(controls_mutex);
+				want = next_controls;
+			}
+			/* the cached accelerations belong to the old force */
+			if(!first && (want.gravity != c.gravity || want.theta != c.theta)) integ.invalidate();
+			if(first || want.warp != c.warp){
+				anchor = clock::now();
+				anchor_time = time;
+			}
+			c = want;
+			first = false;
+			gravity.kind = c.gravity;
+			gravity.tree.theta = c.theta;
+			integ.kind = c.integrator;
+
+			clock::time_point now = clock::now();
+			double seconds = std::chrono::duration<double>(now - window).count();
+			if(seconds >= 1.0){
+				step_rate = (steps - window_steps) / seconds;
+				time_rate = (time - window_time) / seconds;
+				window = now;
+				window_steps = steps;
+				window_time = time;
+			}
+			if(c.warp > 0){
+				double target = anchor_time + c.warp * std::chrono::duration<double>(now - anchor).count();
+				if(time + c.dt > target){
+					if(steps != published_steps){
+						publish(time, steps);
+						published = now;
+						published_steps = steps;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				/* more than a second behind, the warp is too much for this
+				 * machine */
+				if(target - time > c.warp){
+					anchor = now;
+					anchor_time = time;
+				}
+			}
+
+			particles.begin_step(bodies, gravity.pool, gravity.G, c.dt);
+			integ.step(bodies, gravity, c.dt);
+			particles.end_step(bodies, gravity.pool, gravity.G, c.dt);
+			time += c.dt;
+			steps++;
+			record(steps);
+
+			now = clock::now();
+			if(now - published > std::chrono::milliseconds(4)){
+				publish(time, steps);
+				published = now;
+				published_steps = steps;
+			}
+		}
+	}
+
+	void publish(double time, long long steps){
+		forget_taken();
+		/* the path ends where the bodies are */
+		if(path_step.empty() || path_step.back() != steps) sample(steps);
+		sim_snapshot& s = snapshots.back();
+		snapshot(s);
+		s.time = time;
+		s.steps = steps;
+		snapshots.publish();
+	}
+};
+
+#endif
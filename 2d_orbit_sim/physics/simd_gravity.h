@@ -0,0 +1,339 @@
+#ifndef SIMD_GRAVITY_H
+#define SIMD_GRAVITY_H
+
+#include "bodies.h"
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMD_GRAVITY_X86 1
+#include <immintrin.h>
+#endif
+
+/* the direct sum with one target body per vector lane: 4 per instruction
+ * with avx2, 8 with avx-512. every source body is broadcast to all lanes,
+ * so there is no horizontal add and the lanes never talk to each other.
+ *
+ * 1/r^3 comes from an estimate of 1/sqrt(r2) refined by newton's
+ * iteration y' = y (1.5 - 0.5 r2 y^2), which doubles the correct bits
+ * each round. avx-512 has a 14 bit estimate and needs two rounds, avx2
+ * has none for doubles, so it starts from the bit trick on the exponent
+ * (about 5 bits) and takes four. both end within an ulp or two of the
+ * scalar sqrt and divide. pairs at zero distance (the body itself, or
+ * two on the same spot) are masked out instead of giving inf.
+ *
+ * the kernels are compiled for their instruction set with target
+ * attributes and picked at runtime, so the build needs no -march flag and
+ * the binary still runs on a cpu without them */
+enum simd_level{
+	SIMD_SCALAR,
+	SIMD_AVX2,
+	SIMD_AVX512,
+	SIMD_COUNT
+};
+
+inline const char* simd_level_name(int level){
+	static const char* names[SIMD_COUNT] = {"scalar", "avx2", "avx512"};
+	return level >= 0 && level < SIMD_COUNT ? names[level] : "?";
+}
+
+inline bool simd_supported(int level){
+	if(level == SIMD_SCALAR) return true;
+#ifdef SIMD_GRAVITY_X86
+	if(level == SIMD_AVX2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	if(level == SIMD_AVX512) return __builtin_cpu_supports("avx512f");
+#endif
+	return false;
+}
+
+inline int simd_best(){
+	static const int best = simd_supported(SIMD_AVX512) ? SIMD_AVX512 : simd_supported(SIMD_AVX2) ? SIMD_AVX2 : SIMD_SCALAR;
+	return best;
+}
+
+/* the kernels add the acceleration of the sources [from, to) of x, y and
+ * m to the targets [begin, end) of tx and ty, without G. the targets may
+ * be the sources themselves */
+inline void gravity_block_scalar(const double* tx, const double* ty, int begin, int end, const double* x, const double* y, const double* m, int from, int to, double* ax, double* ay, double eps2){
+	for(int i=begin;i<end;i++){
+		double px = tx[i], py = ty[i];
+		double sx = 0, sy = 0;
+		for(int j=from;j<to;j++){
+			double dx = x[j] - px, dy = y[j] - py;
+			double r2 = dx*dx + dy*dy + eps2;
+			if(r2 <= 0) continue;
+			double inv = m[j] / (r2 * std::sqrt(r2));
+			sx += dx * inv; sy += dy * inv;
+		}
+		ax[i] += sx;
+		ay[i] += sy;
+	}
+}
+
+/* the pairs of body i with bodies [begin, end), all after i, each pair
+ * once. adds m_j d / r^3 to acc[i] and takes m_i d / r^3 off acc[j],
+ * without G */
+inline void pair_row_scalar(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2){
+	double px = b.x[i], py = b.y[i], mi = b.m[i];
+	double ax = 0, ay = 0;
+	for(int j=begin;j<end;j++){
+		double dx = b.x[j] - px, dy = b.y[j] - py;
+		double r2 = dx*dx + dy*dy + eps2;
+		if(r2 <= 0) continue;
+		double inv = 1.0 / (r2 * std::sqrt(r2));
+		ax += dx * inv * b.m[j]; ay += dy * inv * b.m[j];
+		accx[j] -= dx * inv * mi; accy[j] -= dy * inv * mi;
+	}
+	accx[i] += ax;
+	accy[i] += ay;
+}
+
+#ifdef SIMD_GRAVITY_X86
+
+/* 1/sqrt(r2) to about full double precision */
+__attribute__((target("avx2,fma")))
+inline __m256d rsqrt_avx2(__m256d r2){
+	const __m256d h = _mm256_mul_pd(_mm256_set1_pd(0.5), r2), three_halves = _mm256_set1_pd(1.5);
+	__m256i guess = _mm256_sub_epi64(_mm256_set1_epi64x(0x5fe6eb50c7b537a9ll), _mm256_srli_epi64(_mm256_castpd_si256(r2), 1));
+	__m256d rs = _mm256_castsi256_pd(guess);
+	#pragma GCC unroll 4
+	for(int k=0;k<4;k++) rs = _mm256_mul_pd(rs, _mm256_fnmadd_pd(_mm256_mul_pd(h, rs), rs, three_halves));
+	return rs;
+}
+
+__attribute__((target("avx512f")))
+inline __m512d rsqrt_avx512(__m512d r2){
+	const __m512d h = _mm512_mul_pd(_mm512_set1_pd(0.5), r2), three_halves = _mm512_set1_pd(1.5);
+	__m512d rs = _mm512_maskz_rsqrt14_pd(0xff, r2);
+	rs = _mm512_mul_pd(rs, _mm512_fnmadd_pd(_mm512_mul_pd(h, rs), rs, three_halves));
+	rs = _mm512_mul_pd(rs, _mm512_fnmadd_pd(_mm512_mul_pd(h, rs), rs, three_halves));
+	return rs;
+}
+
+__attribute__((target("avx2,fma")))
+inline void gravity_block_avx2(const double* tx, const double* ty, int begin, int end, const double* x, const double* y, const double* m, int from, int to, double* ax, double* ay, double eps2){
+	const __m256d zero = _mm256_setzero_pd(), e2 = _mm256_set1_pd(eps2);
+	for(int i=begin;i<end;i+=4){
+		__m256i keep = _mm256_cmpgt_epi64(_mm256_set1_epi64x(end - i), _mm256_setr_epi64x(0, 1, 2, 3));
+		__m256d px = _mm256_maskload_pd(tx + i, keep), py = _mm256_maskload_pd(ty + i, keep);
+		__m256d sx = zero, sy = zero;
+		for(int j=from;j<to;j++){
+			__m256d dx = _mm256_sub_pd(_mm256_broadcast_sd(x + j), px);
+			__m256d dy = _mm256_sub_pd(_mm256_broadcast_sd(y + j), py);
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, e2));
+			__m256d rs = rsqrt_avx2(r2);
+			__m256d inv = _mm256_mul_pd(_mm256_mul_pd(rs, rs), _mm256_mul_pd(rs, _mm256_broadcast_sd(m + j)));
+			inv = _mm256_and_pd(inv, _mm256_cmp_pd(r2, zero, _CMP_GT_OQ));
+			sx = _mm256_fmadd_pd(dx, inv, sx);
+			sy = _mm256_fmadd_pd(dy, inv, sy);
+		}
+		_mm256_maskstore_pd(ax + i, keep, _mm256_add_pd(_mm256_maskload_pd(ax + i, keep), sx));
+		_mm256_maskstore_pd(ay + i, keep, _mm256_add_pd(_mm256_maskload_pd(ay + i, keep), sy));
+	}
+}
+
+__attribute__((target("avx512f")))
+inline void gravity_block_avx512(const double* tx, const double* ty, int begin, int end, const double* x, const double* y, const double* m, int from, int to, double* ax, double* ay, double eps2){
+	const __m512d zero = _mm512_setzero_pd(), e2 = _mm512_set1_pd(eps2);
+	for(int i=begin;i<end;i+=8){
+		__mmask8 keep = (__mmask8)((1u << std::min(8, end - i)) - 1);
+		__m512d px = _mm512_maskz_loadu_pd(keep, tx + i), py = _mm512_maskz_loadu_pd(keep, ty + i);
+		__m512d sx = zero, sy = zero;
+		for(int j=from;j<to;j++){
+			__m512d dx = _mm512_sub_pd(_mm512_set1_pd(x[j]), px);
+			__m512d dy = _mm512_sub_pd(_mm512_set1_pd(y[j]), py);
+			__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, e2));
+			__m512d rs = rsqrt_avx512(r2);
+			__mmask8 live = _mm512_cmp_pd_mask(r2, zero, _CMP_GT_OQ);
+			__m512d inv = _mm512_maskz_mul_pd(live, _mm512_mul_pd(rs, rs), _mm512_mul_pd(rs, _mm512_set1_pd(m[j])));
+			sx = _mm512_fmadd_pd(dx, inv, sx);
+			sy = _mm512_fmadd_pd(dy, inv, sy);
+		}
+		_mm512_mask_storeu_pd(ax + i, keep, _mm512_add_pd(_mm512_maskz_loadu_pd(keep, ax + i), sx));
+		_mm512_mask_storeu_pd(ay + i, keep, _mm512_add_pd(_mm512_maskz_loadu_pd(keep, ay + i), sy));
+	}
+}
+
+/* the row vectorized along j: the bodies after i are contiguous, so the
+ * updates of their accumulators are plain loads and stores */
+__attribute__((target("avx2,fma")))
+inline void pair_row_avx2(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2){
+	const double* x = b.x.data(); const double* y = b.y.data(); const double* m = b.m.data();
+	const __m256d zero = _mm256_setzero_pd(), e2 = _mm256_set1_pd(eps2);
+	const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+	__m256d px = _mm256_set1_pd(x[i]), py = _mm256_set1_pd(y[i]), mi = _mm256_set1_pd(m[i]);
+	__m256d ax = zero, ay = zero;
+	for(int j=begin;j<end;j+=4){
+		__m256i keep = _mm256_cmpgt_epi64(_mm256_set1_epi64x(end - j), lanes);
+		__m256d dx = _mm256_sub_pd(_mm256_maskload_pd(x + j, keep), px);
+		__m256d dy = _mm256_sub_pd(_mm256_maskload_pd(y + j, keep), py);
+		__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, e2));
+		__m256d rs = rsqrt_avx2(r2);
+		__m256d inv = _mm256_mul_pd(_mm256_mul_pd(rs, rs), rs);
+		inv = _mm256_and_pd(inv, _mm256_and_pd(_mm256_castsi256_pd(keep), _mm256_cmp_pd(r2, zero, _CMP_GT_OQ)));
+		__m256d pull = _mm256_mul_pd(inv, _mm256_maskload_pd(m + j, keep));
+		__m256d push = _mm256_mul_pd(inv, mi);
+		ax = _mm256_fmadd_pd(dx, pull, ax);
+		ay = _mm256_fmadd_pd(dy, pull, ay);
+		_mm256_maskstore_pd(accx + j, keep, _mm256_fnmadd_pd(dx, push, _mm256_maskload_pd(accx + j, keep)));
+		_mm256_maskstore_pd(accy + j, keep, _mm256_fnmadd_pd(dy, push, _mm256_maskload_pd(accy + j, keep)));
+	}
+	double sx[4], sy[4];
+	_mm256_storeu_pd(sx, ax);
+	_mm256_storeu_pd(sy, ay);
+	accx[i] += (sx[0] + sx[1]) + (sx[2] + sx[3]);
+	accy[i] += (sy[0] + sy[1]) + (sy[2] + sy[3]);
+}
+
+__attribute__((target("avx512f")))
+inline void pair_row_avx512(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2){
+	const double* x = b.x.data(); const double* y = b.y.data(); const double* m = b.m.data();
+	const __m512d zero = _mm512_setzero_pd(), e2 = _mm512_set1_pd(eps2);
+	__m512d px = _mm512_set1_pd(x[i]), py = _mm512_set1_pd(y[i]), mi = _mm512_set1_pd(m[i]);
+	__m512d ax = zero, ay = zero;
+	for(int j=begin;j<end;j+=8){
+		__mmask8 keep = (__mmask8)((1u << std::min(8, end - j)) - 1);
+		__m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(keep, x + j), px);
+		__m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(keep, y + j), py);
+		__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, e2));
+		__m512d rs = rsqrt_avx512(r2);
+		__mmask8 live = _mm512_mask_cmp_pd_mask(keep, r2, zero, _CMP_GT_OQ);
+		__m512d inv = _mm512_maskz_mul_pd(live, _mm512_mul_pd(rs, rs), rs);
+		__m512d pull = _mm512_mul_pd(inv, _mm512_maskz_loadu_pd(keep, m + j));
+		__m512d push = _mm512_mul_pd(inv, mi);
+		ax = _mm512_fmadd_pd(dx, pull, ax);
+		ay = _mm512_fmadd_pd(dy, pull, ay);
+		_mm512_mask_storeu_pd(accx + j, keep, _mm512_fnmadd_pd(dx, push, _mm512_maskz_loadu_pd(keep, accx + j)));
+		_mm512_mask_storeu_pd(accy + j, keep, _mm512_fnmadd_pd(dy, push, _mm512_maskz_loadu_pd(keep, accy + j)));
+	}
+	double sx[8], sy[8];
+	_mm512_storeu_pd(sx, ax);
+	_mm512_storeu_pd(sy, ay);
+	accx[i] += ((sx[0] + sx[1]) + (sx[2] + sx[3])) + ((sx[4] + sx[5]) + (sx[6] + sx[7]));
+	accy[i] += ((sy[0] + sy[1]) + (sy[2] + sy[3])) + ((sy[4] + sy[5]) + (sy[6] + sy[7]));
+}
+
+/* four rows i..i+3 at once over columns all after them: the columns and
+ * their accumulators are loaded and stored once for four rows */
+__attribute__((target("avx2,fma")))
+inline void pair_rows4_avx2(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2){
+	const double* x = b.x.data(); const double* y = b.y.data(); const double* m = b.m.data();
+	const __m256d zero = _mm256_setzero_pd(), e2 = _mm256_set1_pd(eps2);
+	const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+	__m256d px[4], py[4], mi[4], ax[4], ay[4];
+	for(int r=0;r<4;r++){
+		px[r] = _mm256_set1_pd(x[i + r]); py[r] = _mm256_set1_pd(y[i + r]); mi[r] = _mm256_set1_pd(m[i + r]);
+		ax[r] = ay[r] = zero;
+	}
+	for(int j=begin;j<end;j+=4){
+		__m256i keep = _mm256_cmpgt_epi64(_mm256_set1_epi64x(end - j), lanes);
+		__m256d xj = _mm256_maskload_pd(x + j, keep), yj = _mm256_maskload_pd(y + j, keep), mj = _mm256_maskload_pd(m + j, keep);
+		__m256d fx = zero, fy = zero;
+		#pragma GCC unroll 4
+		for(int r=0;r<4;r++){
+			__m256d dx = _mm256_sub_pd(xj, px[r]), dy = _mm256_sub_pd(yj, py[r]);
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, e2));
+			__m256d rs = rsqrt_avx2(r2);
+			__m256d inv = _mm256_mul_pd(_mm256_mul_pd(rs, rs), rs);
+			inv = _mm256_and_pd(inv, _mm256_and_pd(_mm256_castsi256_pd(keep), _mm256_cmp_pd(r2, zero, _CMP_GT_OQ)));
+			__m256d pull = _mm256_mul_pd(inv, mj), push = _mm256_mul_pd(inv, mi[r]);
+			ax[r] = _mm256_fmadd_pd(dx, pull, ax[r]);
+			ay[r] = _mm256_fmadd_pd(dy, pull, ay[r]);
+			fx = _mm256_fmadd_pd(dx, push, fx);
+			fy = _mm256_fmadd_pd(dy, push, fy);
+		}
+		_mm256_maskstore_pd(accx + j, keep, _mm256_sub_pd(_mm256_maskload_pd(accx + j, keep), fx));
+		_mm256_maskstore_pd(accy + j, keep, _mm256_sub_pd(_mm256_maskload_pd(accy + j, keep), fy));
+	}
+	for(int r=0;r<4;r++){
+		double sx[4], sy[4];
+		_mm256_storeu_pd(sx, ax[r]);
+		_mm256_storeu_pd(sy, ay[r]);
+		accx[i + r] += (sx[0] + sx[1]) + (sx[2] + sx[3]);
+		accy[i + r] += (sy[0] + sy[1]) + (sy[2] + sy[3]);
+	}
+}
+
+__attribute__((target("avx512f")))
+inline void pair_rows4_avx512(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2){
+	const double* x = b.x.data(); const double* y = b.y.data(); const double* m = b.m.data();
+	const __m512d zero = _mm512_setzero_pd(), e2 = _mm512_set1_pd(eps2);
+	__m512d px[4], py[4], mi[4], ax[4], ay[4];
+	for(int r=0;r<4;r++){
+		px[r] = _mm512_set1_pd(x[i + r]); py[r] = _mm512_set1_pd(y[i + r]); mi[r] = _mm512_set1_pd(m[i + r]);
+		ax[r] = ay[r] = zero;
+	}
+	for(int j=begin;j<end;j+=8){
+		__mmask8 keep = (__mmask8)((1u << std::min(8, end - j)) - 1);
+		__m512d xj = _mm512_maskz_loadu_pd(keep, x + j), yj = _mm512_maskz_loadu_pd(keep, y + j), mj = _mm512_maskz_loadu_pd(keep, m + j);
+		__m512d fx = zero, fy = zero;
+		#pragma GCC unroll 4
+		for(int r=0;r<4;r++){
+			__m512d dx = _mm512_sub_pd(xj, px[r]), dy = _mm512_sub_pd(yj, py[r]);
+			__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, e2));
+			__m512d rs = rsqrt_avx512(r2);
+			__mmask8 live = _mm512_mask_cmp_pd_mask(keep, r2, zero, _CMP_GT_OQ);
+			__m512d inv = _mm512_maskz_mul_pd(live, _mm512_mul_pd(rs, rs), rs);
+			__m512d pull = _mm512_mul_pd(inv, mj), push = _mm512_mul_pd(inv, mi[r]);
+			ax[r] = _mm512_fmadd_pd(dx, pull, ax[r]);
+			ay[r] = _mm512_fmadd_pd(dy, pull, ay[r]);
+			fx = _mm512_fmadd_pd(dx, push, fx);
+			fy = _mm512_fmadd_pd(dy, push, fy);
+		}
+		_mm512_mask_storeu_pd(accx + j, keep, _mm512_sub_pd(_mm512_maskz_loadu_pd(keep, accx + j), fx));
+		_mm512_mask_storeu_pd(accy + j, keep, _mm512_sub_pd(_mm512_maskz_loadu_pd(keep, accy + j), fy));
+	}
+	for(int r=0;r<4;r++){
+		double sx[8], sy[8];
+		_mm512_storeu_pd(sx, ax[r]);
+		_mm512_storeu_pd(sy, ay[r]);
+		accx[i + r] += ((sx[0] + sx[1]) + (sx[2] + sx[3])) + ((sx[4] + sx[5]) + (sx[6] + sx[7]));
+		accy[i + r] += ((sy[0] + sy[1]) + (sy[2] + sy[3])) + ((sy[4] + sy[5]) + (sy[6] + sy[7]));
+	}
+}
+
+#endif
+
+/* one block with the given kernel, scalar where it is missing */
+inline void gravity_block(const double* tx, const double* ty, int begin, int end, const double* x, const double* y, const double* m, int from, int to, double* ax, double* ay, double eps2, int level){
+#ifdef SIMD_GRAVITY_X86
+	if(level == SIMD_AVX512) return gravity_block_avx512(tx, ty, begin, end, x, y, m, from, to, ax, ay, eps2);
+	if(level == SIMD_AVX2) return gravity_block_avx2(tx, ty, begin, end, x, y, m, from, to, ax, ay, eps2);
+#endif
+	(void)level;
+	gravity_block_scalar(tx, ty, begin, end, x, y, m, from, to, ax, ay, eps2);
+}
+
+/* b.ax and b.ay of bodies [begin, end) from every body */
+inline void direct_gravity_range(body_arrays& b, int begin, int end, double G, double eps2, int level){
+	std::fill(b.ax.begin() + begin, b.ax.begin() + end, 0.0);
+	std::fill(b.ay.begin() + begin, b.ay.begin() + end, 0.0);
+	gravity_block(b.x.data(), b.y.data(), begin, end, b.x.data(), b.y.data(), b.m.data(), 0, b.size(), b.ax.data(), b.ay.data(), eps2, level);
+	for(int i=begin;i<end;i++){
+		b.ax[i] *= G;
+		b.ay[i] *= G;
+	}
+}
+
+inline void pair_row(const body_arrays& b, int i, int begin, int end, double* accx, double* accy, double eps2, int level){
+#ifdef SIMD_GRAVITY_X86
+	if(level == SIMD_AVX512) return pair_row_avx512(b, i, begin, end, accx, accy, eps2);
+	if(level == SIMD_AVX2) return pair_row_avx2(b, i, begin, end, accx, accy, eps2);
+#endif
+	(void)level;
+	pair_row_scalar(b, i, begin, end, accx, accy, eps2);
+}
+
+/* rows [first, last) over columns [begin, end), all after the rows */
+inline void pair_rows(const body_arrays& b, int first, int last, int begin, int end, double* accx, double* accy, double eps2, int level){
+	int i = first;
+#ifdef SIMD_GRAVITY_X86
+	for(;level != SIMD_SCALAR && i + 4 <= last;i+=4){
+		if(level == SIMD_AVX512) pair_rows4_avx512(b, i, begin, end, accx, accy, eps2);
+		else pair_rows4_avx2(b, i, begin, end, accx, accy, eps2);
+	}
+#endif
+	for(;i<last;i++) pair_row(b, i, begin, end, accx, accy, eps2, level);
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef SYSTEM_FILE_H
+#define SYSTEM_FILE_H
+
+#include "bodies.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#ifdef _WIN32
+/* without the min and max macros, which break std::min and std::max */
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* a system of bodies from a file: state vectors and what they look like.
+ * radius in kilometers, color from 0 to 1. names only come from csv and
+ * are empty for a binary file */
+struct system_data{
+	body_arrays bodies;
+	std::vector<float> radius;
+	std::vector<float> color;       /* r, g, b per body */
+	std::vector<std::string> names;
+
+	int size() const{
+		return bodies.size();
+	}
+
+	void resize(int n){
+		bodies.resize(n);
+		radius.resize(n);
+		color.resize(3 * n);
+		names.resize(n);
+	}
+};
+
+/* csv, a body per line:
+ *   name,x,y,vx,vy,mass,radius,r,g,b
+ * meters, meters per second, kilograms, kilometers. empty lines and lines
+ * starting with # are skipped */
+inline bool load_system_csv(const char* path, system_data& s, std::string& error){
+	std::ifstream in(path);
+	if(!in){
+		error = std::string("cannot open ") + path;
+		return false;
+	}
+	s.resize(0);
+	std::string line;
+	int number = 0;
+	while(std::getline(in, line)){
+		number++;
+		if(line.empty() || line[0] == '#' || line[0] == '\r') continue;
+		size_t comma = line.find(',');
+		if(comma == std::string::npos){
+			error = std::string(path) + ":" + std::to_string(number) + ": expected 10 fields";
+			return false;
+		}
+		double v[9];
+		const char* p = line.c_str() + comma;
+		for(int k=0;k<9;k++){
+			char* end;
+			if(*p != ',' || (v[k] = std::strtod(p + 1, &end), end == p + 1)){
+				error = std::string(path) + ":" + std::to_string(number) + ": expected 10 fields";
+				return false;
+			}
+			p = end;
+		}
+		int i = s.size();
+		s.resize(i + 1);
+		s.names[i] = line.substr(0, comma);
+		s.bodies.x[i] = v[0]; s.bodies.y[i] = v[1];
+		s.bodies.vx[i] = v[2]; s.bodies.vy[i] = v[3];
+		s.bodies.m[i] = v[4];
+		s.radius[i] = (float)v[5];
+		for(int c=0;c<3;c++) s.color[3*i + c] = (float)v[6 + c];
+	}
+	return true;
+}
+
+/* the binary form is the arrays one after the other, as they are in
+ * memory, behind a header with the count:
+ *   "ORBSYS1\0", count as uint64,
+ *   x, y, vx, vy, m as doubles, radius as floats, r g b as floats
+ * in the byte order of the machine that wrote it. loading maps the file
+ * and copies each array out whole, so a million bodies take as long as
+ * reading 56 MB */
+const char system_magic[8] = {'O', 'R', 'B', 'S', 'Y', 'S', '1', '\0'};
+
+inline size_t system_binary_size(uint64_t n){
+	return sizeof(system_magic) + sizeof(uint64_t) + n * (5 * sizeof(double) + 4 * sizeof(float));
+}
+
+inline bool save_system_binary(const char* path, const system_data& s, std::string& error){
+	FILE* f = std::fopen(path, "wb");
+	if(!f){
+		error = std::string("cannot write ") + path;
+		return false;
+	}
+	uint64_t n = s.size();
+	const std::vector<double>* arrays[5] = {&s.bodies.x, &s.bodies.y, &s.bodies.vx, &s.bodies.vy, &s.bodies.m};
+	bool ok = std::fwrite(system_magic, sizeof(system_magic), 1, f) == 1
+		&& std::fwrite(&n, sizeof(n), 1, f) == 1;
+	for(int k=0;k<5 && ok;k++) ok = std::fwrite(arrays[k]->data(), sizeof(double), n, f) == n;
+	ok = ok && std::fwrite(s.radius.data(), sizeof(float), n, f) == n;
+	ok = ok && std::fwrite(s.color.data(), sizeof(float), 3 * n, f) == 3 * n;
+	ok = std::fclose(f) == 0 && ok;
+	if(!ok) error = std::string("cannot write ") + path;
+	return ok;
+}
+
+/* a whole file mapped read only, with mmap or on windows a file mapping */
+struct mapped_file{
+	const char* data = nullptr;
+	size_t length = 0;
+
+	mapped_file() = default;
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	~mapped_file(){
+		close();
+	}
+
+#ifdef _WIN32
+	bool open(const char* path, std::string& error){
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if(file == INVALID_HANDLE_VALUE){
+			error = std::string("cannot open ") + path;
+			return false;
+		}
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size) || size.QuadPart == 0){
+			CloseHandle(file);
+			error = std::string(path) + ": not a system file";
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if(mapping == NULL){
+			error = std::string("cannot map ") + path;
+			return false;
+		}
+		/* the view keeps the mapping alive */
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if(view == NULL){
+			error = std::string("cannot map ") + path;
+			return false;
+		}
+		data = (const char*)view;
+		length = (size_t)size.QuadPart;
+		return true;
+	}
+
+	void close(){
+		if(data) UnmapViewOfFile(data);
+		data = nullptr;
+		length = 0;
+	}
+#else
+	bool open(const char* path, std::string& error){
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0){
+			error = std::string("cannot open ") + path;
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size == 0){
+			::close(fd);
+			error = std::string(path) + ": not a system file";
+			return false;
+		}
+		/* every page is read, so fault them all in with the map */
+		void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+		::close(fd);
+		if(map == MAP_FAILED){
+			error = std::string("cannot map ") + path;
+			return false;
+		}
+		data = (const char*)map;
+		length = st.st_size;
+		return true;
+	}
+
+	void close(){
+		if(data) munmap((void*)data, length);
+		data = nullptr;
+		length = 0;
+	}
+#endif
+};
+
+inline bool load_system_binary(const char* path, system_data& s, std::string& error){
+	mapped_file file;
+	if(!file.open(path, error)) return false;
+	const char* p = file.data;
+	uint64_t n;
+	if(file.length < system_binary_size(0)
+		|| std::memcmp(p, system_magic, sizeof(system_magic)) != 0
+		|| (std::memcpy(&n, p + sizeof(system_magic), sizeof(n)), n > (uint64_t)0x7fffffff)
+		|| system_binary_size(n) != file.length){
+		error = std::string(path) + ": not a system file";
+		return false;
+	}
+	p += system_binary_size(0);
+
+	s.names.clear();
+	std::vector<double>* arrays[5] = {&s.bodies.x, &s.bodies.y, &s.bodies.vx, &s.bodies.vy, &s.bodies.m};
+	for(int k=0;k<5;k++){
+		const double* a = (const double*)p;
+		arrays[k]->assign(a, a + n);
+		p += n * sizeof(double);
+	}
+	s.bodies.ax.assign(n, 0);
+	s.bodies.ay.assign(n, 0);
+	const float* r = (const float*)p;
+	s.radius.assign(r, r + n);
+	p += n * sizeof(float);
+	const float* c = (const float*)p;
+	s.color.assign(c, c + 3 * n);
+	return true;
+}
+
+/* binary if the file starts with the magic, csv otherwise */
+inline bool load_system(const char* path, system_data& s, std::string& error){
+	char head[sizeof(system_magic)] = {0};
+	FILE* f = std::fopen(path, "rb");
+	if(!f){
+		error = std::string("cannot open ") + path;
+		return false;
+	}
+	size_t got = std::fread(head, 1, sizeof(head), f);
+	std::fclose(f);
+	if(got == sizeof(head) && std::memcmp(head, system_magic, sizeof(head)) == 0) return load_system_binary(path, s, error);
+	return load_system_csv(path, s, error);
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef TEST_PARTICLES_H
+#define TEST_PARTICLES_H
+
+#include "bodies.h"
+#include "thread_pool.h"
+#include "simd_gravity.h"
+#include <vector>
+#include <algorithm>
+
+/* bodies without mass: asteroids, ring particles, dust. they feel every
+ * massive body and pull on nothing, so a step costs n * k for k massive
+ * bodies instead of a force pass over all of them, and they never go
+ * into the tree or the integrator of the massive bodies.
+ *
+ * a step is a leapfrog split around the step of the massive bodies:
+ * begin_step() kicks half a step with the accelerations of the massive
+ * bodies where they are now and drifts a whole step, the massive bodies
+ * take their step, end_step() computes the accelerations from where they
+ * are then and kicks the second half. the accelerations of the end are
+ * those of the next beginning, so it is one pass of the kernel per step.
+ * anything that moves the particles or the massive bodies from outside
+ * has to call invalidate() */
+struct test_particles{
+	std::vector<double> x, y, vx, vy, ax, ay;
+	double softening = 0;
+	int simd = simd_best();
+	bool have_accel = false;
+
+	int size() const{
+		return (int)x.size();
+	}
+
+	void resize(int n){
+		x.resize(n); y.resize(n);
+		vx.resize(n); vy.resize(n);
+		ax.resize(n); ay.resize(n);
+		have_accel = false;
+	}
+
+	void invalidate(){
+		have_accel = false;
+	}
+
+	void begin_step(const body_arrays& b, thread_pool& pool, double G, double dt){
+		if(!have_accel) accelerations(b, pool, G);
+		pool.parallel_for(size(), [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				vx[i] += 0.5 * dt * ax[i];
+				vy[i] += 0.5 * dt * ay[i];
+				x[i] += dt * vx[i];
+				y[i] += dt * vy[i];
+			}
+		}, 4096);
+	}
+
+	void end_step(const body_arrays& b, thread_pool& pool, double G, double dt){
+		pool.parallel_for(size(), [&](int begin, int end, int){
+			kernel(b, begin, end, G);
+			for(int i=begin;i<end;i++){
+				vx[i] += 0.5 * dt * ax[i];
+				vy[i] += 0.5 * dt * ay[i];
+			}
+		}, 4096);
+		have_accel = true;
+	}
+
+	void accelerations(const body_arrays& b, thread_pool& pool, double G){
+		pool.parallel_for(size(), [&](int begin, int end, int){
+			kernel(b, begin, end, G);
+		}, 4096);
+		have_accel = true;
+	}
+
+private:
+	/* particles [begin, end) against every massive body, a vector of
+	 * particles per massive body broadcast */
+	void kernel(const body_arrays& b, int begin, int end, double G){
+		std::fill(ax.begin() + begin, ax.begin() + end, 0.0);
+		std::fill(ay.begin() + begin, ay.begin() + end, 0.0);
+		gravity_block(x.data(), y.data(), begin, end, b.x.data(), b.y.data(), b.m.data(), 0, b.size(),
+			ax.data(), ay.data(), softening * softening, simd);
+		for(int i=begin;i<end;i++){
+			ax[i] *= G;
+			ay[i] *= G;
+		}
+	}
+};
+
+#endif
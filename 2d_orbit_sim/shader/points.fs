@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+uniform vec3 planetColor;
+
+/* round sprites: the corners of the point's square are cut away */
+void main(){
+	vec2 d = gl_PointCoord - vec2(0.5);
+	if(dot(d, d) > 0.25) discard;
+	FragColor = vec4(planetColor, 1.0);
+}
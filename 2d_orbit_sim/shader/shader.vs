@@ -1,10 +1,16 @@
 #version 330 core
 layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aCenter;
+layout (location = 2) in float aRadius;
+layout (location = 3) in vec3 aColor;
 out vec3 planetColor;
 
 uniform mat4 uProjection;
+uniform float uPointSize;
 
+/* a unit circle vertex, moved and scaled per planet */
 void main(){
-	gl_Position = uProjection * vec4(aPos, 0.0, 1.0);
-	planetColor = vec3(1.0, 1.0, 1.0);
+	gl_Position = uProjection * vec4(aCenter + aPos * aRadius, 0.0, 1.0);
+	gl_PointSize = uPointSize;
+	planetColor = aColor;
 }
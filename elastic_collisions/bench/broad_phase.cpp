@@ -0,0 +1,117 @@
+/* ms per step of every broad phase on a scene with mixed radii. all kinds
+ * must report the same set of pairs, which is checked every step. a second
+ * scene of fast balls with radii from 1 to 20 is checked against brute
+ * force the same way: there balls pass right over each other in one step,
+ * which the slow scene never does. a third scene retires balls and spawns
+ * new ones into the freed slots every step. the exit code is nonzero on a
+ * mismatch
+ *
+ * usage: broad_bench [balls] [steps] [radius spread] [seed]
+ * radius spread is the ratio between the biggest and the smallest ball */
+#include "../physics/world.h"
+#include "../physics/broad_phase.h"
+#include "../physics/scene.h"
+#include "../physics/emitter.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+/* runs every kind over the scene and prints a row each, false if any
+ * kind disagreed with the reference on any step. with churn the balls of
+ * the scene retire within 100 steps and an area emitter fills the window
+ * with short lived ones */
+bool run(const scene_params& params, int steps, bool churn = false){
+	world scene;
+	generate_scene(scene, params);
+	int n = params.balls;
+	emitter_system emitters(params.seed);
+	if(churn){
+		/* the pool is exactly full, so every new ball takes a retired slot */
+		emitters.expires.resize(n);
+		for(int i=0;i<n;i++) emitters.expires[i] = 1 + i % 97;
+		emitter e;
+		e.shape = EMIT_AREA;
+		e.x0 = 0; e.y0 = 0; e.x1 = scene.width; e.y1 = scene.height;
+		e.rate = 20.0f;
+		e.lifetime = 40;
+		e.speed = params.speed;
+		e.spread = M_PI;
+		e.radius_min = params.radius_min;
+		e.radius_max = params.radius_max;
+		emitters.emitters.push_back(e);
+	}
+
+	std::cout << "kind      ms/step  pairs/step  matches" << std::endl;
+	bool with_brute = n <= 20000;
+	std::vector<broad_phase> kinds(BROAD_COUNT);
+	for(int k=0;k<BROAD_COUNT;k++) kinds[k].kind = k;
+	std::vector<double> ms(BROAD_COUNT, 0);
+	std::vector<long long> found(BROAD_COUNT, 0);
+	std::vector<bool> same(BROAD_COUNT, true);
+	std::vector<contact> out, reference;
+	long long reinserted = 0;
+
+	world w = scene;
+	for(int s=0;s<steps;s++){
+		if(churn) emitters.update(w);
+		for(int i=0;i<w.size();i++) integrate(w, i, -1, 0, 0);
+		for(int k=0;k<BROAD_COUNT;k++){
+			if(k == BROAD_BRUTE && !with_brute) continue;
+			auto t0 = std::chrono::steady_clock::now();
+			kinds[k].pairs(w, out);
+			auto t1 = std::chrono::steady_clock::now();
+			ms[k] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+			found[k] += out.size();
+			if(k == BROAD_QUADTREE) reinserted += kinds[k].tree.reinserted;
+			std::sort(out.begin(), out.end(), [](const contact& l, const contact& r){
+				return l.a < r.a || (l.a == r.a && l.b < r.b);
+			});
+			if(k == (with_brute ? BROAD_BRUTE : BROAD_GRID)) reference = out;
+			else if(out.size() != reference.size() || !std::equal(out.begin(), out.end(), reference.begin(),
+					[](const contact& l, const contact& r){ return l.a == r.a && l.b == r.b; })){
+				same[k] = false;
+			}
+		}
+	}
+	for(int k=0;k<BROAD_COUNT;k++){
+		if(k == BROAD_BRUTE && !with_brute) continue;
+		std::cout << std::left << std::setw(8) << broad_phase_name(k) << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(9) << ms[k] / steps << "  " << std::setw(10) << found[k] / steps
+			<< "  " << (same[k] ? "yes" : "NO") << std::endl;
+	}
+	std::cout << "quadtree: " << kinds[BROAD_QUADTREE].tree.node_count() << " nodes, "
+		<< (double)reinserted / steps << " balls reinserted/step" << std::endl;
+	return std::find(same.begin(), same.end(), false) == same.end();
+}
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+	int steps = argc > 2 ? std::atoi(argv[2]) : 50;
+	float spread = argc > 3 ? (float)std::atof(argv[3]) : 1.0f;
+	unsigned seed = argc > 4 ? (unsigned)std::atoi(argv[4]) : 1234;
+
+	/* radii are log uniform between 2 and 2 * spread */
+	scene_params params;
+	params.balls = n;
+	params.seed = seed;
+	params.radius_min = 2.0f;
+	params.radius_max = 2.0f * spread;
+	params.density = 1.0f;
+	params.speed = 1.0f;
+	std::cout << n << " balls, radius spread " << spread << ", " << steps << " steps" << std::endl;
+	bool ok = run(params, steps);
+
+	scene_params fast = params;
+	fast.balls = 3000;
+	fast.radius_min = 1.0f;
+	fast.radius_max = 20.0f;
+	fast.speed = 30.0f;
+	std::cout << std::endl << "fast: " << fast.balls << " balls, radius 1 to 20, speed 30, 200 steps" << std::endl;
+	ok = run(fast, 200) && ok;
+	std::cout << std::endl << "churn: the fast scene, every ball retired within 100 steps, 20 spawned a step" << std::endl;
+	ok = run(fast, 200, true) && ok;
+	if(!ok) std::cout << "MISMATCH" << std::endl;
+	return ok ? 0 : 1;
+}
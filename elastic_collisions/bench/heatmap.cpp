@@ -0,0 +1,49 @@
+/* ms to splat the density view from 1 to 32 threads, for a few ball
+ * counts in a box of fixed pixel size. the histogram sum is checked
+ * against the number of live balls
+ *
+ * usage: heatmap_bench [width] [height] [repeats] [seed] */
+#include "../physics/world.h"
+#include "../physics/heatmap.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int width = argc > 1 ? std::atoi(argv[1]) : 1354;
+	int height = argc > 2 ? std::atoi(argv[2]) : 724;
+	int repeats = argc > 3 ? std::atoi(argv[3]) : 10;
+	unsigned seed = argc > 4 ? (unsigned)std::atoi(argv[4]) : 1234;
+
+	std::cout << width << "x" << height << " pixels, " << repeats << " repeats" << std::endl;
+	std::cout << "balls     threads  ms/frame  max count  sum ok" << std::endl;
+	for(int n : {10000, 100000, 1000000}){
+		/* small balls so even a million fit the box */
+		scene_params params;
+		params.balls = n;
+		params.seed = seed;
+		params.radius_min = params.radius_max = 0.3f;
+		params.width = (float)width;
+		params.height = (float)height;
+		world w;
+		generate_scene(w, params);
+		for(int threads : {1, 2, 4, 8, 16, 32}){
+			thread_pool pool(threads);
+			density_map map;
+			std::vector<float> texels;
+			float top = 0;
+			auto t0 = std::chrono::steady_clock::now();
+			for(int r=0;r<repeats;r++) top = map.splat(w, pool, width, height, texels);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / repeats;
+			double sum = 0;
+			for(size_t p=0;p<texels.size();p+=2) sum += texels[p];
+			std::cout << std::setw(8) << n << "  " << std::setw(7) << threads << "  "
+				<< std::setw(8) << std::fixed << std::setprecision(2) << ms << "  "
+				<< std::setw(9) << std::setprecision(0) << top << "  "
+				<< ((long long)sum == w.live ? "yes" : "NO") << std::endl;
+		}
+	}
+	return 0;
+}
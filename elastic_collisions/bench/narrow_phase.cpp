@@ -0,0 +1,74 @@
+/* ns per candidate pair of every narrow phase path this cpu supports.
+ * overlap is the squared distance test alone, resolve is the full impulse
+ * over the colored contacts. the resolved state is hashed so the paths can
+ * be checked against each other
+ *
+ * usage: narrow_bench [balls] [repeats] [seed] */
+#include "../physics/world.h"
+#include "../physics/grid.h"
+#include "../physics/solver.h"
+#include "../physics/narrow.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+	int repeats = argc > 2 ? std::atoi(argv[2]) : 20;
+	unsigned seed = argc > 3 ? (unsigned)std::atoi(argv[3]) : 1234;
+
+	scene_params params;
+	params.balls = n;
+	params.seed = seed;
+	params.fill = 0.45f;
+	params.density = 2.0f / 16.0f;
+	world scene;
+	generate_scene(scene, params);
+
+	uniform_grid grid;
+	std::vector<contact> candidates;
+	grid.build(scene);
+	grid.pairs(scene, candidates);
+	std::vector<contact> out(candidates.size());
+
+	std::cout << n << " balls, " << candidates.size() << " candidate pairs, " << repeats << " repeats" << std::endl;
+	std::cout << "path    overlap ns/pair  resolve ns/pair  touching  hash" << std::endl;
+
+	for(const narrow_kernels& k : narrow_available()){
+		int touching = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for(int r=0;r<repeats;r++){
+			touching = k.overlap(scene, candidates.data(), (int)candidates.size(), out.data());
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		double overlap_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)repeats * candidates.size());
+
+		/* resolve the candidates themselves (not only the touching ones) so
+		 * both columns are per broad phase pair */
+		contact_solver solver;
+		solver.kernels = k;
+		solver.pending = candidates;
+		solver.color(scene.size());
+		double resolve_ns = 0;
+		world w;
+		for(int r=0;r<repeats;r++){
+			w = scene;
+			auto s0 = std::chrono::steady_clock::now();
+			for(int c=0;c<solver.colors();c++){
+				int first = solver.color_start[c];
+				k.resolve(w, solver.contacts.data() + first, solver.color_start[c + 1] - first);
+			}
+			auto s1 = std::chrono::steady_clock::now();
+			resolve_ns += std::chrono::duration<double, std::nano>(s1 - s0).count();
+		}
+		resolve_ns /= (double)repeats * candidates.size();
+
+		unsigned long long h = hash_world(w);
+		std::cout << std::left << std::setw(8) << k.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(15) << overlap_ns << "  " << std::setw(15) << resolve_ns << "  "
+			<< std::setw(8) << touching << "  " << std::hex << h << std::dec << std::endl;
+	}
+	return 0;
+}
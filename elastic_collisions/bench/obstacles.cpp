@@ -0,0 +1,122 @@
+/* cost of the ball against obstacle query through the bvh, next to a loop
+ * over every segment. the segments are short random strokes spread over the
+ * scene and both ways must find the same overlapping ball-segment pairs.
+ *
+ * then balls fast enough to cross an edge in one step are thrown at a field
+ * of convex polygons, and no center may be inside one after any step
+ *
+ * usage: obstacle_bench [segments] [balls] [repeats] [seed] */
+#include "../physics/world.h"
+#include "../physics/obstacles.h"
+#include "../physics/scene.h"
+#include "../physics/thread_pool.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int nseg = argc > 1 ? std::atoi(argv[1]) : 5000;
+	int n = argc > 2 ? std::atoi(argv[2]) : 20000;
+	int repeats = argc > 3 ? std::atoi(argv[3]) : 10;
+	unsigned seed = argc > 4 ? (unsigned)std::atoi(argv[4]) : 1234;
+
+	scene_params params;
+	params.balls = n;
+	params.seed = seed;
+	world scene;
+	generate_scene(scene, params);
+
+	/* strokes a few ball diameters long */
+	obstacle_set o;
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> ux(0.0f, scene.width), uy(0.0f, scene.height), ua(0.0f, 2.0f * M_PI);
+	for(int s=0;s<nseg;s++){
+		float x = ux(rng), y = uy(rng), a = ua(rng), l = 40.0f;
+		o.add_segment(x, y, x + l * std::cos(a), y + l * std::sin(a));
+	}
+	auto b0 = std::chrono::steady_clock::now();
+	o.build();
+	double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - b0).count();
+
+	long long bvh_pairs = 0, all_pairs = 0, visited = 0;
+	for(int i=0;i<scene.size();i++){
+		float r = scene.radius[i], ex, ey;
+		o.near(scene.px[i], scene.py[i], r, [&](int s){
+			visited++;
+			if(o.distance2(s, scene.px[i], scene.py[i], ex, ey) < r*r) bvh_pairs++;
+		});
+	}
+	auto a0 = std::chrono::steady_clock::now();
+	for(int i=0;i<scene.size();i++){
+		float r = scene.radius[i], ex, ey;
+		for(int s=0;s<(int)o.segments.size();s++){
+			if(o.distance2(s, scene.px[i], scene.py[i], ex, ey) < r*r) all_pairs++;
+		}
+	}
+	double all_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - a0).count() / n;
+
+	/* one thread, so the time per ball is the cost of one query */
+	thread_pool pool(1);
+	double bvh_us = 0;
+	world w;
+	for(int r=0;r<repeats;r++){
+		w = scene;
+		auto t0 = std::chrono::steady_clock::now();
+		o.collide(w, pool);
+		bvh_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+	}
+	bvh_us /= (double)repeats * n;
+
+	std::cout << n << " balls, " << nseg << " segments, " << o.nodes.size() << " bvh nodes, built in "
+		<< std::fixed << std::setprecision(3) << build_ms << " ms" << std::endl;
+	std::cout << "bvh          " << bvh_us << " us/ball, " << (double)visited / n << " segments visited/ball" << std::endl;
+	std::cout << "every seg    " << all_us << " us/ball" << std::endl;
+	std::cout << "overlaps     " << bvh_pairs << " vs " << all_pairs << (bvh_pairs == all_pairs ? " match" : " MISMATCH") << std::endl;
+
+	/* regular polygons of 3 to 8 sides on a grid, balls moving up to twice
+	 * their radius per step, bouncing off the scene edges */
+	obstacle_set solids;
+	const float cell = 120.0f;
+	std::uniform_int_distribution<int> sides(3, 8);
+	for(float cy=cell;cy<scene.height-cell/2;cy+=cell){
+		for(float cx=cell;cx<scene.width-cell/2;cx+=cell){
+			int k = sides(rng);
+			float a0 = ua(rng), rad = 0.35f * cell;
+			std::vector<float> xy;
+			for(int j=0;j<k;j++){
+				xy.push_back(cx + rad * std::cos(a0 + 2.0f * M_PI * j / k));
+				xy.push_back(cy + rad * std::sin(a0 + 2.0f * M_PI * j / k));
+			}
+			solids.add_polygon(xy);
+		}
+	}
+	solids.build();
+	w = scene;
+	std::uniform_real_distribution<float> uv(-1.0f, 1.0f);
+	for(int i=0;i<w.size();i++){
+		float s = 2.0f * w.radius[i];
+		w.vx[i] = s * uv(rng);
+		w.vy[i] = s * uv(rng);
+	}
+	const int steps = 200;
+	long long inside = 0;
+	for(int step=0;step<steps;step++){
+		for(int i=0;i<w.size();i++){
+			w.px[i] += w.vx[i];
+			w.py[i] += w.vy[i];
+			if(w.px[i] < 0 || w.px[i] > w.width) w.vx[i] = -w.vx[i];
+			if(w.py[i] < 0 || w.py[i] > w.height) w.vy[i] = -w.vy[i];
+		}
+		solids.collide(w, pool);
+		for(int i=0;i<w.size();i++){
+			for(int p=0;p<solids.polygons();p++){
+				if(solids.inside(p, w.px[i], w.py[i])) inside++;
+			}
+		}
+	}
+	std::cout << "solids       " << solids.polygons() << " polygons, " << steps << " steps, "
+		<< inside << " centers inside" << (inside == 0 ? "" : " FAILED") << std::endl;
+	return bvh_pairs == all_pairs && inside == 0 ? 0 : 1;
+}
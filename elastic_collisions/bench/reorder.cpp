@@ -0,0 +1,85 @@
+/* ms per step of the collision pass (broad phase, contact build and solve)
+ * with the slots in the random order the scene is generated in, after
+ * sorting them once by morton key, and with the periodic reorder of the
+ * simulation. the scene has no gravity and no sleep, so every ball is
+ * integrated and collided every step. the contact counts should stay close,
+ * the order only changes how the solver's float sums round
+ *
+ * usage: reorder_bench [balls] [steps] [every] [threads] [seed] */
+#include "../physics/world.h"
+#include "../physics/simulation.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+
+struct reorder_run{
+	double ms = 0;
+	double sort_ms = 0;
+	long long contacts = 0;
+};
+
+reorder_run run(const world& scene, int threads, bool sort_first, int every, int steps){
+	simulation sim(threads);
+	sim.w = scene;
+	sim.w.sleep_enabled = false;
+	sim.reorder.every = every;
+	reorder_run r;
+	if(sort_first){
+		auto t0 = std::chrono::steady_clock::now();
+		sim.reorder.apply(sim.w, sim.pool);
+		r.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+	auto t0 = std::chrono::steady_clock::now();
+	for(int s=0;s<steps;s++){
+		sim.step(-1, 0, 0);
+		r.contacts += sim.stats.contacts;
+	}
+	r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / steps;
+	r.contacts /= steps;
+	/* a periodic sort starts from nearly sorted slots, time one of those */
+	if(every > 0){
+		auto t1 = std::chrono::steady_clock::now();
+		sim.reorder.apply(sim.w, sim.pool);
+		r.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count();
+	}
+	return r;
+}
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+	int every = argc > 3 ? std::atoi(argv[3]) : 5;
+	int threads = argc > 4 ? std::atoi(argv[4]) : 0;
+	unsigned seed = argc > 5 ? (unsigned)std::atoi(argv[5]) : 1234;
+
+	scene_params params;
+	params.balls = n;
+	params.seed = seed;
+	params.radius_min = 2.0f;
+	params.radius_max = 4.0f;
+	params.speed = 1.0f;
+	world scene;
+	generate_scene(scene, params);
+
+	simulation probe(threads);
+	std::cout << n << " balls, " << steps << " steps, " << probe.pool.size() << " threads" << std::endl;
+	std::cout << "order        ms/step  speedup  sort ms  contacts/step" << std::endl;
+	double base = 0;
+	auto report = [&](const char* name, bool sort_first, int e){
+		reorder_run r = run(scene, threads, sort_first, e, steps);
+		if(base == 0) base = r.ms;
+		std::cout << std::setw(11) << std::left << name << std::right << "  "
+			<< std::setw(7) << std::fixed << std::setprecision(2) << r.ms << "  "
+			<< std::setw(7) << base / r.ms << "  "
+			<< std::setw(7) << r.sort_ms << "  "
+			<< std::setw(13) << r.contacts << std::endl;
+	};
+	report("scattered", false, 0);
+	report("sorted", true, 0);
+	std::string periodic = "every " + std::to_string(every);
+	report(periodic.c_str(), false, every);
+	return 0;
+}
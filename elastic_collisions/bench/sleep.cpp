@@ -0,0 +1,78 @@
+/* a pile settling under gravity with the xpbd solver and no bounce, which
+ * has to fall asleep as a whole and stay asleep, then wake when a ball
+ * lands on it fast and fall asleep again. prints the steps it took and the
+ * cost of a step awake and asleep, and fails if the pile doesn't sleep
+ *
+ * usage: sleep_bench [balls] [max steps] [seed] */
+#include "../physics/world.h"
+#include "../physics/scene.h"
+#include "../physics/simulation.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+/* steps until nothing is awake, or -1 after max steps */
+int settle(simulation& sim, int max_steps, double& ms){
+	auto t0 = std::chrono::steady_clock::now();
+	int s = 0;
+	while(s < max_steps && sim.w.awake_count() > 0){
+		sim.step(0, 0, 0);
+		s++;
+	}
+	ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / std::max(s, 1);
+	return sim.w.awake_count() == 0 ? s : -1;
+}
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 300;
+	int max_steps = argc > 2 ? std::atoi(argv[2]) : 20000;
+	unsigned seed = argc > 3 ? (unsigned)std::atoi(argv[3]) : 1234;
+
+	scene_params params;
+	params.balls = n;
+	params.seed = seed;
+	simulation sim(1);
+	generate_scene(sim.w, params);
+	sim.w.sleep_enabled = true;
+	sim.solver_kind = SOLVER_XPBD;
+	sim.xpbd.restitution = 0.0f;
+
+	std::cout << n << " balls, xpbd without bounce, seed " << seed << std::endl;
+	bool ok = true;
+	double awake_ms;
+	int first = settle(sim, max_steps, awake_ms);
+	std::cout << "asleep after " << std::setw(6) << first << " steps, " << std::fixed << std::setprecision(4)
+		<< awake_ms << " ms/step" << std::endl;
+	ok = ok && first >= 0;
+
+	/* nothing may wake up on its own */
+	const int quiet = 2000;
+	int woke = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for(int s=0;s<quiet;s++){
+		sim.step(0, 0, 0);
+		woke = std::max(woke, sim.w.awake_count());
+	}
+	double asleep_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / quiet;
+	std::cout << "then " << quiet << " steps, at most " << woke << " awake, " << asleep_ms << " ms/step" << std::endl;
+	ok = ok && woke == 0;
+
+	/* a ball thrown down onto the middle of the pile */
+	float top = 0;
+	for(int i=0;i<sim.w.size();i++) top = std::max(top, sim.w.py[i] + sim.w.radius[i]);
+	int b = sim.w.add(0.5f * sim.w.width, std::min(top + 10.0f, sim.w.height - 4.0f), 4.0f, 2.0f);
+	sim.w.vy[b] = -5.0f;
+	int peak = 0;
+	for(int s=0;s<20;s++){
+		sim.step(0, 0, 0);
+		peak = std::max(peak, sim.w.awake_count());
+	}
+	double again_ms;
+	int again = settle(sim, max_steps, again_ms);
+	std::cout << "hit, " << peak << " awake, asleep again after " << again << " steps" << std::endl;
+	ok = ok && peak > 1 && again >= 0;
+
+	std::cout << (ok ? "ok" : "FAILED") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+/* scaling of the colored contact solver from 1 to 32 threads.
+ * every run starts from the same seeded scene, and the final state is hashed
+ * to check that the thread count does not change the result
+ *
+ * usage: solver_bench [balls] [steps] [seed] */
+#include "../physics/world.h"
+#include "../physics/grid.h"
+#include "../physics/solver.h"
+#include "../physics/thread_pool.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+	int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+	unsigned seed = argc > 3 ? (unsigned)std::atoi(argv[3]) : 1234;
+
+	/* about 45% of the box covered so every ball has a few neighbors */
+	scene_params scene;
+	scene.balls = n;
+	scene.seed = seed;
+	scene.fill = 0.45f;
+	scene.density = 2.0f / 16.0f;
+
+	std::cout << n << " balls, " << steps << " steps, seed " << seed
+		<< ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	std::cout << "threads  solve ms/step  speedup  colors  contacts  hash" << std::endl;
+
+	double base = 0;
+	for(int threads : {1, 2, 4, 8, 16, 32}){
+		world w;
+		generate_scene(w, scene);
+		thread_pool pool(threads);
+		uniform_grid grid;
+		contact_solver solver;
+		std::vector<contact> candidates;
+		double solve_ms = 0;
+		for(int s=0;s<steps;s++){
+			for(int i=0;i<w.size();i++) integrate(w, i, 0, 0, 0);
+			candidates.clear();
+			grid.build(w);
+			grid.pairs(w, candidates);
+			solver.build(w, candidates);
+			auto t0 = std::chrono::steady_clock::now();
+			solver.solve(w, pool);
+			auto t1 = std::chrono::steady_clock::now();
+			solve_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		}
+		solve_ms /= steps;
+		if(threads == 1) base = solve_ms;
+		std::cout << std::setw(7) << threads << "  "
+			<< std::setw(13) << std::fixed << std::setprecision(3) << solve_ms << "  "
+			<< std::setw(7) << std::setprecision(2) << base / solve_ms << "  "
+			<< std::setw(6) << solver.colors() << "  "
+			<< std::setw(8) << solver.contacts.size() << "  "
+			<< std::hex << hash_world(w) << std::dec << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,76 @@
+/* steps/sec of the sph fluid from 1 to 32 threads, and of every kernel path
+ * this cpu supports at the most threads. every run starts from the same
+ * seeded scene that has been falling for a few steps, and the final state
+ * is hashed to check that neither the thread count nor the path changes
+ * the result
+ *
+ * usage: sph_bench [particles] [steps] [warmup] [seed] */
+#include "../physics/world.h"
+#include "../physics/simulation.h"
+#include "../physics/scene.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+struct sph_run{
+	double ms = 0;
+	long long pairs = 0;
+	unsigned long long hash = 0;
+};
+
+sph_run run(const scene_params& scene, int threads, const sph_kernels& kernels, int warmup, int steps){
+	simulation sim(threads);
+	generate_scene(sim.w, scene);
+	sim.w.sleep_enabled = false;
+	sim.solver_kind = SOLVER_SPH;
+	sim.fluid.kernels = kernels;
+	for(int s=0;s<warmup;s++) sim.step(0, 0, 0);
+	sph_run r;
+	auto t0 = std::chrono::steady_clock::now();
+	for(int s=0;s<steps;s++){
+		sim.step(0, 0, 0);
+		r.pairs += sim.stats.contacts;
+	}
+	r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / steps;
+	r.pairs /= steps;
+	r.hash = hash_world(sim.w);
+	return r;
+}
+
+int main(int argc, char** argv){
+	int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+	int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+	int warmup = argc > 3 ? std::atoi(argv[3]) : 20;
+	unsigned seed = argc > 4 ? (unsigned)std::atoi(argv[4]) : 1234;
+
+	/* half of the box is fluid, so it is dense from the first step */
+	scene_params scene;
+	scene.balls = n;
+	scene.seed = seed;
+	scene.fill = 0.5f;
+	scene.speed = 0.0f;
+
+	std::cout << n << " particles, " << steps << " steps after " << warmup << " of warmup, seed " << seed
+		<< ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	std::cout << "threads  path    ms/step  steps/sec  speedup  pairs     hash" << std::endl;
+
+	sph_kernels best = sph_select();
+	double base = 0;
+	auto report = [&](int threads, const sph_kernels& k){
+		sph_run r = run(scene, threads, k, warmup, steps);
+		if(base == 0) base = r.ms;
+		std::cout << std::setw(7) << threads << "  " << std::setw(6) << std::left << k.name << std::right << "  "
+			<< std::setw(7) << std::fixed << std::setprecision(2) << r.ms << "  "
+			<< std::setw(9) << std::setprecision(1) << 1000.0 / r.ms << "  "
+			<< std::setw(7) << std::setprecision(2) << base / r.ms << "  "
+			<< std::setw(8) << r.pairs << "  "
+			<< std::hex << r.hash << std::dec << std::endl;
+	};
+	for(int threads : {1, 2, 4, 8, 16, 32}) report(threads, best);
+	for(const sph_kernels& k : sph_available()){
+		if(std::strcmp(k.name, best.name) != 0) report(32, k);
+	}
+	return 0;
+}
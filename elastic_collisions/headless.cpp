@@ -0,0 +1,274 @@
+/* elastic_collisions without a window: generates a scene, runs a fixed
+ * number of steps and reports throughput and how much the solver drifts.
+ * meant for comparing broad phases and solvers on machines without a display
+ *
+ * usage: headless [--balls N] [--steps N] [--rmin R] [--rmax R] [--uniform-radius]
+ *                 [--density D] [--mass-jitter J] [--speed S] [--fill F]
+ *                 [--size W] [--seed S] [--broad brute|grid|sap|quadtree]
+ *                 [--narrow avx2|sse|scalar] [--threads N] [--gravity 0|1]
+ *                 [--sleep] [--every N]
+ *                 [--emit point|line|area] [--emit-rate R] [--emit-life N] [--pool N]
+ *                 [--obstacles FILE]
+ *                 [--solver impulse|xpbd|sph] [--iterations N] [--restitution E] [--warm W] [--stack K]
+ *                 [--smoothing H] [--fluid-iterations N] [--viscosity C] [--sph avx2|scalar]
+ *                 [--reorder N]
+ *        headless --replay FILE [--threads N] [--narrow avx2|sse|scalar]
+ *
+ * --replay plays a recording made in the window (R) as fast as possible,
+ * checks every checkpoint hash and prints frame time statistics */
+#include "physics/world.h"
+#include "physics/scene.h"
+#include "physics/simulation.h"
+#include "physics/emitter.h"
+#include "physics/session.h"
+#include "physics/recorder.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+int replay(const char* path, int threads, const char* narrow){
+	session s(threads);
+	recording_reader rec;
+	if(!rec.open(path, s)){
+		std::cerr << "cannot read recording " << path << std::endl;
+		return 1;
+	}
+	s.sim.solver.kernels = narrow_select(narrow);
+	std::cout << "replaying " << path << ", seed " << rec.seed << ", balls " << s.sim.w.live
+		<< ", narrow " << s.sim.solver.kernels.name << ", threads " << s.sim.pool.size() << std::endl;
+
+	frame_time_stats times;
+	frame_input in;
+	long long checked = 0, first_bad = -1;
+	auto check = [&](){
+		if(!rec.has_hash) return;
+		checked++;
+		if(first_bad < 0 && rec.hash != hash_world(s.sim.w)) first_bad = rec.frames;
+	};
+	while(rec.next(in)){
+		auto t0 = std::chrono::steady_clock::now();
+		s.step(in);
+		auto t1 = std::chrono::steady_clock::now();
+		times.add(std::chrono::duration<double, std::milli>(t1 - t0).count());
+		check();
+	}
+	check();
+	if(!rec.ended) std::cout << "recording is truncated" << std::endl;
+
+	times.report(std::cout);
+	std::cout << "balls at the end " << s.sim.w.live << ", checkpoints " << checked;
+	if(first_bad < 0) std::cout << ", bit exact" << std::endl;
+	else std::cout << ", DIVERGED at step " << first_bad << std::endl;
+	return first_bad < 0 && rec.ended ? 0 : 2;
+}
+
+int main(int argc, char** argv){
+	scene_params scene;
+	const char* replay_path = nullptr;
+	int steps = 500;
+	int threads = 0;
+	int broad = BROAD_GRID;
+	const char* narrow = nullptr;
+	int gravity = 0;
+	bool sleep = false;
+	int every = 0;
+	int emit = -1;
+	float emit_rate = 2.0f;
+	int emit_life = 600;
+	int pool = 0;
+	const char* obstacles = nullptr;
+	int solver = SOLVER_IMPULSE;
+	xpbd_solver xpbd;
+	sph_fluid fluid;
+	const char* sph_path = nullptr;
+	int reorder = world_reorder().every;
+
+	for(int i=1;i<argc;i++){
+		const char* a = argv[i];
+		const char* v = i + 1 < argc ? argv[i + 1] : "";
+		if(!std::strcmp(a, "--balls")){ scene.balls = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--steps")){ steps = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--rmin")){ scene.radius_min = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--rmax")){ scene.radius_max = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--uniform-radius")){ scene.log_radius = false; }
+		else if(!std::strcmp(a, "--density")){ scene.density = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--mass-jitter")){ scene.mass_jitter = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--speed")){ scene.speed = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--fill")){ scene.fill = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--size")){ scene.width = scene.height = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--seed")){ scene.seed = (unsigned)std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--threads")){ threads = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--narrow")){ narrow = v; i++; }
+		else if(!std::strcmp(a, "--gravity")){ gravity = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--sleep")){ sleep = true; }
+		else if(!std::strcmp(a, "--every")){ every = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--emit")){
+			if(!std::strcmp(v, "point")) emit = EMIT_POINT;
+			else if(!std::strcmp(v, "line")) emit = EMIT_LINE;
+			else if(!std::strcmp(v, "area")) emit = EMIT_AREA;
+			else{
+				std::cerr << "unknown emitter " << v << std::endl;
+				return 1;
+			}
+			i++;
+		}
+		else if(!std::strcmp(a, "--emit-rate")){ emit_rate = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--emit-life")){ emit_life = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--pool")){ pool = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--replay")){ replay_path = v; i++; }
+		else if(!std::strcmp(a, "--obstacles")){ obstacles = v; i++; }
+		else if(!std::strcmp(a, "--iterations")){ xpbd.iterations = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--restitution")){ xpbd.restitution = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--warm")){ xpbd.warm = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--stack")){ xpbd.stack = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--smoothing")){ fluid.smoothing = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--fluid-iterations")){ fluid.iterations = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--viscosity")){ fluid.viscosity = (float)std::atof(v); i++; }
+		else if(!std::strcmp(a, "--sph")){ sph_path = v; i++; }
+		else if(!std::strcmp(a, "--reorder")){ reorder = std::atoi(v); i++; }
+		else if(!std::strcmp(a, "--solver")){
+			solver = -1;
+			for(int k=0;k<SOLVER_COUNT;k++){
+				if(!std::strcmp(v, solver_kind_name(k))) solver = k;
+			}
+			if(solver < 0){
+				std::cerr << "unknown solver " << v << std::endl;
+				return 1;
+			}
+			i++;
+		}
+		else if(!std::strcmp(a, "--broad")){
+			broad = -1;
+			for(int k=0;k<BROAD_COUNT;k++){
+				if(!std::strcmp(v, broad_phase_name(k))) broad = k;
+			}
+			if(broad < 0){
+				std::cerr << "unknown broad phase " << v << std::endl;
+				return 1;
+			}
+			i++;
+		}
+		else{
+			std::cerr << "unknown option " << a << std::endl;
+			return 1;
+		}
+	}
+	if(replay_path) return replay(replay_path, threads, narrow);
+	if(scene.radius_max < scene.radius_min) scene.radius_max = scene.radius_min;
+
+	simulation sim(threads);
+	generate_scene(sim.w, scene);
+
+	/* the emitter pool holds the scene plus room for the emitted balls */
+	emitter_system emitters(scene.seed);
+	if(emit >= 0){
+		if(pool <= 0) pool = sim.w.size() + (int)(emit_rate * (emit_life > 0 ? emit_life : steps)) + 1;
+		emitters.reserve(sim.w, std::max(pool, sim.w.size()));
+		emitter e;
+		e.shape = emit;
+		e.rate = emit_rate;
+		e.lifetime = emit_life;
+		float W = sim.w.width, H = sim.w.height;
+		e.x0 = 0.5f * W; e.y0 = 0.9f * H;
+		if(emit == EMIT_LINE){ e.x0 = 0.1f * W; e.x1 = 0.9f * W; e.y1 = e.y0; }
+		if(emit == EMIT_AREA){ e.x0 = 0.25f * W; e.x1 = 0.75f * W; e.y0 = 0.25f * H; e.y1 = 0.75f * H; e.spread = M_PI; }
+		emitters.emitters.push_back(e);
+	}
+	if(obstacles && !load_obstacles(obstacles, sim.obstacles)){
+		std::cerr << "cannot read obstacles " << obstacles << std::endl;
+		return 1;
+	}
+	const float* pool_data = sim.w.px.data();
+	sim.w.sleep_enabled = sleep;
+	sim.broad.kind = broad;
+	sim.solver.kernels = narrow_select(narrow);
+	sim.solver_kind = solver;
+	sim.xpbd = xpbd;
+	fluid.kernels = sph_select(sph_path);
+	sim.fluid = fluid;
+	sim.reorder.every = reorder;
+	/* gravity 0 runs without outside forces so energy should be conserved */
+	int mode = gravity ? 0 : -1;
+
+	std::cout << "balls " << sim.w.size() << ", box " << sim.w.width << "x" << sim.w.height
+		<< ", broad " << broad_phase_name(broad) << ", narrow " << sim.solver.kernels.name
+		<< ", solver " << solver_kind_name(solver)
+		<< (solver == SOLVER_XPBD ? " x" + std::to_string(xpbd.iterations) : std::string())
+		<< (solver == SOLVER_SPH ? std::string(" ") + fluid.kernels.name + " x" + std::to_string(fluid.iterations) : std::string())
+		<< ", threads " << sim.pool.size() << ", reorder " << reorder << ", gravity " << gravity
+		<< ", sleep " << (sleep ? "on" : "off") << ", seed " << scene.seed << std::endl;
+
+	world_energy e0 = measure(sim.w);
+	long long pair_tests = 0, contacts = 0, skipped = 0, obstacle_hits = 0;
+	double worst_step = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(int s=0;s<steps;s++){
+		auto t0 = std::chrono::steady_clock::now();
+		if(emit >= 0) emitters.update(sim.w);
+		sim.step(mode, 0, 0);
+		if(sim.reorder.moved) sim.reorder.remap(emitters.expires);
+		auto t1 = std::chrono::steady_clock::now();
+		worst_step = std::max(worst_step, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		pair_tests += sim.stats.pair_tests;
+		contacts += sim.stats.contacts;
+		skipped += sim.stats.skipped;
+		obstacle_hits += sim.stats.obstacle_hits;
+		if(every > 0 && (s + 1) % every == 0){
+			std::cout << "step " << s + 1 << ": pair tests " << sim.stats.pair_tests
+				<< ", contacts " << sim.stats.contacts << ", awake " << sim.stats.awake << std::endl;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	world_energy e1 = measure(sim.w);
+
+	double ke_drift = e0.kinetic > 0 ? (e1.kinetic - e0.kinetic) / e0.kinetic : 0;
+	double me0 = e0.kinetic + e0.potential, me1 = e1.kinetic + e1.potential;
+	double me_drift = me0 > 0 ? (me1 - me0) / me0 : 0;
+	double dp = std::sqrt((e1.px - e0.px)*(e1.px - e0.px) + (e1.py - e0.py)*(e1.py - e0.py));
+	double p_drift = e0.momentum_scale > 0 ? dp / e0.momentum_scale : 0;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "steps/sec          " << steps / seconds << std::endl;
+	std::cout << "ms/step            " << 1000.0 * seconds / steps << " (worst " << worst_step << ")" << std::endl;
+	std::cout << "pair tests/step    " << (double)pair_tests / steps << std::endl;
+	std::cout << "contacts/step      " << (double)contacts / steps << std::endl;
+	std::cout << "skipped/step       " << (double)skipped / steps << std::endl;
+	if(gravity){
+		/* how far a pile is from resting: a settled one keeps about a step
+		 * of gravity per ball and its top stays put */
+		double v2 = 0;
+		float top = 0;
+		for(int i=0;i<sim.w.size();i++){
+			if(!sim.w.alive[i]) continue;
+			v2 += sim.w.vx[i]*sim.w.vx[i] + sim.w.vy[i]*sim.w.vy[i];
+			top = std::max(top, sim.w.py[i] + sim.w.radius[i]);
+		}
+		std::cout << "mean speed^2       " << v2 / std::max(1, sim.w.live) << " (pile top " << top << ")" << std::endl;
+	}
+	if(obstacles){
+		std::cout << "obstacle hits/step " << (double)obstacle_hits / steps << " (" << sim.obstacles.segments.size()
+			<< " segments, " << sim.obstacles.nodes.size() << " bvh nodes)" << std::endl;
+		/* the polygons are solid, no center may be left inside one */
+		int inside = 0;
+		for(int i=0;i<sim.w.size();i++){
+			if(!sim.w.alive[i]) continue;
+			for(int p=0;p<sim.obstacles.polygons();p++){
+				if(sim.obstacles.inside(p, sim.w.px[i], sim.w.py[i])) inside++;
+			}
+		}
+		std::cout << "inside polygons    " << inside << " of " << sim.obstacles.polygons() << " polygons" << std::endl;
+	}
+	if(emit >= 0){
+		std::cout << "pool               " << sim.w.live << " live, peak " << sim.w.high_water
+			<< " of " << sim.w.capacity() << ", spawned " << emitters.spawned << ", retired " << emitters.retired
+			<< ", dropped " << emitters.dropped
+			<< (sim.w.px.data() == pool_data ? "" : ", REALLOCATED") << std::endl;
+	}
+	std::cout << std::scientific << std::setprecision(3);
+	std::cout << "kinetic drift      " << ke_drift << std::endl;
+	std::cout << "mechanical drift   " << me_drift << std::endl;
+	std::cout << "momentum drift     " << p_drift << " (walls are not momentum conserving)" << std::endl;
+	return 0;
+}
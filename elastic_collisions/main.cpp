@@ -1,9 +1,18 @@
 #include "glad/glad.h"
 #include "shader/shader.h"
+#include "physics/world.h"
+#include "physics/simulation.h"
+#include "physics/emitter.h"
+#include "physics/session.h"
+#include "physics/recorder.h"
+#include "physics/pipeline.h"
+#include "physics/heatmap.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <vector>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <cmath>
 
 int scrWidth = 1354;
@@ -13,6 +22,13 @@ glm::mat4 projection = glm::ortho(0.0f, (float)scrWidth, (float)scrHeight, 0.0f)
 /* input control variables */
 int cball = 0;
 int gravity_mode = 0;
+int broad_mode = BROAD_GRID;
+int sleep_mode = 1;
+int emit_mode = 0; /* 0 off, then point (at the cursor), line and area emitter */
+int solver_mode = SOLVER_IMPULSE;
+int record_toggle = 0;
+int view_mode = 0; /* 0 draws the balls, 1 the density heatmap */
+bool replaying = false; /* inputs come from a recording, keys other than escape are ignored */
 
 float randFloat(){
 	return (float)(rand()) / (float)(RAND_MAX);
@@ -21,72 +37,40 @@ glm::vec3 randColor(){
 	return glm::vec3(randFloat(), randFloat(), randFloat());
 }
 
-struct ball{
-	std::vector<float> position = {scrWidth / 2.0f, scrHeight / 2.0f};
-	std::vector<float> velocity = {0.0f, 0.0f};
-	glm::vec3 color;
-	float radius = 20;
-	float mass = 2.0f;
-	int segments = 100;
-	void updateAccel(float x, float y){
-		velocity[0] += (x / 50.0f); // the 50.0f is for scalling
-		velocity[1] -= (y / 50.0f);
-	}
-	void updatePos(){
-		position[0] += velocity[0];
-		position[1] -= velocity[1];
-	}
-	void checkColision(){
-		if(position[1] < 0 + radius){
-			position[1] = 0 + radius;
-			velocity[1] *= -1;
-		}
-		else if(position[1] > scrHeight - radius){
-			position[1] = scrHeight - radius;
-			velocity[1] *= -1;
-		}
-		if(position[0] < 0 + radius){
-			position[0] = 0 + radius;
-			velocity[0] *= -1;
-		}
-		else if(position[0] > scrWidth - radius){
-			position[0] = scrWidth - radius;
-			velocity[0] *= -1;
-		}	
-	}
-	
-	void movementMode(int mode, float xm, float ym, float x, float y){
-		if(mode == 0){
-			/* if mode is 0 (norma) then just use mouse coordinates as velocity vector values and ignore the rest */
-			updateAccel(xm,ym);
-		}
-		else if(mode == 1){
-			float xd, yd, distance;
-			xd = xm-position[0];
-			yd = ym-position[1];
-			distance = std::sqrt(xd*xd + yd*yd);
-			float xn = xd/ distance, yn = yd/distance;
-
-			float vm = (x*x) + (y*y);
-
-			updateAccel(vm*xn, vm*yn);
-		}
-	}
-};
-
-void add_ball(std::vector<ball>& p, float mx, float my){
-	ball c;
-	c.color = randColor();
-	c.position[0] = mx; c.position[1] = my;
-	p.push_back(c);
+/* every slot of the pool keeps its color, new slots get a random one */
+void fill_colors(const world& p, std::vector<glm::vec3>& colors){
+	while((int)colors.size() < p.size()) colors.push_back(randColor());
 }
 
 static void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods){
     if(key == GLFW_KEY_ESCAPE && action == GLFW_PRESS){
 		glfwSetWindowShouldClose(win, GLFW_TRUE);
     }
+	if(replaying) return;
 	if(key == GLFW_KEY_ENTER && action == GLFW_PRESS) cball = 1 - cball;
 	if(key == GLFW_KEY_SPACE && action == GLFW_PRESS) gravity_mode = 1 - gravity_mode;
+	if(key == GLFW_KEY_Z && action == GLFW_PRESS){
+		sleep_mode = 1 - sleep_mode;
+		std::cout << "sleeping: " << (sleep_mode ? "on" : "off") << std::endl;
+	}
+	if(key == GLFW_KEY_E && action == GLFW_PRESS){
+		static const char* names[4] = {"off", "point", "line", "area"};
+		emit_mode = (emit_mode + 1) % 4;
+		std::cout << "emitter: " << names[emit_mode] << std::endl;
+	}
+	if(key == GLFW_KEY_B && action == GLFW_PRESS){
+		broad_mode = (broad_mode + 1) % BROAD_COUNT;
+		std::cout << "broad phase: " << broad_phase_name(broad_mode) << std::endl;
+	}
+	if(key == GLFW_KEY_X && action == GLFW_PRESS){
+		solver_mode = (solver_mode + 1) % SOLVER_COUNT;
+		std::cout << "solver: " << solver_kind_name(solver_mode) << std::endl;
+	}
+	if(key == GLFW_KEY_R && action == GLFW_PRESS) record_toggle = 1;
+	if(key == GLFW_KEY_H && action == GLFW_PRESS){
+		view_mode = 1 - view_mode;
+		std::cout << "view: " << (view_mode ? "density" : "balls") << std::endl;
+	}
 }
 
 /* basically what to do if window is resized */
@@ -97,24 +81,26 @@ void framebuffer_size_callback(GLFWwindow* win, int width, int height){
 	projection = glm::ortho(0.0f, (float)scrWidth, 0.0f, (float)scrHeight);
 }
 
-std::vector<float> create_circle(ball c){
+int segments = 100;
+
+std::vector<float> create_circle(float cx, float cy, float r){
 	std::vector<float> vertices;
 	float x,y;
 	/* we're using GL_TRIANGLE_FAN so first two coordinates need to be the center */
-	vertices.push_back(c.position[0]); vertices.push_back(c.position[1]);
+	vertices.push_back(cx); vertices.push_back(cy);
 
-	for(int i=0;i<=c.segments;i++){
-		float angle = 2.0f * M_PI * i / c.segments;
-		x = c.position[0] + c.radius * std::cos(angle);
-		y = c.position[1] + c.radius * std::sin(angle);
+	for(int i=0;i<=segments;i++){
+		float angle = 2.0f * M_PI * i / segments;
+		x = cx + r * std::cos(angle);
+		y = cy + r * std::sin(angle);
 		vertices.push_back(x); vertices.push_back(y);
 	}
 	
 	return vertices;
 }
 
-void draw_circle(ball c){
-	std::vector<float> circleVertices = create_circle(c);
+void draw_circle(float cx, float cy, float r){
+	std::vector<float> circleVertices = create_circle(cx, cy, r);
 
 	unsigned int VAO;
 	glGenVertexArrays(1, &VAO);
@@ -129,53 +115,173 @@ void draw_circle(ball c){
 	glEnableVertexAttribArray(0);
 
 	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLE_FAN, 0, c.segments+2);
+	glDrawArrays(GL_TRIANGLE_FAN, 0, segments+2);
 	glBindVertexArray(0);
 }
 
-void ball_collision(ball& x, ball& y){
-	float x_distance = x.position[0] - y.position[0];
-	float y_distance = x.position[1] - y.position[1];
-	float distance = std::sqrt(x_distance*x_distance + y_distance*y_distance);
-	float center_distance = x.radius + y.radius;
-	if(distance < center_distance){
-		float xdirection = x_distance / distance;
-		float ydirection = y_distance / distance;
+/* the obstacle segments never move, so they go into one buffer up front */
+unsigned int create_obstacles(const obstacle_set& o){
+	std::vector<float> vertices;
+	for(const segment& s : o.segments){
+		vertices.push_back(s.x0); vertices.push_back(s.y0);
+		vertices.push_back(s.x1); vertices.push_back(s.y1);
+	}
+	unsigned int VAO;
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+
+	unsigned int VBO;
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+	return VAO;
+}
+
+/* what the window draws of one step. the physics thread copies it out of
+ * the world after the step, so the gl thread never reads the world while
+ * the next step runs */
+struct render_state{
+	std::vector<float> vertices; /* x y radius r g b per live ball */
+	int count = 0;
+	bool fluid = false;
+	bool density = false;        /* heat holds the density view instead */
+	std::vector<float> heat;     /* count, mean speed per pixel */
+	int heat_width = 0, heat_height = 0;
+	float heat_max = 0;
+	int awake = 0, live = 0, capacity = 0, high_water = 0;
+};
+
+/* balls keep the color of their slot and fluid particles are colored by
+ * speed, from deep blue at rest to white. the picked one is white. with a
+ * density map only the heatmap of the box is filled in */
+void fill_render_state(render_state& r, session& s, const std::vector<glm::vec3>& colors, int picked, density_map* heat){
+	const world& w = s.sim.w;
+	r.vertices.clear();
+	r.count = 0;
+	r.fluid = s.sim.solver_kind == SOLVER_SPH;
+	r.density = heat != nullptr;
+	if(heat){
+		r.heat_width = std::max((int)w.width, 1);
+		r.heat_height = std::max((int)w.height, 1);
+		r.heat_max = heat->splat(w, s.sim.pool, r.heat_width, r.heat_height, r.heat);
+	}
+	for(int i=0;i<w.size() && !heat;i++){
+		if(!w.alive[i]) continue;
+		glm::vec3 c = colors[i];
+		if(r.fluid){
+			float sp = std::min(std::sqrt(w.vx[i]*w.vx[i] + w.vy[i]*w.vy[i]) / 4.0f, 1.0f);
+			if(i == picked) sp = 1.0f;
+			c = glm::vec3(0.1f + 0.8f * sp, 0.3f + 0.65f * sp, 0.9f + 0.1f * sp);
+		}
+		else if(i == picked) c = glm::vec3(1.0f);
+		float v[6] = {w.px[i], w.py[i], w.radius[i], c.x, c.y, c.z};
+		r.vertices.insert(r.vertices.end(), v, v + 6);
+		r.count++;
+	}
+	r.awake = s.sim.stats.awake;
+	r.live = w.live;
+	r.capacity = w.capacity();
+	r.high_water = w.high_water;
+}
+
+/* the particle renderer: every ball is one point sprite of a single
+ * buffer, laid out like render_state, so a frame is one upload and one
+ * draw call */
+struct particle_buffer{
+	unsigned int VAO = 0, VBO = 0;
+};
 
-		float overlap = center_distance - distance;
-		float separationX = xdirection * overlap / 2.0f;
-        float separationY = ydirection * overlap / 2.0f;
+particle_buffer create_particles(){
+	particle_buffer p;
+	glGenVertexArrays(1, &p.VAO);
+	glBindVertexArray(p.VAO);
 
-        // Move balls apart to resolve overlap
-        x.position[0] += separationX;
-        x.position[1] += separationY;
-        y.position[0] -= separationX;
-        y.position[1] -= separationY;
+	glGenBuffers(1, &p.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, p.VBO);
 
-		// componente normal
-		std::vector<float> n = {xdirection, ydirection};
-		float v1n = (x.velocity[0] * n[0]) + (x.velocity[1] * n[1]);
-		float v2n = (y.velocity[0] * n[0]) + (y.velocity[1] * n[1]);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(2*sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+	return p;
+}
 
+/* the density view: one quad over the box, textured with the histogram.
+ * the texture is reallocated only when the box changes size */
+struct heatmap_buffer{
+	unsigned int VAO = 0, VBO = 0, texture = 0;
+	int width = 0, height = 0;
+};
 
-		//componente tangencial
-		std::vector<float> t = {-n[1],n[0]};
+heatmap_buffer create_heatmap(){
+	heatmap_buffer h;
+	glGenVertexArrays(1, &h.VAO);
+	glBindVertexArray(h.VAO);
 
-		float v1t = (x.velocity[0] * t[0]) + (x.velocity[1] * t[1]);
-		float v2t = (y.velocity[0] * t[0]) + (y.velocity[1] * t[1]);
+	glGenBuffers(1, &h.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, h.VBO);
+	glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
 
-		// choque elastico
-		v1n = (((x.mass - y.mass)*v1n) + (2*y.mass*v2n)) / (x.mass + y.mass);
-		v2n = (((y.mass - x.mass)*v2n) + (2*x.mass*v1n)) / (x.mass + y.mass);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(2*sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
 
-		x.velocity = { ((v1n*n[0]) + (v1t*t[0])), ((v1n*n[1]) + (v1t*t[1])) };
-		y.velocity = { ((v2n*n[0]) + (v2t*t[0])), ((v2n*n[1]) + (v2t*t[1])) };
+	glGenTextures(1, &h.texture);
+	glBindTexture(GL_TEXTURE_2D, h.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return h;
+}
+
+void draw_heatmap(heatmap_buffer& h, const render_state& r){
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, h.texture);
+	if(r.heat_width != h.width || r.heat_height != h.height){
+		h.width = r.heat_width;
+		h.height = r.heat_height;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, h.width, h.height, 0, GL_RG, GL_FLOAT, r.heat.data());
+		float W = (float)h.width, H = (float)h.height;
+		float quad[16] = {0, 0, 0, 0,  W, 0, 1, 0,  0, H, 0, 1,  W, H, 1, 1};
+		glBindBuffer(GL_ARRAY_BUFFER, h.VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof quad, quad);
 	}
+	else glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, h.width, h.height, GL_RG, GL_FLOAT, r.heat.data());
+	glBindVertexArray(h.VAO);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
 }
 
-int main(void){
+void draw_particles(particle_buffer& p, const render_state& r){
+	glBindBuffer(GL_ARRAY_BUFFER, p.VBO);
+	glBufferData(GL_ARRAY_BUFFER, r.vertices.size() * sizeof(float), r.vertices.data(), GL_STREAM_DRAW);
+	glBindVertexArray(p.VAO);
+	glDrawArrays(GL_POINTS, 0, r.count);
+	glBindVertexArray(0);
+}
+
+/* usage: main [--replay FILE] [--obstacles FILE] */
+int main(int argc, char** argv){
+	const char* replay_path = nullptr;
+	const char* obstacles_path = nullptr;
+	for(int i=1;i<argc;i++){
+		if(!std::strcmp(argv[i], "--replay") && i + 1 < argc) replay_path = argv[++i];
+		else if(!std::strcmp(argv[i], "--obstacles") && i + 1 < argc) obstacles_path = argv[++i];
+	}
+
     if(!glfwInit()) { /* failed */ }
-	srand(time(NULL));
+	unsigned seed = time(NULL);
+	srand(seed);
     
     GLFWwindow* win = glfwCreateWindow(scrWidth, scrHeight, "elastic collision", NULL, NULL);
 	if(!win) {
@@ -201,59 +307,179 @@ int main(void){
 	std::cout << scrWidth << "x" << scrHeight << std::endl;
 	std::cout << centerx << "x" << centery<< std::endl;
 
-	ball c1, c2, c3, c4;
-	c1.color = randColor();
-	c2.color = randColor();
-	c3.color = randColor();
-	c4.color = randColor();
-	c1.position[1] = scrHeight - c1.radius;
-	c3.position[1] = c1.position[1]; c3.position[0] = scrWidth - c3.radius;
-	c4.position[0] = c4.radius; c4.position[1] = scrHeight - c4.radius;
-
-	std::vector<ball> balls = {c1, c2, c3, c4};
+	/* collision pipeline: broad phase candidates -> colored contact batches -> worker threads.
+	 * the point, line and area emitter share one preallocated pool */
+	session sess;
+	world& balls = sess.sim.w;
+	std::vector<glm::vec3> colors;
+	colors.reserve(8192);
+
+	recording_reader replay;
+	recording_writer recorder;
+	if(replay_path){
+		if(!replay.open(replay_path, sess)){
+			std::cerr << "cannot read recording " << replay_path << std::endl;
+			return -1;
+		}
+		replaying = true;
+		srand(replay.seed);
+		std::cout << "replaying " << replay_path << std::endl;
+	}
+	else{
+		sess.setup(scrWidth, scrHeight, seed);
+		if(obstacles_path && !load_obstacles(obstacles_path, sess.sim.obstacles)){
+			std::cerr << "cannot read obstacles " << obstacles_path << std::endl;
+			return -1;
+		}
+	}
+	fill_colors(balls, colors);
+	unsigned int obstacleVAO = create_obstacles(sess.sim.obstacles);
+	int obstacle_vertices = 2 * (int)sess.sim.obstacles.segments.size();
 	Shader shader("shader/shader.vs", "shader/shader.fs");
+	Shader particle_shader("shader/particle.vs", "shader/particle.fs");
+	particle_buffer particles = create_particles();
+	Shader heatmap_shader("shader/heatmap.vs", "shader/heatmap.fs");
+	heatmap_buffer heatmap = create_heatmap();
+	density_map density; /* only used on the physics thread */
+	glEnable(GL_PROGRAM_POINT_SIZE);
+
+	/* physics steps on its own thread while this one draws the step before */
+	frame_pipeline<render_state> pipeline;
+	fill_render_state(pipeline.back(), sess, colors, -1, nullptr);
+	pipeline.swap();
 
 	double mousex, mousey;
-	float mx, my;
+	frame_input in;
+	frame_time_stats times, frames, waits;
+	long long replay_checked = 0, replay_bad = -1;
 
     while(!glfwWindowShouldClose(win)){
-		if(cball){
-			add_ball(balls, mx, my);
+		auto frame_start = std::chrono::steady_clock::now();
+		if(replaying){
+			if(!replay.next(in)) break;
+			if(in.width != scrWidth || in.height != scrHeight) glfwSetWindowSize(win, in.width, in.height);
+		}
+		else{
+			glfwGetCursorPos(win, &mousex, &mousey);
+			in.mx = static_cast<float>(mousex);
+			in.my = scrHeight - static_cast<float>(mousey);
+			in.width = scrWidth; in.height = scrHeight;
+			in.cball = cball;
+			in.gravity_mode = gravity_mode;
+			in.broad_mode = broad_mode;
+			in.sleep_mode = sleep_mode;
+			in.emit_mode = emit_mode;
+			in.solver_mode = solver_mode;
 			cball = 0;
 		}
 
-		glfwGetCursorPos(win, &mousex, &mousey);
-		mx = static_cast<float>(mousex);
-		my = static_cast<float>(mousey);
-		my = scrHeight - my;
+		if(record_toggle){
+			record_toggle = 0;
+			if(recorder.is_open()){
+				recorder.close(sess);
+				std::cout << "recorded " << recorder.frames << " steps" << std::endl;
+			}
+			else if(recorder.open("recording.ecr", sess, seed)){
+				std::cout << "recording to recording.ecr" << std::endl;
+			}
+		}
+
+		bool recording = recorder.is_open();
+		bool density_view = view_mode == 1;
+
+		/* step N+1 runs on the physics thread, which also owns the session
+		 * and the ball colors until finish() */
+		pipeline.start([&, in, density_view](render_state& r){
+			sess.step(in);
+			fill_colors(balls, colors);
+			if(sess.sim.reorder.moved) sess.sim.reorder.remap(colors);
+			if(recorder.is_open()) recorder.frame(in, sess);
+			if(replaying && replay.has_hash){
+				replay_checked++;
+				if(replay_bad < 0 && replay.hash != hash_world(balls)) replay_bad = replay.frames;
+			}
+			/* the ball under the cursor is drawn white */
+			int picked = sess.sim.broad.pick(balls, in.mx, in.my);
+			fill_render_state(r, sess, colors, picked, density_view ? &density : nullptr);
+		});
 
+		/* meanwhile this thread draws step N */
+		const render_state& r = pipeline.front();
+		shader.use();
 		shader.setUProjection("uProjection", projection);
 
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		shader.use();
-		for(int i=0;i<balls.size();i++){
-			shader.setBallColor("ballColor", balls[i].color);
-			draw_circle(balls[i]);
-			balls[i].checkColision();
-			balls[i].updatePos();
-
-			if(gravity_mode == 0){
-				balls[i].movementMode(0,0, -9.81, 0,0);
-			}
-			else if(gravity_mode == 1){
-				balls[i].movementMode(1, mx, my, 2,-8.2);
+		if(r.density){
+			heatmap_shader.use();
+			heatmap_shader.setUProjection("uProjection", projection);
+			heatmap_shader.setInt("uHeat", 0);
+			heatmap_shader.setFloat("uMaxCount", r.heat_max);
+			draw_heatmap(heatmap, r);
+		}
+		else if(r.fluid){
+			/* a fluid has too many particles for a mesh each */
+			particle_shader.use();
+			particle_shader.setUProjection("uProjection", projection);
+			draw_particles(particles, r);
+		}
+		else{
+			shader.use();
+			for(int i=0;i<r.count;i++){
+				const float* v = &r.vertices[6 * i];
+				shader.setBallColor("ballColor", glm::vec3(v[3], v[4], v[5]));
+				draw_circle(v[0], v[1], v[2]);
 			}
+		}
 
-			for(int j=i+1;j<balls.size();j++){
-				ball_collision(balls[i], balls[j]);
-			}
+		shader.use();
+
+		if(obstacle_vertices > 0){
+			shader.setBallColor("ballColor", glm::vec3(0.8f));
+			glBindVertexArray(obstacleVAO);
+			glDrawArrays(GL_LINES, 0, obstacle_vertices);
+			glBindVertexArray(0);
 		}
 
+		std::string title = "elastic collision - awake " + std::to_string(r.awake)
+			+ " asleep " + std::to_string(r.live - r.awake)
+			+ " pool " + std::to_string(r.live) + "/" + std::to_string(r.capacity)
+			+ " peak " + std::to_string(r.high_water)
+			+ (recording ? " REC" : "") + (replaying ? " REPLAY" : "");
+		glfwSetWindowTitle(win, title.c_str());
+
+		/* the swap can block on vsync, so it waits alongside the step. the
+		 * callbacks only set the input variables, which the step doesn't
+		 * read; record_toggle is handled at the top of the next frame,
+		 * after finish() */
 		glfwSwapBuffers(win);
 		glfwPollEvents();
+
+		pipeline.finish();
+		times.add(pipeline.job_ms);
+		waits.add(pipeline.wait_ms);
+		frames.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
     }
 
+	if(recorder.is_open()){
+		recorder.close(sess);
+		std::cout << "recorded " << recorder.frames << " steps" << std::endl;
+	}
+	if(replaying){
+		if(replay.has_hash){
+			replay_checked++;
+			if(replay_bad < 0 && replay.hash != hash_world(balls)) replay_bad = replay.frames;
+		}
+		std::cout << "replay checkpoints " << replay_checked
+			<< (replay_bad < 0 ? ", bit exact" : ", DIVERGED at step " + std::to_string(replay_bad)) << std::endl;
+	}
+	std::cout << "physics  ";
+	times.report(std::cout);
+	std::cout << "waited   ";
+	waits.report(std::cout);
+	std::cout << "frame    ";
+	frames.report(std::cout);
+
     glfwDestroyWindow(win);
     glfwTerminate();
     return 0;
@@ -0,0 +1,77 @@
+#ifndef BROAD_PHASE_H
+#define BROAD_PHASE_H
+
+#include "world.h"
+#include "grid.h"
+#include "sweep_prune.h"
+#include "quadtree.h"
+#include <cfloat>
+#include <vector>
+
+/* runtime switch between the broad phases so they can be compared on the
+ * same scene. every kind reports each bounding box overlap once as a < b */
+enum broad_phase_kind{
+	BROAD_BRUTE = 0, /* the original all pairs loop */
+	BROAD_GRID,
+	BROAD_SAP,
+	BROAD_QUADTREE,
+	BROAD_COUNT
+};
+
+inline const char* broad_phase_name(int kind){
+	static const char* names[BROAD_COUNT] = {"brute", "grid", "sap", "quadtree"};
+	return (kind >= 0 && kind < BROAD_COUNT) ? names[kind] : "?";
+}
+
+struct broad_phase{
+	int kind = BROAD_GRID;
+	uniform_grid grid;
+	sweep_prune sap;
+	loose_quadtree tree;
+
+	void pairs(const world& w, std::vector<contact>& out){
+		out.clear();
+		if(kind == BROAD_BRUTE){
+			brute_force_pairs(w, out);
+		}
+		else if(kind == BROAD_GRID){
+			grid.build(w);
+			grid.pairs(w, out);
+		}
+		else if(kind == BROAD_SAP){
+			sap.pairs(w, out);
+		}
+		else if(kind == BROAD_QUADTREE){
+			tree.pairs(w, out);
+		}
+	}
+
+	/* the ball under a point, through the quadtree when it is the active
+	 * kind and a plain scan otherwise. doesn't change any broad phase state */
+	int pick(const world& w, float x, float y){
+		if(kind == BROAD_QUADTREE) return tree.pick(w, x, y);
+		int best = -1;
+		float best_d = FLT_MAX;
+		for(int i=0;i<w.size();i++){
+			if(!w.alive[i]) continue;
+			float dx = w.px[i] - x, dy = w.py[i] - y;
+			float d = dx*dx + dy*dy;
+			if(d <= w.radius[i] * w.radius[i] && d < best_d){
+				best = i;
+				best_d = d;
+			}
+		}
+		return best;
+	}
+
+	/* forgets the incremental state, the next sap step sorts from scratch.
+	 * a recording starts from here so a replay sees the same pair order */
+	void reset(){
+		sap.balls = -1;
+		sap.overlaps.clear();
+		sap.where.clear();
+		tree.balls = -1;
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include "world.h"
+#include <vector>
+#include <random>
+#include <cmath>
+
+enum emitter_shape{
+	EMIT_POINT = 0, /* from (x0, y0) */
+	EMIT_LINE,      /* anywhere on the segment (x0, y0) - (x1, y1) */
+	EMIT_AREA       /* anywhere in the box (x0, y0) - (x1, y1) */
+};
+
+/* spawns balls into the world pool at a steady rate and retires them after
+ * a fixed number of steps, so spawn and retire rate match once the emitter
+ * is warm. balls are launched along (dirx, diry) with up to spread radians
+ * of random deviation */
+struct emitter{
+	int shape = EMIT_POINT;
+	float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	float rate = 1.0f;      /* balls per step, fractions carry over */
+	int lifetime = 600;     /* steps a ball lives, 0 keeps it forever */
+	float dirx = 0.0f, diry = -1.0f;
+	float speed = 3.0f;
+	float spread = 0.3f;
+	float radius_min = 4.0f, radius_max = 8.0f;
+	float density = 2.0f / 400.0f; /* mass = density * r^2, 2.0 at the default r = 20 */
+	bool active = true;
+	float carry = 0.0f;
+};
+
+/* owns the emitters and the per slot expiry, both sized once up front so
+ * that spawning a ball never allocates */
+struct emitter_system{
+	std::vector<emitter> emitters;
+	std::vector<long long> expires; /* step a slot retires at, -1 for never */
+	std::mt19937 rng;
+	long long steps = 0;
+	int spawned = 0, retired = 0, dropped = 0; /* totals, dropped when the pool was full */
+
+	explicit emitter_system(unsigned seed = 1) : rng(seed){}
+
+	/* preallocates the pool so the world and the expiry table never grow */
+	void reserve(world& w, int capacity){
+		w.reserve(capacity);
+		expires.assign(capacity, -1);
+	}
+
+	float uniform(float a, float b){
+		return a + (b - a) * std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+	}
+
+	/* past the reserved capacity add() would grow every world array */
+	bool full(const world& w) const{
+		return w.free_slots.empty() && w.size() >= w.capacity();
+	}
+
+	/* a ball that never expires, or -1 and a drop when the pool is full.
+	 * every ball that is not there from the start comes in through here */
+	int place(world& w, float x, float y, float r = 20.0f, float m = 2.0f){
+		if(full(w)){
+			dropped++;
+			return -1;
+		}
+		int i = w.add(x, y, r, m);
+		if(i < (int)expires.size()) expires[i] = -1;
+		return i;
+	}
+
+	/* checks for room before drawing any random numbers, so a full pool
+	 * leaves the generator where it was */
+	int spawn(world& w, const emitter& e){
+		if(full(w)){
+			dropped++;
+			return -1;
+		}
+		float x = e.x0, y = e.y0;
+		if(e.shape == EMIT_LINE){
+			float t = uniform(0.0f, 1.0f);
+			x = e.x0 + (e.x1 - e.x0) * t;
+			y = e.y0 + (e.y1 - e.y0) * t;
+		}
+		else if(e.shape == EMIT_AREA){
+			x = uniform(e.x0, e.x1);
+			y = uniform(e.y0, e.y1);
+		}
+		float r = uniform(e.radius_min, e.radius_max);
+		int i = place(w, x, y, r, e.density * r * r);
+
+		float angle = std::atan2(e.diry, e.dirx) + uniform(-e.spread, e.spread);
+		w.vx[i] = e.speed * std::cos(angle);
+		w.vy[i] = e.speed * std::sin(angle);
+		if(i < (int)expires.size()) expires[i] = e.lifetime > 0 ? steps + e.lifetime : -1;
+		spawned++;
+		return i;
+	}
+
+	/* retires the balls whose time is up, then lets every emitter spawn.
+	 * call once per physics step. returns how many balls were spawned */
+	int update(world& w){
+		for(int i=0;i<w.size() && i<(int)expires.size();i++){
+			if(w.alive[i] && expires[i] >= 0 && expires[i] <= steps){
+				w.retire(i);
+				expires[i] = -1;
+				retired++;
+			}
+		}
+		int n = 0;
+		for(emitter& e : emitters){
+			if(!e.active) continue;
+			e.carry += e.rate;
+			while(e.carry >= 1.0f){
+				e.carry -= 1.0f;
+				if(spawn(w, e) >= 0) n++;
+			}
+		}
+		steps++;
+		return n;
+	}
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "world.h"
+#include <vector>
+#include <algorithm>
+
+struct contact{
+	int a, b;
+};
+
+/* uniform grid broad phase. cells are at least as wide as the biggest ball
+ * so every touching pair is found in the same or in an adjacent cell.
+ * balls are bucketed with a counting sort so the cell lists are contiguous */
+struct uniform_grid{
+	float cell = 40.0f;
+	int cols = 0, rows = 0;
+	std::vector<int> cell_of;     /* cell index of every ball */
+	std::vector<int> cell_start;  /* balls of cell c are items[cell_start[c] .. cell_start[c+1]] */
+	std::vector<int> items;
+
+	int cell_x(float x) const{
+		int c = (int)(x / cell);
+		return std::min(std::max(c, 0), cols - 1);
+	}
+	int cell_y(float y) const{
+		int c = (int)(y / cell);
+		return std::min(std::max(c, 0), rows - 1);
+	}
+
+	/* min_cell widens the cells for searches that reach further than the
+	 * balls touch, like the smoothing radius of the fluid */
+	void build(const world& w, float min_cell = 0.0f){
+		int n = w.size();
+		float rmax = 1.0f;
+		for(int i=0;i<n;i++){
+			if(w.alive[i]) rmax = std::max(rmax, w.radius[i]);
+		}
+		cell = std::max(2.0f * rmax, min_cell);
+		cols = std::max(1, (int)(w.width / cell) + 1);
+		rows = std::max(1, (int)(w.height / cell) + 1);
+
+		cell_of.resize(n);
+		cell_start.assign(cols * rows + 1, 0);
+		for(int i=0;i<n;i++){
+			if(!w.alive[i]){
+				cell_of[i] = -1;
+				continue;
+			}
+			cell_of[i] = cell_y(w.py[i]) * cols + cell_x(w.px[i]);
+			cell_start[cell_of[i] + 1]++;
+		}
+		for(int c=0;c<cols*rows;c++) cell_start[c + 1] += cell_start[c];
+
+		items.resize(cell_start[cols * rows]);
+		std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+		for(int i=0;i<n;i++){
+			if(cell_of[i] >= 0) items[fill[cell_of[i]]++] = i;
+		}
+	}
+
+	/* appends every pair whose bounding boxes overlap. only half of the
+	 * neighborhood is visited so each pair is reported once, always as a < b */
+	void pairs(const world& w, std::vector<contact>& out) const{
+		static const int nx[4] = {1, -1, 0, 1};
+		static const int ny[4] = {0, 1, 1, 1};
+		for(int cy=0;cy<rows;cy++){
+			for(int cx=0;cx<cols;cx++){
+				int c = cy * cols + cx;
+				for(int k=cell_start[c];k<cell_start[c + 1];k++){
+					int i = items[k];
+					for(int l=k+1;l<cell_start[c + 1];l++){
+						test(w, i, items[l], out);
+					}
+					for(int d=0;d<4;d++){
+						int ox = cx + nx[d], oy = cy + ny[d];
+						if(ox < 0 || ox >= cols || oy >= rows) continue;
+						int o = oy * cols + ox;
+						for(int l=cell_start[o];l<cell_start[o + 1];l++){
+							test(w, i, items[l], out);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/* box test written on the box edges so every broad phase rounds the same
+	 * way. boxes that only touch are skipped, the narrow phase rejects them too */
+	static void test(const world& w, int i, int j, std::vector<contact>& out){
+		if(w.px[i] - w.radius[i] >= w.px[j] + w.radius[j] || w.px[j] - w.radius[j] >= w.px[i] + w.radius[i]) return;
+		if(w.py[i] - w.radius[i] >= w.py[j] + w.radius[j] || w.py[j] - w.radius[j] >= w.py[i] + w.radius[i]) return;
+		if(i < j) out.push_back({i, j});
+		else out.push_back({j, i});
+	}
+};
+
+/* the original all pairs loop, kept as the reference broad phase */
+inline void brute_force_pairs(const world& w, std::vector<contact>& out){
+	for(int i=0;i<w.size();i++){
+		if(!w.alive[i]) continue;
+		float xl = w.px[i] - w.radius[i], xh = w.px[i] + w.radius[i];
+		float yl = w.py[i] - w.radius[i], yh = w.py[i] + w.radius[i];
+		for(int j=i+1;j<w.size();j++){
+			/* no short circuit, so the miss case stays free of branches */
+			bool apart = (xl >= w.px[j] + w.radius[j]) | (w.px[j] - w.radius[j] >= xh)
+				| (yl >= w.py[j] + w.radius[j]) | (w.py[j] - w.radius[j] >= yh) | !w.alive[j];
+			if(!apart) out.push_back({i, j});
+		}
+	}
+}
+
+#endif
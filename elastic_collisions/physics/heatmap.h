@@ -0,0 +1,85 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "world.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* screen resolution histogram of the balls for the density view. every
+ * live ball adds one to the pixel its center is in and its speed to that
+ * pixel's speed sum. the slots are cut into at most max_slices slices,
+ * each thread splats its slice into a private histogram, and a second
+ * pass sums the histograms pixel by pixel and zeroes them for the next
+ * frame. a slice gets at least a quarter as many balls as there are
+ * pixels, since summing a histogram costs about as much as filling it
+ * with that many balls. the output is two floats per
+ * pixel, the count and the mean speed, row 0 at y = 0, ready to be
+ * uploaded as one texture. drawing it costs the same for any number of
+ * balls */
+struct density_map{
+	int max_slices = 8; /* bounds the memory, one histogram per slice */
+	std::vector<std::vector<unsigned>> counts;
+	std::vector<std::vector<float>> speeds;
+	std::vector<unsigned char> used;
+	std::vector<int> filled; /* the slices splatted this frame */
+	std::vector<float> slice_max;
+
+	/* fills texels with width * height pixels and returns the largest count */
+	float splat(const world& w, thread_pool& pool, int width, int height, std::vector<float>& texels){
+		int n = w.size();
+		int pixels = width * height;
+		texels.resize(2 * (size_t)std::max(pixels, 0));
+		if(pixels <= 0) return 0;
+		counts.resize(pool.size());
+		speeds.resize(pool.size());
+		used.assign(pool.size(), 0);
+		slice_max.assign(pool.size(), 0.0f);
+
+		int slices = std::max(1, std::min(pool.size(), max_slices));
+		int grain = std::max(std::max(1, n / slices), pixels / 4);
+		pool.parallel_for(n, [&](int begin, int end, int t){
+			std::vector<unsigned>& c = counts[t];
+			std::vector<float>& s = speeds[t];
+			if((int)c.size() != pixels){
+				c.assign(pixels, 0);
+				s.assign(pixels, 0.0f);
+			}
+			used[t] = 1;
+			for(int i=begin;i<end;i++){
+				if(!w.alive[i]) continue;
+				int x = std::min(std::max((int)w.px[i], 0), width - 1);
+				int y = std::min(std::max((int)w.py[i], 0), height - 1);
+				int p = y * width + x;
+				c[p]++;
+				s[p] += std::sqrt(w.vx[i]*w.vx[i] + w.vy[i]*w.vy[i]);
+			}
+		}, grain);
+		filled.clear();
+		for(int t=0;t<pool.size();t++){
+			if(used[t]) filled.push_back(t);
+		}
+
+		pool.parallel_for(pixels, [&](int begin, int end, int t){
+			float top = 0;
+			for(int p=begin;p<end;p++){
+				unsigned c = 0;
+				float s = 0;
+				for(int k : filled){
+					c += counts[k][p];
+					s += speeds[k][p];
+					counts[k][p] = 0;
+					speeds[k][p] = 0.0f;
+				}
+				texels[2 * p] = (float)c;
+				texels[2 * p + 1] = c > 0 ? s / c : 0.0f;
+				top = std::max(top, (float)c);
+			}
+			slice_max[t] = top;
+		}, 4096);
+		return *std::max_element(slice_max.begin(), slice_max.end());
+	}
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef NARROW_H
+#define NARROW_H
+
+#include "world.h"
+#include "grid.h"
+#include <vector>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NARROW_X86 1
+#endif
+
+/* circle-circle narrow phase over candidate pairs read straight from the SoA
+ * arrays. overlap() keeps the pairs that touch, resolve() runs the
+ * ball_collision math on a list of pairs that share no ball (one color of
+ * the contact solver), which is what makes scattering the lanes back safe.
+ * every path does the same float operations in the same order (no fma) so
+ * they all give bit-identical results */
+struct narrow_kernels{
+	const char* name;
+	int lanes;
+	int (*overlap)(const world& w, const contact* c, int n, contact* out);
+	int (*resolve)(world& w, const contact* c, int n);
+};
+
+inline int overlap_scalar(const world& w, const contact* c, int n, contact* out){
+	int k = 0;
+	for(int i=0;i<n;i++){
+		float dx = w.px[c[i].a] - w.px[c[i].b], dy = w.py[c[i].a] - w.py[c[i].b];
+		float r = w.radius[c[i].a] + w.radius[c[i].b];
+		float d2 = dx*dx + dy*dy;
+		if(d2 < r*r && d2 != 0.0f) out[k++] = c[i];
+	}
+	return k;
+}
+
+inline int resolve_scalar(world& w, const contact* c, int n){
+	int hits = 0;
+	for(int i=0;i<n;i++) hits += ball_collision(w, c[i].a, c[i].b);
+	return hits;
+}
+
+#ifdef NARROW_X86
+
+/* lane results of one resolved block, written back only where mask is set */
+inline void narrow_scatter(world& w, const contact* c, int lanes, int mask,
+		const float* pxa, const float* pya, const float* pxb, const float* pyb,
+		const float* vxa, const float* vya, const float* vxb, const float* vyb){
+	for(int l=0;l<lanes;l++){
+		if(!(mask & (1 << l))) continue;
+		int a = c[l].a, b = c[l].b;
+		w.px[a] = pxa[l]; w.py[a] = pya[l];
+		w.px[b] = pxb[l]; w.py[b] = pyb[l];
+		w.vx[a] = vxa[l]; w.vy[a] = vya[l];
+		w.vx[b] = vxb[l]; w.vy[b] = vyb[l];
+	}
+}
+
+#define NARROW_LOAD4(v, m) _mm_setr_ps(v[c[0].m], v[c[1].m], v[c[2].m], v[c[3].m])
+
+inline int overlap_sse(const world& w, const contact* c, int n, contact* out){
+	int k = 0, i = 0;
+	const float *px = w.px.data(), *py = w.py.data(), *rad = w.radius.data();
+	for(;i+4<=n;i+=4, c+=4){
+		__m128 dx = _mm_sub_ps(NARROW_LOAD4(px, a), NARROW_LOAD4(px, b));
+		__m128 dy = _mm_sub_ps(NARROW_LOAD4(py, a), NARROW_LOAD4(py, b));
+		__m128 r = _mm_add_ps(NARROW_LOAD4(rad, a), NARROW_LOAD4(rad, b));
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 hit = _mm_and_ps(_mm_cmplt_ps(d2, _mm_mul_ps(r, r)), _mm_cmpneq_ps(d2, _mm_setzero_ps()));
+		int mask = _mm_movemask_ps(hit);
+		while(mask){
+			int l = __builtin_ctz(mask);
+			out[k++] = c[l];
+			mask &= mask - 1;
+		}
+	}
+	return k + overlap_scalar(w, c, n - i, out + k);
+}
+
+inline int resolve_sse(world& w, const contact* c, int n){
+	int hits = 0, i = 0;
+	const float *px = w.px.data(), *py = w.py.data(), *rad = w.radius.data();
+	const float *vx = w.vx.data(), *vy = w.vy.data(), *mass = w.mass.data();
+	const __m128 zero = _mm_setzero_ps(), two = _mm_set1_ps(2.0f);
+	alignas(16) float o[8][4];
+	for(;i+4<=n;i+=4, c+=4){
+		__m128 pxa = NARROW_LOAD4(px, a), pxb = NARROW_LOAD4(px, b);
+		__m128 pya = NARROW_LOAD4(py, a), pyb = NARROW_LOAD4(py, b);
+		__m128 dx = _mm_sub_ps(pxa, pxb), dy = _mm_sub_ps(pya, pyb);
+		__m128 r = _mm_add_ps(NARROW_LOAD4(rad, a), NARROW_LOAD4(rad, b));
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 hit = _mm_and_ps(_mm_cmplt_ps(d2, _mm_mul_ps(r, r)), _mm_cmpneq_ps(d2, zero));
+		int mask = _mm_movemask_ps(hit);
+		if(!mask) continue; /* no touching pair, skip the sqrt and the impulse */
+
+		__m128 dist = _mm_sqrt_ps(d2);
+		__m128 xdir = _mm_div_ps(dx, dist), ydir = _mm_div_ps(dy, dist);
+		__m128 overlap = _mm_sub_ps(r, dist);
+		__m128 sepx = _mm_div_ps(_mm_mul_ps(xdir, overlap), two);
+		__m128 sepy = _mm_div_ps(_mm_mul_ps(ydir, overlap), two);
+
+		__m128 vxa = NARROW_LOAD4(vx, a), vya = NARROW_LOAD4(vy, a);
+		__m128 vxb = NARROW_LOAD4(vx, b), vyb = NARROW_LOAD4(vy, b);
+		__m128 ma = NARROW_LOAD4(mass, a), mb = NARROW_LOAD4(mass, b);
+		__m128 v1n = _mm_add_ps(_mm_mul_ps(vxa, xdir), _mm_mul_ps(vya, ydir));
+		__m128 v2n = _mm_add_ps(_mm_mul_ps(vxb, xdir), _mm_mul_ps(vyb, ydir));
+		__m128 msum = _mm_add_ps(ma, mb);
+		__m128 u1n = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(ma, mb), v1n), _mm_mul_ps(_mm_mul_ps(two, mb), v2n)), msum);
+		__m128 u2n = _mm_div_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(mb, ma), v2n), _mm_mul_ps(_mm_mul_ps(two, ma), v1n)), msum);
+		__m128 d1 = _mm_sub_ps(u1n, v1n), d2n = _mm_sub_ps(u2n, v2n);
+
+		_mm_store_ps(o[0], _mm_add_ps(pxa, sepx));
+		_mm_store_ps(o[1], _mm_add_ps(pya, sepy));
+		_mm_store_ps(o[2], _mm_sub_ps(pxb, sepx));
+		_mm_store_ps(o[3], _mm_sub_ps(pyb, sepy));
+		_mm_store_ps(o[4], _mm_add_ps(vxa, _mm_mul_ps(d1, xdir)));
+		_mm_store_ps(o[5], _mm_add_ps(vya, _mm_mul_ps(d1, ydir)));
+		_mm_store_ps(o[6], _mm_add_ps(vxb, _mm_mul_ps(d2n, xdir)));
+		_mm_store_ps(o[7], _mm_add_ps(vyb, _mm_mul_ps(d2n, ydir)));
+		narrow_scatter(w, c, 4, mask, o[0], o[1], o[2], o[3], o[4], o[5], o[6], o[7]);
+		hits += __builtin_popcount(mask);
+	}
+	return hits + resolve_scalar(w, c, n - i);
+}
+
+#undef NARROW_LOAD4
+
+/* splits 8 interleaved {a, b} contacts into a vector of a and a vector of b */
+__attribute__((target("avx2")))
+inline void narrow_indices8(const contact* c, __m256i& ia, __m256i& ib){
+	const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	__m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)c), split);
+	__m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(c + 4)), split);
+	ia = _mm256_permute2x128_si256(lo, hi, 0x20);
+	ib = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+__attribute__((target("avx2")))
+inline int overlap_avx2(const world& w, const contact* c, int n, contact* out){
+	int k = 0, i = 0;
+	const float *px = w.px.data(), *py = w.py.data(), *rad = w.radius.data();
+	for(;i+8<=n;i+=8, c+=8){
+		__m256i ia, ib;
+		narrow_indices8(c, ia, ib);
+		__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(px, ia, 4), _mm256_i32gather_ps(px, ib, 4));
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(py, ia, 4), _mm256_i32gather_ps(py, ib, 4));
+		__m256 r = _mm256_add_ps(_mm256_i32gather_ps(rad, ia, 4), _mm256_i32gather_ps(rad, ib, 4));
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LT_OQ),
+			_mm256_cmp_ps(d2, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+		int mask = _mm256_movemask_ps(hit);
+		while(mask){
+			int l = __builtin_ctz(mask);
+			out[k++] = c[l];
+			mask &= mask - 1;
+		}
+	}
+	return k + overlap_sse(w, c, n - i, out + k);
+}
+
+__attribute__((target("avx2")))
+inline int resolve_avx2(world& w, const contact* c, int n){
+	int hits = 0, i = 0;
+	const float *px = w.px.data(), *py = w.py.data(), *rad = w.radius.data();
+	const float *vx = w.vx.data(), *vy = w.vy.data(), *mass = w.mass.data();
+	const __m256 zero = _mm256_setzero_ps(), two = _mm256_set1_ps(2.0f);
+	alignas(32) float o[8][8];
+	for(;i+8<=n;i+=8, c+=8){
+		__m256i ia, ib;
+		narrow_indices8(c, ia, ib);
+		__m256 pxa = _mm256_i32gather_ps(px, ia, 4), pxb = _mm256_i32gather_ps(px, ib, 4);
+		__m256 pya = _mm256_i32gather_ps(py, ia, 4), pyb = _mm256_i32gather_ps(py, ib, 4);
+		__m256 dx = _mm256_sub_ps(pxa, pxb), dy = _mm256_sub_ps(pya, pyb);
+		__m256 r = _mm256_add_ps(_mm256_i32gather_ps(rad, ia, 4), _mm256_i32gather_ps(rad, ib, 4));
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LT_OQ),
+			_mm256_cmp_ps(d2, zero, _CMP_NEQ_UQ));
+		int mask = _mm256_movemask_ps(hit);
+		if(!mask) continue; /* no touching pair, skip the sqrt and the impulse */
+
+		__m256 dist = _mm256_sqrt_ps(d2);
+		__m256 xdir = _mm256_div_ps(dx, dist), ydir = _mm256_div_ps(dy, dist);
+		__m256 overlap = _mm256_sub_ps(r, dist);
+		__m256 sepx = _mm256_div_ps(_mm256_mul_ps(xdir, overlap), two);
+		__m256 sepy = _mm256_div_ps(_mm256_mul_ps(ydir, overlap), two);
+
+		__m256 vxa = _mm256_i32gather_ps(vx, ia, 4), vya = _mm256_i32gather_ps(vy, ia, 4);
+		__m256 vxb = _mm256_i32gather_ps(vx, ib, 4), vyb = _mm256_i32gather_ps(vy, ib, 4);
+		__m256 ma = _mm256_i32gather_ps(mass, ia, 4), mb = _mm256_i32gather_ps(mass, ib, 4);
+		__m256 v1n = _mm256_add_ps(_mm256_mul_ps(vxa, xdir), _mm256_mul_ps(vya, ydir));
+		__m256 v2n = _mm256_add_ps(_mm256_mul_ps(vxb, xdir), _mm256_mul_ps(vyb, ydir));
+		__m256 msum = _mm256_add_ps(ma, mb);
+		__m256 u1n = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(ma, mb), v1n), _mm256_mul_ps(_mm256_mul_ps(two, mb), v2n)), msum);
+		__m256 u2n = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(mb, ma), v2n), _mm256_mul_ps(_mm256_mul_ps(two, ma), v1n)), msum);
+		__m256 d1 = _mm256_sub_ps(u1n, v1n), d2n = _mm256_sub_ps(u2n, v2n);
+
+		_mm256_store_ps(o[0], _mm256_add_ps(pxa, sepx));
+		_mm256_store_ps(o[1], _mm256_add_ps(pya, sepy));
+		_mm256_store_ps(o[2], _mm256_sub_ps(pxb, sepx));
+		_mm256_store_ps(o[3], _mm256_sub_ps(pyb, sepy));
+		_mm256_store_ps(o[4], _mm256_add_ps(vxa, _mm256_mul_ps(d1, xdir)));
+		_mm256_store_ps(o[5], _mm256_add_ps(vya, _mm256_mul_ps(d1, ydir)));
+		_mm256_store_ps(o[6], _mm256_add_ps(vxb, _mm256_mul_ps(d2n, xdir)));
+		_mm256_store_ps(o[7], _mm256_add_ps(vyb, _mm256_mul_ps(d2n, ydir)));
+		narrow_scatter(w, c, 8, mask, o[0], o[1], o[2], o[3], o[4], o[5], o[6], o[7]);
+		hits += __builtin_popcount(mask);
+	}
+	return hits + resolve_sse(w, c, n - i);
+}
+
+#endif
+
+/* every path this cpu can run, best first */
+inline std::vector<narrow_kernels> narrow_available(){
+	std::vector<narrow_kernels> k;
+#ifdef NARROW_X86
+	if(__builtin_cpu_supports("avx2")) k.push_back({"avx2", 8, overlap_avx2, resolve_avx2});
+	k.push_back({"sse", 4, overlap_sse, resolve_sse});
+#endif
+	k.push_back({"scalar", 1, overlap_scalar, resolve_scalar});
+	return k;
+}
+
+/* picks a path by name (avx2, sse, scalar), falling back to the best one */
+inline narrow_kernels narrow_select(const char* name = nullptr){
+	std::vector<narrow_kernels> k = narrow_available();
+	if(name){
+		for(const narrow_kernels& n : k){
+			if(std::strcmp(n.name, name) == 0) return n;
+		}
+	}
+	return k[0];
+}
+
+#endif
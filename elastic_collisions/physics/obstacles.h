@@ -0,0 +1,369 @@
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include "world.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <cfloat>
+
+/* static line segments the balls bounce off, next to the window walls in
+ * checkColision(). a convex polygon is stored as its edges, which are
+ * segments like any other, and as a solid: a ball fast enough to get its
+ * center past an edge in one step is pushed back out through the edge it
+ * went in the least, instead of bouncing around inside or leaving through
+ * the far side.
+ *
+ * the segments are indexed by a bounding volume hierarchy built once with
+ * the surface area heuristic (in 2d the half perimeter of the boxes), so a
+ * ball only looks at the handful of segments near it no matter how many
+ * there are */
+struct segment{
+	float x0, y0, x1, y1;
+	int poly; /* polygon the segment is an edge of, -1 for a lone segment */
+};
+
+struct bvh_node{
+	float x0, y0, x1, y1;
+	int first; /* leaf: first segment, inner: index of the left child, the right one follows it */
+	int count; /* segments in a leaf, 0 for an inner node */
+};
+
+struct obstacle_set{
+	std::vector<segment> segments; /* in the order of the bvh leaves once built */
+	std::vector<bvh_node> nodes;
+	/* the segments again as start, direction and 1/|direction|^2 for the query */
+	std::vector<float> sx, sy, dx, dy, inv_len2;
+	/* the polygons counter clockwise, polygon p is the x y pairs from
+	 * poly_first[p] to poly_first[p + 1] */
+	std::vector<float> poly_xy;
+	std::vector<int> poly_first = {0};
+	/* no point inside a polygon is further than this from its nearest
+	 * edge, so a query this wide around a center finds that edge */
+	float reach = 0;
+	int hits = 0; /* ball-segment contacts in the last collide() */
+	int max_leaf = 4;
+	static const int MAX_DEPTH = 48;
+
+	bool empty() const{
+		return segments.empty();
+	}
+
+	int polygons() const{
+		return (int)poly_first.size() - 1;
+	}
+
+	void add_segment(float x0, float y0, float x1, float y1, int poly = -1){
+		segments.push_back({x0, y0, x1, y1, poly});
+	}
+
+	/* x y pairs of a convex polygon in either winding */
+	void add_polygon(const std::vector<float>& xy){
+		int n = (int)xy.size() / 2;
+		if(n < 3) return;
+		float area = 0;
+		for(int i=0;i<n;i++){
+			int j = (i + 1) % n;
+			area += xy[2*i]*xy[2*j + 1] - xy[2*j]*xy[2*i + 1];
+		}
+		if(area == 0) return;
+		int p = polygons();
+		for(int k=0;k<n;k++){
+			int i = area > 0 ? k : n - 1 - k;
+			poly_xy.push_back(xy[2*i]);
+			poly_xy.push_back(xy[2*i + 1]);
+		}
+		poly_first.push_back((int)poly_xy.size());
+		const float* v = &poly_xy[poly_first[p]];
+		for(int i=0;i<n;i++){
+			int j = (i + 1) % n;
+			add_segment(v[2*i], v[2*i + 1], v[2*j], v[2*j + 1], p);
+		}
+	}
+
+	static float half_perimeter(float x0, float y0, float x1, float y1){
+		return (x1 - x0) + (y1 - y0);
+	}
+
+	void build(){
+		nodes.clear();
+		if(segments.empty()) return;
+		std::vector<int> order(segments.size());
+		for(int i=0;i<(int)order.size();i++) order[i] = i;
+		nodes.push_back({});
+		build_node(0, order, 0, (int)order.size(), 0);
+
+		std::vector<segment> sorted(segments.size());
+		for(int i=0;i<(int)order.size();i++) sorted[i] = segments[order[i]];
+		segments.swap(sorted);
+		prepare();
+	}
+
+	/* the query arrays from segments, also used when a recording restores
+	 * the segments and nodes as they were */
+	void prepare(){
+		int n = (int)segments.size();
+		sx.resize(n); sy.resize(n); dx.resize(n); dy.resize(n); inv_len2.resize(n);
+		for(int i=0;i<n;i++){
+			const segment& s = segments[i];
+			sx[i] = s.x0; sy[i] = s.y0;
+			dx[i] = s.x1 - s.x0; dy[i] = s.y1 - s.y0;
+			float l2 = dx[i]*dx[i] + dy[i]*dy[i];
+			inv_len2[i] = l2 > 0 ? 1.0f / l2 : 0.0f;
+		}
+		/* the inscribed circle fits in the bounding box */
+		reach = 0;
+		for(int p=0;p<polygons();p++){
+			float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+			for(int k=poly_first[p];k<poly_first[p + 1];k+=2){
+				x0 = std::min(x0, poly_xy[k]); x1 = std::max(x1, poly_xy[k]);
+				y0 = std::min(y0, poly_xy[k + 1]); y1 = std::max(y1, poly_xy[k + 1]);
+			}
+			reach = std::max(reach, 0.5f * std::min(x1 - x0, y1 - y0));
+		}
+	}
+
+	/* binned sah: the centroids are dropped into bins along the longer axis
+	 * and the split with the smallest count * half perimeter on both sides wins.
+	 * a range is kept as a leaf when no split beats testing all of it */
+	void build_node(int n, std::vector<int>& order, int begin, int end, int depth){
+		const int BINS = 16;
+		float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+		float cx0 = FLT_MAX, cy0 = FLT_MAX, cx1 = -FLT_MAX, cy1 = -FLT_MAX;
+		for(int k=begin;k<end;k++){
+			const segment& s = segments[order[k]];
+			x0 = std::min(x0, std::min(s.x0, s.x1)); x1 = std::max(x1, std::max(s.x0, s.x1));
+			y0 = std::min(y0, std::min(s.y0, s.y1)); y1 = std::max(y1, std::max(s.y0, s.y1));
+			float cx = 0.5f * (s.x0 + s.x1), cy = 0.5f * (s.y0 + s.y1);
+			cx0 = std::min(cx0, cx); cx1 = std::max(cx1, cx);
+			cy0 = std::min(cy0, cy); cy1 = std::max(cy1, cy);
+		}
+		nodes[n].x0 = x0; nodes[n].y0 = y0; nodes[n].x1 = x1; nodes[n].y1 = y1;
+		nodes[n].first = begin;
+		nodes[n].count = end - begin;
+		int count = end - begin;
+		/* the depth limit keeps the query stack bounded */
+		if(count <= 1 || depth >= MAX_DEPTH) return;
+
+		int axis = (cx1 - cx0) >= (cy1 - cy0) ? 0 : 1;
+		float lo = axis ? cy0 : cx0, extent = axis ? cy1 - cy0 : cx1 - cx0;
+		if(extent <= 0){
+			if(count <= max_leaf) return;
+			/* every centroid in one spot, split in the middle of the list */
+			split(n, order, begin, begin + count / 2, end, depth);
+			return;
+		}
+		auto bin_of = [&](int seg){
+			const segment& s = segments[seg];
+			float c = axis ? 0.5f * (s.y0 + s.y1) : 0.5f * (s.x0 + s.x1);
+			return std::min(BINS - 1, (int)(BINS * (c - lo) / extent));
+		};
+		struct bin{
+			int count = 0;
+			float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+		} bins[BINS];
+		for(int k=begin;k<end;k++){
+			const segment& s = segments[order[k]];
+			bin& b = bins[bin_of(order[k])];
+			b.count++;
+			b.x0 = std::min(b.x0, std::min(s.x0, s.x1)); b.x1 = std::max(b.x1, std::max(s.x0, s.x1));
+			b.y0 = std::min(b.y0, std::min(s.y0, s.y1)); b.y1 = std::max(b.y1, std::max(s.y0, s.y1));
+		}
+		/* cost of the left side for every split from the left, then sweep from the right */
+		float left_cost[BINS];
+		bin acc;
+		for(int k=0;k<BINS-1;k++){
+			acc.count += bins[k].count;
+			acc.x0 = std::min(acc.x0, bins[k].x0); acc.x1 = std::max(acc.x1, bins[k].x1);
+			acc.y0 = std::min(acc.y0, bins[k].y0); acc.y1 = std::max(acc.y1, bins[k].y1);
+			left_cost[k] = acc.count ? acc.count * half_perimeter(acc.x0, acc.y0, acc.x1, acc.y1) : 0.0f;
+		}
+		float best = FLT_MAX;
+		int best_k = -1;
+		acc = bin();
+		for(int k=BINS-1;k>0;k--){
+			acc.count += bins[k].count;
+			acc.x0 = std::min(acc.x0, bins[k].x0); acc.x1 = std::max(acc.x1, bins[k].x1);
+			acc.y0 = std::min(acc.y0, bins[k].y0); acc.y1 = std::max(acc.y1, bins[k].y1);
+			if(acc.count == 0 || acc.count == count) continue;
+			float cost = left_cost[k - 1] + acc.count * half_perimeter(acc.x0, acc.y0, acc.x1, acc.y1);
+			if(cost < best){
+				best = cost;
+				best_k = k;
+			}
+		}
+		/* an inner node costs about one extra box test per segment visited */
+		float leaf_cost = count * half_perimeter(x0, y0, x1, y1);
+		if(best_k < 0 || (count <= max_leaf && best + half_perimeter(x0, y0, x1, y1) >= leaf_cost)) return;
+		int mid = (int)(std::partition(order.begin() + begin, order.begin() + end,
+			[&](int seg){ return bin_of(seg) < best_k; }) - order.begin());
+		split(n, order, begin, mid, end, depth);
+	}
+
+	void split(int n, std::vector<int>& order, int begin, int mid, int end, int depth){
+		int left = (int)nodes.size();
+		nodes.push_back({});
+		nodes.push_back({});
+		nodes[n].first = left;
+		nodes[n].count = 0;
+		build_node(left, order, begin, mid, depth + 1);
+		build_node(left + 1, order, mid, end, depth + 1);
+	}
+
+	/* squared distance from (x, y) to segment s, and the offset from the
+	 * closest point on the segment to (x, y) */
+	float distance2(int s, float x, float y, float& ex, float& ey) const{
+		ex = x - sx[s]; ey = y - sy[s];
+		float t = (ex*dx[s] + ey*dy[s]) * inv_len2[s];
+		t = std::min(1.0f, std::max(0.0f, t));
+		ex -= t * dx[s]; ey -= t * dy[s];
+		return ex*ex + ey*ey;
+	}
+
+	/* calls f(s) for every segment in a leaf whose box overlaps the circle's
+	 * box. f may move the circle, the boxes are tested against where it is
+	 * now, which is where x, y and r point to */
+	template<class F>
+	void near(const float& x, const float& y, float r, F f) const{
+		if(nodes.empty()) return;
+		int stack[MAX_DEPTH + 2], top = 0;
+		stack[top++] = 0;
+		while(top > 0){
+			const bvh_node& nd = nodes[stack[--top]];
+			if(x + r <= nd.x0 || x - r >= nd.x1 || y + r <= nd.y0 || y - r >= nd.y1) continue;
+			if(nd.count == 0){
+				stack[top++] = nd.first + 1;
+				stack[top++] = nd.first;
+				continue;
+			}
+			for(int s=nd.first;s<nd.first+nd.count;s++) f(s);
+		}
+	}
+
+	/* how far (x, y) is inside polygon p through its shallowest edge, and
+	 * that edge's outward normal. 0 or less when the point is outside */
+	float depth(int p, float x, float y, float& nx, float& ny) const{
+		const float* v = &poly_xy[poly_first[p]];
+		int n = (poly_first[p + 1] - poly_first[p]) / 2;
+		float best = FLT_MAX;
+		nx = ny = 0.0f;
+		for(int i=0;i<n;i++){
+			int j = (i + 1) % n;
+			float ex = v[2*j] - v[2*i], ey = v[2*j + 1] - v[2*i + 1];
+			float l = std::sqrt(ex*ex + ey*ey);
+			if(l == 0) continue;
+			/* counter clockwise, so the inside is on the left of every edge */
+			float d = (ex * (y - v[2*i + 1]) - ey * (x - v[2*i])) / l;
+			if(d <= 0) return d;
+			if(d < best){
+				best = d;
+				nx = ey / l; ny = -ex / l;
+			}
+		}
+		/* no edge with a length, add_polygon() keeps those out */
+		return best == FLT_MAX ? 0.0f : best;
+	}
+
+	bool inside(int p, float x, float y) const{
+		float nx, ny;
+		return depth(p, x, y, nx, ny) > 0;
+	}
+
+	/* pushes ball i out of every segment it overlaps and reflects the part
+	 * of its velocity going into the segment, like checkColision does for
+	 * the walls. a center inside a polygon is first put back outside, the
+	 * edges would push it further in. returns the number of segments touched */
+	int collide_ball(world& w, int i) const{
+		float r = w.radius[i];
+		int touched = 0;
+		if(reach > 0){
+			near(w.px[i], w.py[i], reach, [&](int s){
+				int p = segments[s].poly;
+				if(p < 0) return;
+				float nx, ny, d = depth(p, w.px[i], w.py[i], nx, ny);
+				if(d <= 0) return;
+				w.px[i] += nx * (d + r);
+				w.py[i] += ny * (d + r);
+				float vn = w.vx[i]*nx + w.vy[i]*ny;
+				if(vn < 0){
+					w.vx[i] -= 2.0f * vn * nx;
+					w.vy[i] -= 2.0f * vn * ny;
+				}
+				touched++;
+			});
+		}
+		near(w.px[i], w.py[i], r, [&](int s){
+			float ex, ey;
+			float d2 = distance2(s, w.px[i], w.py[i], ex, ey);
+			if(d2 >= r*r) return;
+			float d = std::sqrt(d2), nx, ny;
+			if(d > 0){
+				nx = ex / d; ny = ey / d;
+			}
+			else{
+				/* center exactly on the segment, push out along its normal */
+				float l = std::sqrt(dx[s]*dx[s] + dy[s]*dy[s]);
+				if(l == 0) return;
+				nx = -dy[s] / l; ny = dx[s] / l;
+			}
+			w.px[i] += nx * (r - d);
+			w.py[i] += ny * (r - d);
+			float vn = w.vx[i]*nx + w.vy[i]*ny;
+			if(vn < 0){
+				w.vx[i] -= 2.0f * vn * nx;
+				w.vy[i] -= 2.0f * vn * ny;
+			}
+			touched++;
+		});
+		return touched;
+	}
+
+	/* every awake ball against the bvh. the segments don't move, so balls
+	 * are independent and the batch is split across the pool; each ball only
+	 * writes its own state, so the result doesn't depend on the thread count */
+	void collide(world& w, thread_pool& pool){
+		hits = 0;
+		if(nodes.empty()) return;
+		std::vector<int> per_thread(pool.size(), 0);
+		pool.parallel_for(w.size(), [&](int begin, int end, int thread){
+			int n = 0;
+			for(int i=begin;i<end;i++){
+				if(!w.alive[i] || w.asleep[i]) continue;
+				n += collide_ball(w, i);
+			}
+			per_thread[thread] += n;
+		}, 256);
+		for(int n : per_thread) hits += n;
+	}
+};
+
+/* text file, one obstacle per line, # starts a comment:
+ *   segment x0 y0 x1 y1
+ *   polygon x0 y0 x1 y1 x2 y2 ...
+ * coordinates are in window pixels with y going up, like the balls */
+inline bool load_obstacles(const char* path, obstacle_set& out){
+	std::ifstream in(path);
+	if(!in) return false;
+	std::string line;
+	while(std::getline(in, line)){
+		size_t hash = line.find('#');
+		if(hash != std::string::npos) line.erase(hash);
+		std::istringstream ls(line);
+		std::string kind;
+		if(!(ls >> kind)) continue;
+		std::vector<float> xy;
+		float v;
+		while(ls >> v) xy.push_back(v);
+		if(kind == "segment" && xy.size() == 4) out.add_segment(xy[0], xy[1], xy[2], xy[3]);
+		else if(kind == "polygon" && xy.size() >= 6 && xy.size() % 2 == 0) out.add_polygon(xy);
+		else return false;
+	}
+	out.build();
+	return true;
+}
+
+#endif
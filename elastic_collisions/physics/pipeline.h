@@ -0,0 +1,102 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+/* two stage frame pipeline: a worker thread runs one job at a time (a
+ * physics step) while the caller does something else (renders the last
+ * step). the job fills the back one of two states, and finish() waits for
+ * it and makes it the front one, so the state the caller reads is never
+ * written at the same time. between finish() and the next start() the
+ * worker is idle, which is when the caller may touch what the job uses.
+ * a frame then takes the longer of the two stages instead of their sum */
+template<class State>
+class frame_pipeline{
+public:
+	double job_ms = 0;  /* how long the last job ran */
+	double wait_ms = 0; /* how long the last finish() blocked */
+
+	frame_pipeline() : worker([this]{ worker_loop(); }){}
+
+	~frame_pipeline(){
+		{
+			std::lock_guard<std::mutex> lock(m);
+			quit = true;
+		}
+		start_cv.notify_one();
+		worker.join();
+	}
+
+	frame_pipeline(const frame_pipeline&) = delete;
+	frame_pipeline& operator=(const frame_pipeline&) = delete;
+
+	/* the state of the last finished job */
+	const State& front() const{
+		return states[current];
+	}
+
+	/* the state the next job writes, only for filling it before the
+	 * first start() */
+	State& back(){
+		return states[1 - current];
+	}
+
+	/* hands fn(back state) to the worker and returns right away */
+	void start(std::function<void(State&)> fn){
+		{
+			std::lock_guard<std::mutex> lock(m);
+			job = std::move(fn);
+			busy = true;
+		}
+		start_cv.notify_one();
+	}
+
+	/* waits for the job of the last start() and swaps the states */
+	void finish(){
+		auto t0 = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(m);
+		done_cv.wait(lock, [this]{ return !busy; });
+		wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		current = 1 - current;
+	}
+
+	/* makes back() the front without running a job */
+	void swap(){
+		current = 1 - current;
+	}
+
+private:
+	State states[2];
+	int current = 0;
+	std::mutex m;
+	std::condition_variable start_cv, done_cv;
+	std::function<void(State&)> job;
+	bool busy = false;
+	bool quit = false;
+	std::thread worker; /* last, it starts running in the constructor */
+
+	void worker_loop(){
+		for(;;){
+			std::function<void(State&)> fn;
+			{
+				std::unique_lock<std::mutex> lock(m);
+				start_cv.wait(lock, [this]{ return quit || (busy && job); });
+				if(quit) return;
+				fn = std::move(job);
+				job = nullptr;
+			}
+			auto t0 = std::chrono::steady_clock::now();
+			fn(states[1 - current]);
+			std::lock_guard<std::mutex> lock(m);
+			job_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+			busy = false;
+			done_cv.notify_one();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include "world.h"
+#include "grid.h"
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+/* loose quadtree broad phase. every node's loose bounds are twice its tight
+ * square, so a ball whose center is in the tight square and whose radius is
+ * at most half the node fits without straddling. a ball is kept in its node
+ * while its box stays inside the loose bounds, so from step to step only the
+ * few balls that left them are taken out and inserted again.
+ *
+ * unlike the grid the depth follows each ball's radius, big and small balls
+ * live on different levels and a few big balls don't make every cell big.
+ * nodes come from a pool with a free list and are given back as soon as
+ * their subtree is empty */
+struct loose_quadtree{
+	struct node{
+		float cx = 0, cy = 0, half = 0; /* tight square, the loose one has 2 * half */
+		int parent = -1;
+		int depth = 0;
+		int child[4] = {-1, -1, -1, -1};
+		int first = -1;                 /* first ball of this node, linked through next */
+	};
+	std::vector<node> nodes;            /* node 0 is the root */
+	std::vector<int> free_nodes;
+	std::vector<int> node_of, next, prev; /* per ball slot, -1 when not in the tree */
+	std::vector<int> stack;
+	int balls = -1;
+	float width = 0, height = 0;
+	int max_depth = 12;
+	int reinserted = 0;                 /* balls moved to another node by the last update */
+
+	int node_count() const{
+		return (int)nodes.size() - (int)free_nodes.size();
+	}
+
+	int new_node(int parent, float cx, float cy, float half){
+		int n;
+		if(!free_nodes.empty()){
+			n = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[n] = node();
+		}
+		else{
+			n = (int)nodes.size();
+			nodes.emplace_back();
+		}
+		nodes[n].parent = parent;
+		nodes[n].depth = parent >= 0 ? nodes[parent].depth + 1 : 0;
+		nodes[n].cx = cx; nodes[n].cy = cy; nodes[n].half = half;
+		return n;
+	}
+
+	static bool fits(const world& w, float cx, float cy, float half, int i){
+		float loose = 2.0f * half;
+		return std::abs(w.px[i] - cx) + w.radius[i] <= loose && std::abs(w.py[i] - cy) + w.radius[i] <= loose;
+	}
+	bool fits(const world& w, int n, int i) const{
+		return fits(w, nodes[n].cx, nodes[n].cy, nodes[n].half, i);
+	}
+
+	/* the root covers the window. a ball that doesn't fit anywhere stays in
+	 * the root, which every query visits */
+	void insert(const world& w, int i){
+		int n = 0, depth = 0;
+		while(depth < max_depth){
+			float h = nodes[n].half * 0.5f;
+			/* a ball would fit a child as small as its radius, stopping one
+			 * level above that gives fewer, fuller leaves and fewer reinserts */
+			if(2.0f * w.radius[i] > h) break;
+			int q = (w.px[i] >= nodes[n].cx ? 1 : 0) + (w.py[i] >= nodes[n].cy ? 2 : 0);
+			int c = nodes[n].child[q];
+			if(c < 0){
+				float cx = nodes[n].cx + ((q & 1) ? h : -h);
+				float cy = nodes[n].cy + ((q & 2) ? h : -h);
+				if(!fits(w, cx, cy, h, i)) break;
+				c = new_node(n, cx, cy, h);
+				nodes[n].child[q] = c;
+			}
+			else if(!fits(w, c, i)) break;
+			n = c;
+			depth++;
+		}
+		node_of[i] = n;
+		prev[i] = -1;
+		next[i] = nodes[n].first;
+		if(next[i] >= 0) prev[next[i]] = i;
+		nodes[n].first = i;
+	}
+
+	void remove(int i){
+		int n = node_of[i];
+		if(prev[i] >= 0) next[prev[i]] = next[i];
+		else nodes[n].first = next[i];
+		if(next[i] >= 0) prev[next[i]] = prev[i];
+		node_of[i] = next[i] = prev[i] = -1;
+		prune(n);
+	}
+
+	/* gives empty leaves back to the pool, walking up while parents empty too */
+	void prune(int n){
+		while(n > 0){
+			node& d = nodes[n];
+			if(d.first >= 0 || d.child[0] >= 0 || d.child[1] >= 0 || d.child[2] >= 0 || d.child[3] >= 0) return;
+			int p = d.parent;
+			for(int q=0;q<4;q++){
+				if(nodes[p].child[q] == n) nodes[p].child[q] = -1;
+			}
+			free_nodes.push_back(n);
+			n = p;
+		}
+	}
+
+	void rebuild(const world& w){
+		balls = w.size();
+		width = w.width; height = w.height;
+		nodes.clear();
+		free_nodes.clear();
+		float half = 0.5f * std::max(w.width, w.height);
+		new_node(-1, 0.5f * w.width, 0.5f * w.height, half);
+		node_of.assign(balls, -1);
+		next.assign(balls, -1);
+		prev.assign(balls, -1);
+		for(int i=0;i<balls;i++){
+			if(w.alive[i]) insert(w, i);
+		}
+		reinserted = 0;
+	}
+
+	/* brings the tree up to date with the current positions */
+	void update(const world& w){
+		if(balls != w.size() || width != w.width || height != w.height){
+			rebuild(w);
+			return;
+		}
+		reinserted = 0;
+		for(int i=0;i<balls;i++){
+			bool in = node_of[i] >= 0;
+			if(!w.alive[i]){
+				if(in) remove(i);
+			}
+			else if(!in){
+				insert(w, i);
+			}
+			else if(!fits(w, node_of[i], i)){
+				remove(i);
+				insert(w, i);
+				reinserted++;
+			}
+		}
+	}
+
+	/* calls f on every non empty node whose loose bounds overlap the box */
+	template<class F>
+	void visit_nodes(float x0, float y0, float x1, float y1, F f){
+		stack.clear();
+		stack.push_back(0);
+		while(!stack.empty()){
+			int n = stack.back();
+			stack.pop_back();
+			const node& d = nodes[n];
+			if(n != 0){
+				float loose = 2.0f * d.half;
+				if(x1 <= d.cx - loose || x0 >= d.cx + loose || y1 <= d.cy - loose || y0 >= d.cy + loose) continue;
+			}
+			if(d.first >= 0) f(n);
+			for(int q=3;q>=0;q--){
+				if(d.child[q] >= 0) stack.push_back(d.child[q]);
+			}
+		}
+	}
+
+	/* calls f on every ball of those nodes */
+	template<class F>
+	void visit(float x0, float y0, float x1, float y1, F f){
+		visit_nodes(x0, y0, x1, y1, [&](int n){
+			for(int b=nodes[n].first;b>=0;b=next[b]) f(b);
+		});
+	}
+
+	/* every ball pair whose boxes overlap, as a < b. a traversal over pairs
+	 * of subtrees: a node against itself, a node's balls against its own
+	 * subtrees, and two sibling subtrees against each other, which recurses
+	 * into their children. a pair of subtrees whose bounding boxes are apart
+	 * is skipped whole, and every pair of balls is tested exactly once */
+	void pairs(const world& w, std::vector<contact>& out){
+		update(w);
+		item_box.resize(nodes.size());
+		tree_box.resize(nodes.size());
+		fit(w, 0);
+		self(w, 0, out);
+	}
+
+	struct box{
+		float x0, y0, x1, y1;
+	};
+	std::vector<box> item_box; /* around the balls of each node */
+	std::vector<box> tree_box; /* around the balls of each subtree, both rebuilt by pairs() */
+
+	/* the boxes are tighter than the loose bounds, in a sparse scene far
+	 * tighter, so they prune most subtree pairs before any ball is looked at */
+	void fit(const world& w, int n){
+		box& b = item_box[n];
+		b.x0 = b.y0 = FLT_MAX; b.x1 = b.y1 = -FLT_MAX;
+		for(int i=nodes[n].first;i>=0;i=next[i]){
+			float r = w.radius[i];
+			b.x0 = std::min(b.x0, w.px[i] - r); b.x1 = std::max(b.x1, w.px[i] + r);
+			b.y0 = std::min(b.y0, w.py[i] - r); b.y1 = std::max(b.y1, w.py[i] + r);
+		}
+		box t = b;
+		for(int c : nodes[n].child){
+			if(c < 0) continue;
+			fit(w, c);
+			const box& o = tree_box[c];
+			t.x0 = std::min(t.x0, o.x0); t.x1 = std::max(t.x1, o.x1);
+			t.y0 = std::min(t.y0, o.y0); t.y1 = std::max(t.y1, o.y1);
+		}
+		tree_box[n] = t;
+	}
+
+	static bool apart(const box& a, const box& b){
+		return a.x1 <= b.x0 || b.x1 <= a.x0 || a.y1 <= b.y0 || b.y1 <= a.y0;
+	}
+
+	void test_items(const world& w, int a, int b, std::vector<contact>& out) const{
+		for(int i=nodes[a].first;i>=0;i=next[i]){
+			for(int j=nodes[b].first;j>=0;j=next[j]) uniform_grid::test(w, i, j, out);
+		}
+	}
+
+	/* the balls of a against everything in the subtree of m */
+	void down(const world& w, int a, int m, std::vector<contact>& out) const{
+		if(apart(item_box[a], tree_box[m])) return;
+		test_items(w, a, m, out);
+		for(int c : nodes[m].child){
+			if(c >= 0) down(w, a, c, out);
+		}
+	}
+
+	/* two disjoint subtrees of the same depth against each other */
+	void cross(const world& w, int a, int b, std::vector<contact>& out) const{
+		if(apart(tree_box[a], tree_box[b])) return;
+		const node& da = nodes[a];
+		const node& db = nodes[b];
+		if(da.first >= 0){
+			test_items(w, a, b, out);
+			for(int c : db.child){
+				if(c >= 0) down(w, a, c, out);
+			}
+		}
+		if(db.first >= 0){
+			for(int c : da.child){
+				if(c >= 0) down(w, b, c, out);
+			}
+		}
+		for(int ca : da.child){
+			if(ca < 0) continue;
+			for(int cb : db.child){
+				if(cb >= 0) cross(w, ca, cb, out);
+			}
+		}
+	}
+
+	/* everything inside one subtree */
+	void self(const world& w, int n, std::vector<contact>& out) const{
+		const node& d = nodes[n];
+		for(int i=d.first;i>=0;i=next[i]){
+			for(int j=next[i];j>=0;j=next[j]) uniform_grid::test(w, i, j, out);
+		}
+		for(int q=0;q<4;q++){
+			int c = d.child[q];
+			if(c < 0) continue;
+			if(d.first >= 0) down(w, n, c, out);
+			for(int r=q+1;r<4;r++){
+				if(d.child[r] >= 0) cross(w, c, d.child[r], out);
+			}
+			self(w, c, out);
+		}
+	}
+
+	/* region queries use the tree as of the last pairs() call and the
+	 * current positions. they don't update it, so querying never changes
+	 * what the next step sees */
+
+	/* balls whose box overlaps the rectangle */
+	void query(const world& w, float x0, float y0, float x1, float y1, std::vector<int>& out){
+		out.clear();
+		if(balls < 0) return;
+		visit(x0, y0, x1, y1, [&](int b){
+			if(b >= w.size() || !w.alive[b]) return;
+			float r = w.radius[b];
+			if(w.px[b] - r < x1 && w.px[b] + r > x0 && w.py[b] - r < y1 && w.py[b] + r > y0) out.push_back(b);
+		});
+	}
+
+	/* the ball under a point, the one with the nearest center if several
+	 * overlap, -1 if none */
+	int pick(const world& w, float x, float y){
+		if(balls < 0) return -1;
+		int best = -1;
+		float best_d = FLT_MAX;
+		visit(x, y, x, y, [&](int b){
+			if(b >= w.size() || !w.alive[b]) return;
+			float dx = w.px[b] - x, dy = w.py[b] - y;
+			float d = dx*dx + dy*dy;
+			if(d <= w.radius[b] * w.radius[b] && d < best_d){
+				best = b;
+				best_d = d;
+			}
+		});
+		return best;
+	}
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "session.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+/* binary recording of a session, so a slow run can be played back exactly.
+ *
+ * layout: "ECRC", version, seed, checkpoint interval, then a snapshot of the
+ * session (world arrays, free list, emitters and their rng, obstacles with
+ * their polygons and bvh as built, so the segments are visited in the same order, and
+ * the reorder interval, since it decides which slot a ball is in) and one record
+ * per step. a record starts with a flag byte saying which inputs changed
+ * since the previous step, followed by only those values, so a step where
+ * nothing happened is a single byte. every checkpoint_every steps the
+ * record also carries a hash of the world after the step, which the replay
+ * compares against to prove it is bit exact */
+enum record_flags{
+	REC_CURSOR = 1,
+	REC_SIZE = 2,
+	REC_MODES = 4,
+	REC_BALL = 8,
+	REC_CHECKPOINT = 16,
+	REC_END = 128
+};
+
+const unsigned int RECORDING_VERSION = 6;
+
+template<class T> void rec_put(std::ostream& out, const T& v){
+	out.write((const char*)&v, sizeof(T));
+}
+template<class T> void rec_put(std::ostream& out, const std::vector<T>& v){
+	unsigned int n = (unsigned int)v.size();
+	rec_put(out, n);
+	out.write((const char*)v.data(), n * sizeof(T));
+}
+template<class T> bool rec_get(std::istream& in, T& v){
+	return (bool)in.read((char*)&v, sizeof(T));
+}
+template<class T> bool rec_get(std::istream& in, std::vector<T>& v){
+	unsigned int n;
+	if(!rec_get(in, n)) return false;
+	v.resize(n);
+	return (bool)in.read((char*)v.data(), n * sizeof(T));
+}
+
+inline void write_snapshot(std::ostream& out, const session& s){
+	const world& w = s.sim.w;
+	rec_put(out, w.width); rec_put(out, w.height);
+	rec_put(out, w.sleep_enabled); rec_put(out, w.sleep_speed); rec_put(out, w.sleep_steps);
+	rec_put(out, w.capacity());
+	rec_put(out, w.px); rec_put(out, w.py);
+	rec_put(out, w.vx); rec_put(out, w.vy);
+	rec_put(out, w.radius); rec_put(out, w.mass);
+	rec_put(out, w.alive); rec_put(out, w.asleep); rec_put(out, w.still);
+	rec_put(out, w.free_slots);
+	rec_put(out, w.live); rec_put(out, w.high_water);
+
+	const emitter_system& e = s.emitters;
+	rec_put(out, e.emitters);
+	rec_put(out, e.expires);
+	rec_put(out, e.steps);
+	rec_put(out, e.spawned); rec_put(out, e.retired); rec_put(out, e.dropped);
+	std::ostringstream rng;
+	rng << e.rng;
+	std::string text = rng.str();
+	rec_put(out, std::vector<char>(text.begin(), text.end()));
+
+	rec_put(out, s.sim.obstacles.segments);
+	rec_put(out, s.sim.obstacles.nodes);
+	rec_put(out, s.sim.obstacles.poly_xy);
+	rec_put(out, s.sim.obstacles.poly_first);
+	rec_put(out, s.sim.reorder.every);
+}
+
+inline bool read_snapshot(std::istream& in, session& s){
+	world& w = s.sim.w;
+	int capacity;
+	bool ok = rec_get(in, w.width) && rec_get(in, w.height)
+		&& rec_get(in, w.sleep_enabled) && rec_get(in, w.sleep_speed) && rec_get(in, w.sleep_steps)
+		&& rec_get(in, capacity);
+	if(!ok) return false;
+	w.clear();
+	w.reserve(capacity);
+	ok = rec_get(in, w.px) && rec_get(in, w.py)
+		&& rec_get(in, w.vx) && rec_get(in, w.vy)
+		&& rec_get(in, w.radius) && rec_get(in, w.mass)
+		&& rec_get(in, w.alive) && rec_get(in, w.asleep) && rec_get(in, w.still)
+		&& rec_get(in, w.free_slots)
+		&& rec_get(in, w.live) && rec_get(in, w.high_water);
+	if(!ok) return false;
+	/* generations only matter against the broad phase, which is reset below */
+	w.generation.assign(w.px.size(), 0);
+
+	emitter_system& e = s.emitters;
+	std::vector<char> text;
+	ok = rec_get(in, e.emitters) && rec_get(in, e.expires) && rec_get(in, e.steps)
+		&& rec_get(in, e.spawned) && rec_get(in, e.retired) && rec_get(in, e.dropped)
+		&& rec_get(in, text);
+	if(!ok) return false;
+	std::istringstream rng(std::string(text.begin(), text.end()));
+	rng >> e.rng;
+
+	obstacle_set& o = s.sim.obstacles;
+	if(!rec_get(in, o.segments) || !rec_get(in, o.nodes)
+		|| !rec_get(in, o.poly_xy) || !rec_get(in, o.poly_first)) return false;
+	if(!rec_get(in, s.sim.reorder.every)) return false;
+	o.prepare();
+	s.sim.reset();
+	return true;
+}
+
+struct recording_writer{
+	std::ofstream out;
+	frame_input last;
+	long long frames = 0;
+	int checkpoint_every = 60;
+
+	/* starts a recording of s as it is now. the broad phase and the warm
+	 * start are reset so the live run and the replay start from the same place */
+	bool open(const std::string& path, session& s, unsigned seed){
+		out.open(path, std::ios::binary | std::ios::trunc);
+		if(!out) return false;
+		out.write("ECRC", 4);
+		rec_put(out, RECORDING_VERSION);
+		rec_put(out, seed);
+		rec_put(out, checkpoint_every);
+		write_snapshot(out, s);
+		s.sim.reset();
+		last = frame_input();
+		last.width = -1; /* forces the first record to carry every input */
+		frames = 0;
+		return true;
+	}
+
+	bool is_open() const{
+		return out.is_open();
+	}
+
+	/* call after s.step(in) */
+	void frame(const frame_input& in, const session& s){
+		unsigned char flags = 0;
+		bool first = last.width < 0;
+		if(first || in.mx != last.mx || in.my != last.my) flags |= REC_CURSOR;
+		if(first || in.width != last.width || in.height != last.height) flags |= REC_SIZE;
+		if(first || in.gravity_mode != last.gravity_mode || in.broad_mode != last.broad_mode
+				|| in.sleep_mode != last.sleep_mode || in.emit_mode != last.emit_mode
+				|| in.solver_mode != last.solver_mode) flags |= REC_MODES;
+		if(in.cball) flags |= REC_BALL;
+		frames++;
+		if(frames % checkpoint_every == 0) flags |= REC_CHECKPOINT;
+
+		rec_put(out, flags);
+		if(flags & REC_CURSOR){ rec_put(out, in.mx); rec_put(out, in.my); }
+		if(flags & REC_SIZE){ rec_put(out, in.width); rec_put(out, in.height); }
+		if(flags & REC_MODES){
+			rec_put(out, in.gravity_mode); rec_put(out, in.broad_mode);
+			rec_put(out, in.sleep_mode); rec_put(out, in.emit_mode);
+			rec_put(out, in.solver_mode);
+		}
+		if(flags & REC_CHECKPOINT) rec_put(out, hash_world(s.sim.w));
+		last = in;
+	}
+
+	/* the end record carries the final hash */
+	void close(const session& s){
+		if(!out.is_open()) return;
+		unsigned char flags = REC_END;
+		rec_put(out, flags);
+		rec_put(out, frames);
+		rec_put(out, hash_world(s.sim.w));
+		out.close();
+	}
+};
+
+struct recording_reader{
+	std::ifstream in;
+	unsigned int seed = 0;
+	int checkpoint_every = 0;
+	frame_input cur;
+	long long frames = 0;
+	bool has_hash = false;            /* the last record carried a hash */
+	unsigned long long hash = 0;
+	bool ended = false;
+	long long total_frames = -1;      /* from the end record */
+
+	/* reads the header and restores the snapshot into s */
+	bool open(const std::string& path, session& s){
+		in.open(path, std::ios::binary);
+		if(!in) return false;
+		char magic[4];
+		unsigned int version;
+		if(!in.read(magic, 4) || std::string(magic, 4) != "ECRC") return false;
+		if(!rec_get(in, version) || version != RECORDING_VERSION) return false;
+		if(!rec_get(in, seed) || !rec_get(in, checkpoint_every)) return false;
+		return read_snapshot(in, s);
+	}
+
+	/* inputs of the next step, false at the end of the recording. a hash in
+	 * the end record is left in hash/has_hash for the final check */
+	bool next(frame_input& out){
+		has_hash = false;
+		unsigned char flags;
+		if(ended || !rec_get(in, flags)) return false;
+		if(flags & REC_END){
+			ended = true;
+			has_hash = rec_get(in, total_frames) && rec_get(in, hash);
+			return false;
+		}
+		if(flags & REC_CURSOR){ rec_get(in, cur.mx); rec_get(in, cur.my); }
+		if(flags & REC_SIZE){ rec_get(in, cur.width); rec_get(in, cur.height); }
+		if(flags & REC_MODES){
+			rec_get(in, cur.gravity_mode); rec_get(in, cur.broad_mode);
+			rec_get(in, cur.sleep_mode); rec_get(in, cur.emit_mode);
+			rec_get(in, cur.solver_mode);
+		}
+		cur.cball = (flags & REC_BALL) ? 1 : 0;
+		if(flags & REC_CHECKPOINT) has_hash = rec_get(in, hash);
+		frames++;
+		out = cur;
+		return (bool)in;
+	}
+};
+
+/* frame times of a replay, in milliseconds */
+struct frame_time_stats{
+	std::vector<double> ms;
+
+	void add(double t){
+		ms.push_back(t);
+	}
+
+	void report(std::ostream& out){
+		if(ms.empty()) return;
+		std::vector<double> s = ms;
+		std::sort(s.begin(), s.end());
+		double sum = 0;
+		for(double t : s) sum += t;
+		auto pct = [&](double p){ return s[std::min(s.size() - 1, (size_t)(p * s.size()))]; };
+		out << std::fixed << std::setprecision(3)
+			<< "frames " << s.size() << ", ms/frame min " << s.front() << " mean " << sum / s.size()
+			<< " p50 " << pct(0.5) << " p95 " << pct(0.95) << " p99 " << pct(0.99)
+			<< " max " << s.back() << std::endl;
+	}
+};
+
+#endif
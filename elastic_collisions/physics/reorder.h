@@ -0,0 +1,148 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "world.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+/* morton (z-order) key of a grid cell: the bits of x and y interleaved, so
+ * cells that are close in space are mostly close in the key too. cells
+ * past 65535 share the last key */
+inline unsigned morton_spread(unsigned v){
+	v = std::min(v, 0xffffu);
+	v = (v | (v << 8)) & 0x00ff00ffu;
+	v = (v | (v << 4)) & 0x0f0f0f0fu;
+	v = (v | (v << 2)) & 0x33333333u;
+	v = (v | (v << 1)) & 0x55555555u;
+	return v;
+}
+
+inline unsigned morton_key(int cx, int cy){
+	return morton_spread((unsigned)std::max(cx, 0)) | (morton_spread((unsigned)std::max(cy, 0)) << 1);
+}
+
+/* least significant digit first radix sort of (key, value) pairs, eight
+ * bits per pass. every thread counts the digits of its own chunk, the
+ * counts are summed into one offset per digit and thread, and every thread
+ * then scatters its chunk in order. that keeps the sort stable, so the
+ * result is the same for any thread count. passes stop at the highest bit
+ * any key uses */
+struct radix_sorter{
+	std::vector<unsigned> keys2;
+	std::vector<int> values2;
+	std::vector<int> counts; /* 256 per thread */
+
+	void sort(std::vector<unsigned>& keys, std::vector<int>& values, thread_pool& pool){
+		int n = (int)keys.size();
+		unsigned top = 0;
+		for(unsigned k : keys) top |= k;
+		keys2.resize(n);
+		values2.resize(n);
+		const int grain = 4096;
+		for(int shift=0;shift<32 && (top >> shift) != 0;shift+=8){
+			counts.assign(256 * pool.size(), 0);
+			pool.parallel_for(n, [&](int begin, int end, int t){
+				int* c = &counts[256 * t];
+				for(int i=begin;i<end;i++) c[(keys[i] >> shift) & 255]++;
+			}, grain);
+			int sum = 0;
+			for(int d=0;d<256;d++){
+				for(int t=0;t<pool.size();t++){
+					int c = counts[256 * t + d];
+					counts[256 * t + d] = sum;
+					sum += c;
+				}
+			}
+			pool.parallel_for(n, [&](int begin, int end, int t){
+				int* c = &counts[256 * t];
+				for(int i=begin;i<end;i++){
+					int at = c[(keys[i] >> shift) & 255]++;
+					keys2[at] = keys[i];
+					values2[at] = values[i];
+				}
+			}, grain);
+			keys.swap(keys2);
+			values.swap(values2);
+		}
+	}
+};
+
+/* sorts the world's slots by the morton key of their grid cell, so balls
+ * that are close in space are close in memory and the neighbor lookups of
+ * the broad phase, the narrow phase and the fluid stay in cache. motion
+ * scatters them again, so this runs every few hundred steps.
+ *
+ * retired slots sort after all live ones and the free list is renamed, so
+ * add() hands out the same slots in the same order as before. anything
+ * else that keeps a slot index across steps has to go through where (old
+ * slot to new slot), or through remap() for a per slot array, in the step
+ * that set moved. the slots are copied back into the same vectors, so the
+ * pool doesn't reallocate */
+struct world_reorder{
+	int every = 250;            /* steps between reorders, 0 turns it off */
+	bool moved = false;         /* the last step reordered the slots */
+	std::vector<unsigned> keys;
+	std::vector<int> order;     /* new slot -> old slot */
+	std::vector<int> where;     /* old slot -> new slot */
+	radix_sorter sorter;
+	std::vector<float> fscratch;
+	std::vector<int> iscratch;
+	std::vector<unsigned char> bscratch;
+	std::vector<unsigned int> uscratch;
+
+	/* the same cells as the uniform grid, two of the biggest radius wide */
+	void apply(world& w, thread_pool& pool){
+		int n = w.size();
+		float rmax = 1.0f;
+		for(int i=0;i<n;i++){
+			if(w.alive[i]) rmax = std::max(rmax, w.radius[i]);
+		}
+		float inv_cell = 1.0f / (2.0f * rmax);
+		keys.resize(n);
+		order.resize(n);
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				keys[i] = w.alive[i] ? morton_key((int)(w.px[i] * inv_cell), (int)(w.py[i] * inv_cell)) : 0xffffffffu;
+				order[i] = i;
+			}
+		}, 4096);
+		sorter.sort(keys, order, pool);
+
+		where.resize(n);
+		for(int i=0;i<n;i++) where[order[i]] = i;
+		gather(w.px, fscratch, pool); gather(w.py, fscratch, pool);
+		gather(w.vx, fscratch, pool); gather(w.vy, fscratch, pool);
+		gather(w.radius, fscratch, pool); gather(w.mass, fscratch, pool);
+		gather(w.alive, bscratch, pool); gather(w.asleep, bscratch, pool);
+		gather(w.generation, uscratch, pool);
+		gather(w.still, iscratch, pool);
+		for(int& f : w.free_slots) f = where[f];
+		moved = true;
+	}
+
+	/* v[new] = v[old] for the slots of the last apply(), in place. a per
+	 * slot array that is longer than the world (sized to the pool) keeps
+	 * its tail, a shorter one is grown first */
+	template<class T>
+	void remap(std::vector<T>& v) const{
+		int n = (int)order.size();
+		if((int)v.size() < n) v.resize(n);
+		std::vector<T> old(v.begin(), v.begin() + n);
+		for(int i=0;i<n;i++) v[i] = old[order[i]];
+	}
+
+private:
+	template<class T>
+	void gather(std::vector<T>& v, std::vector<T>& scratch, thread_pool& pool){
+		int n = (int)order.size();
+		scratch.resize(n);
+		pool.parallel_for(n, [&](int begin, int end, int){
+			for(int i=begin;i<end;i++) scratch[i] = v[order[i]];
+		}, 4096);
+		std::memcpy(v.data(), scratch.data(), n * sizeof(T));
+	}
+};
+
+#endif
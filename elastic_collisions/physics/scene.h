@@ -0,0 +1,60 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "world.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+/* procedural scenes for the headless runs and the benchmarks. the same
+ * parameters and seed always give the same scene */
+struct scene_params{
+	int balls = 10000;
+	float radius_min = 4.0f;
+	float radius_max = 4.0f;
+	bool log_radius = true;   /* log uniform radii, otherwise uniform */
+	float density = 0.04f;    /* mass = density * radius^2, so 2.0 at radius ~7 */
+	float mass_jitter = 0.0f; /* mass is scaled by a uniform factor in [1 - j, 1 + j] */
+	float speed = 2.0f;       /* initial velocity components are uniform in [-speed, speed] */
+	float fill = 0.3f;        /* fraction of the box covered by balls, used when width is 0 */
+	float width = 0.0f, height = 0.0f;
+	unsigned seed = 1234;
+};
+
+inline void generate_scene(world& w, const scene_params& p){
+	std::mt19937 rng(p.seed);
+	std::uniform_real_distribution<float> u(0.0f, 1.0f);
+	w.clear();
+
+	std::vector<float> radii(p.balls);
+	double area = 0;
+	for(int i=0;i<p.balls;i++){
+		float t = u(rng);
+		if(p.log_radius) radii[i] = p.radius_min * std::pow(p.radius_max / p.radius_min, t);
+		else radii[i] = p.radius_min + (p.radius_max - p.radius_min) * t;
+		area += M_PI * radii[i] * radii[i];
+	}
+	if(p.width > 0.0f){
+		w.width = p.width;
+		w.height = p.height > 0.0f ? p.height : p.width;
+	}
+	else{
+		/* square box that the balls cover by the requested fraction */
+		w.width = w.height = (float)std::sqrt(area / p.fill);
+		w.width = std::max(w.width, 4.0f * p.radius_max);
+		w.height = w.width;
+	}
+
+	for(int i=0;i<p.balls;i++){
+		float r = radii[i];
+		float x = r + u(rng) * std::max(0.0f, w.width - 2 * r);
+		float y = r + u(rng) * std::max(0.0f, w.height - 2 * r);
+		float m = p.density * r * r * (1.0f + p.mass_jitter * (2.0f * u(rng) - 1.0f));
+		int b = w.add(x, y, r, m);
+		w.vx[b] = p.speed * (2.0f * u(rng) - 1.0f);
+		w.vy[b] = p.speed * (2.0f * u(rng) - 1.0f);
+	}
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "world.h"
+#include "simulation.h"
+#include "emitter.h"
+#include <cmath>
+
+/* everything the user can do to the simulation in one frame. the window
+ * fills it from glfw, a replay fills it from a recording */
+struct frame_input{
+	float mx = 0, my = 0;       /* cursor in world coordinates */
+	int width = 1354, height = 724;
+	unsigned char cball = 0;    /* enter was pressed: add a ball at the cursor */
+	unsigned char gravity_mode = 0;
+	unsigned char broad_mode = BROAD_GRID;
+	unsigned char sleep_mode = 1;
+	unsigned char emit_mode = 0; /* 0 off, 1 point (at the cursor), 2 line, 3 area */
+	unsigned char solver_mode = SOLVER_IMPULSE;
+};
+
+/* the state of the elastic collision window that is not drawing: the
+ * simulation and the emitters. step() is the only thing that changes it,
+ * so feeding the same inputs to the same starting state gives the same
+ * result bit for bit */
+struct session{
+	simulation sim;
+	emitter_system emitters;
+
+	explicit session(int threads = 0) : sim(threads){}
+
+	void setup(int width, int height, unsigned seed, int capacity = 8192){
+		world& w = sim.w;
+		w.clear();
+		w.width = width; w.height = height;
+		emitters = emitter_system(seed);
+		emitters.reserve(w, capacity);
+		emitters.emitters.resize(3);
+		emitters.emitters[EMIT_POINT].shape = EMIT_POINT;
+		emitters.emitters[EMIT_LINE].shape = EMIT_LINE;
+		emitters.emitters[EMIT_LINE].spread = 0.1f;
+		emitters.emitters[EMIT_AREA].shape = EMIT_AREA;
+		emitters.emitters[EMIT_AREA].rate = 4.0f;
+		emitters.emitters[EMIT_AREA].speed = 1.0f;
+		emitters.emitters[EMIT_AREA].spread = M_PI;
+
+		float r = 20.0f;
+		float centerx = width / 2.0f, centery = height / 2.0f;
+		w.add(centerx, height - r);
+		w.add(centerx, centery);
+		w.add(width - r, height - r);
+		w.add(r, height - r);
+	}
+
+	void step(const frame_input& in){
+		world& w = sim.w;
+		w.width = in.width; w.height = in.height;
+		w.sleep_enabled = in.sleep_mode;
+		if(!in.sleep_mode){
+			for(int i=0;i<w.size();i++) wake(w, i);
+		}
+		if(in.cball) emitters.place(w, in.mx, in.my);
+
+		emitter& point = emitters.emitters[EMIT_POINT];
+		point.x0 = in.mx; point.y0 = in.my;
+		emitter& line = emitters.emitters[EMIT_LINE];
+		line.x0 = 0.1f * in.width; line.x1 = 0.9f * in.width;
+		line.y0 = line.y1 = in.height - 30.0f;
+		emitter& area = emitters.emitters[EMIT_AREA];
+		area.x0 = 0.25f * in.width; area.x1 = 0.75f * in.width;
+		area.y0 = 0.25f * in.height; area.y1 = 0.75f * in.height;
+		for(int e=0;e<3;e++) emitters.emitters[e].active = (in.emit_mode == e + 1);
+		emitters.update(w);
+
+		sim.broad.kind = in.broad_mode;
+		sim.solver_kind = in.solver_mode;
+		sim.step(in.gravity_mode, in.mx, in.my);
+		if(sim.reorder.moved) sim.reorder.remap(emitters.expires);
+	}
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "world.h"
+#include "broad_phase.h"
+#include "solver.h"
+#include "thread_pool.h"
+#include "obstacles.h"
+#include "xpbd.h"
+#include "sph.h"
+#include "reorder.h"
+#include <vector>
+
+/* counters of the last step */
+struct step_stats{
+	int pair_tests = 0; /* candidates handed from the broad phase to the narrow phase */
+	int contacts = 0;   /* contacts that were touching when resolved */
+	int skipped = 0;    /* contacts dropped because their island was asleep */
+	int obstacle_hits = 0;
+	int awake = 0;
+};
+
+enum solver_kind{
+	SOLVER_IMPULSE = 0, /* one impulse per contact and step */
+	SOLVER_XPBD,        /* iterated position projection, see xpbd.h */
+	SOLVER_SPH,         /* the balls are a fluid, see sph.h */
+	SOLVER_COUNT
+};
+
+inline const char* solver_kind_name(int kind){
+	static const char* names[SOLVER_COUNT] = {"impulse", "xpbd", "sph"};
+	return (kind >= 0 && kind < SOLVER_COUNT) ? names[kind] : "?";
+}
+
+/* the whole physics step the window runs every frame, without any GL, so it
+ * can also run headless. mode is the same as in integrate() */
+struct simulation{
+	world w;
+	thread_pool pool;
+	broad_phase broad;
+	contact_solver solver;
+	xpbd_solver xpbd;
+	sph_fluid fluid;
+	world_reorder reorder;
+	long long steps = 0; /* since the last reset, times the reorders */
+	int solver_kind = SOLVER_IMPULSE;
+	obstacle_set obstacles;
+	std::vector<contact> candidates;
+	step_stats stats;
+
+	explicit simulation(int threads = 0) : pool(threads){}
+
+	void step(int mode, float mx, float my){
+		/* keeps neighbors close in memory. the contacts remembered for the
+		 * warm start are renamed, the broad phase starts over */
+		reorder.moved = false;
+		if(reorder.every > 0 && ++steps % reorder.every == 0){
+			reorder.apply(w, pool);
+			xpbd.remap(reorder.where);
+			broad.reset();
+		}
+		if(solver_kind == SOLVER_SPH) fluid.begin(w);
+		for(int i=0;i<w.size();i++) integrate(w, i, mode, mx, my);
+		if(solver_kind == SOLVER_SPH){
+			for(int i=0;i<w.size();i++) update_sleep(w, i);
+			/* the fluid finds its own neighbors, the broad phase is idle */
+			stats.contacts = fluid.relax(w, pool);
+			stats.pair_tests = (int)fluid.candidates;
+			stats.skipped = 0;
+			obstacles.collide(w, pool);
+			stats.obstacle_hits = obstacles.hits;
+			stats.awake = w.awake_count();
+			return;
+		}
+		broad.pairs(w, candidates);
+		solver.build(w, candidates);
+		stats.pair_tests = (int)candidates.size();
+		if(solver_kind == SOLVER_XPBD) stats.contacts = xpbd.solve(w, solver, pool, mode == 0);
+		else stats.contacts = solver.solve(w, pool);
+		/* last, like for the fluid, so the contacts can't leave a ball inside
+		 * a polygon at the end of the step */
+		obstacles.collide(w, pool);
+		solver.islands.settle(w);
+		stats.skipped = solver.islands.skipped;
+		stats.obstacle_hits = obstacles.hits;
+		stats.awake = w.awake_count();
+	}
+
+	/* drops what is carried from step to step besides the world, so a run
+	 * started from here only depends on the world and the inputs */
+	void reset(){
+		broad.reset();
+		xpbd.reset();
+		steps = 0;
+	}
+};
+
+/* conserved quantities, to measure how far the solver drifts */
+struct world_energy{
+	double kinetic = 0;
+	double potential = 0; /* from gravity, measured from the floor */
+	double px = 0, py = 0; /* momentum */
+	double momentum_scale = 0; /* sum of m*|v|, so momentum drift can be relative */
+};
+
+inline world_energy measure(const world& w){
+	world_energy e;
+	const double g = 9.81 / 50.0; /* what movementMode adds per step in mode 0 */
+	for(int i=0;i<w.size();i++){
+		if(!w.alive[i]) continue;
+		double vx = w.vx[i], vy = w.vy[i], m = w.mass[i];
+		e.kinetic += 0.5 * m * (vx*vx + vy*vy);
+		e.potential += m * g * w.py[i];
+		e.px += m * vx;
+		e.py += m * vy;
+		e.momentum_scale += m * std::sqrt(vx*vx + vy*vy);
+	}
+	return e;
+}
+
+#endif
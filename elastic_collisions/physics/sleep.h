@@ -0,0 +1,125 @@
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include "world.h"
+#include "grid.h"
+#include <vector>
+
+/* groups the touching balls into islands with a union find over the contact
+ * list and puts them to sleep and wakes them as a whole.
+ *
+ * an island falls asleep when every ball in it has been slower than
+ * sleep_speed for sleep_steps steps, at the end of the step. a sleeping
+ * island's contacts are dropped. when awake balls touch a sleeping island
+ * (something landed on a pile) the sleeping balls take part in the solve,
+ * but keep their place unless the contacts give one of them more than
+ * sleep_speed, or the awake ball that touches it is new or moving, in
+ * which case the whole island wakes. a ball resting on a sleeping pile
+ * therefore doesn't wake it, and its island sleeps once it is quiet too */
+struct island_filter{
+	struct held_ball{
+		int i;
+		float px, py;
+	};
+	std::vector<int> parent;
+	std::vector<unsigned char> island_awake, island_wake, island_quiet, is_held;
+	std::vector<held_ball> held; /* sleeping balls touched by awake ones this step */
+	int skipped = 0; /* contacts dropped by the last filter */
+
+	int find(int i){
+		while(parent[i] != i){
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+
+	/* before the solve: drops the contacts of sleeping islands and between
+	 * two sleeping balls, and wakes the islands a new or moving ball touches */
+	void filter(world& w, std::vector<contact>& contacts){
+		skipped = 0;
+		held.clear();
+		if(!w.sleep_enabled) return;
+		int n = w.size();
+		parent.resize(n);
+		for(int i=0;i<n;i++) parent[i] = i;
+		for(const contact& c : contacts){
+			int a = find(c.a), b = find(c.b);
+			/* the smaller root wins so the islands do not depend on the contact order */
+			if(a < b) parent[b] = a;
+			else if(b < a) parent[a] = b;
+		}
+		island_awake.assign(n, 0);
+		island_wake.assign(n, 0);
+		is_held.assign(n, 0);
+		for(const contact& c : contacts){
+			bool sa = w.asleep[c.a], sb = w.asleep[c.b];
+			if(sa && sb) continue;
+			int root = find(c.a);
+			island_awake[root] = 1;
+			/* still is 0 for a ball added since the last step and for one
+			 * that was fast at the end of it */
+			if((sa && w.still[c.b] == 0) || (sb && w.still[c.a] == 0)) island_wake[root] = 1;
+		}
+		for(int i=0;i<n;i++){
+			if(w.alive[i] && w.asleep[i] && island_wake[find(i)]) wake(w, i);
+		}
+		int k = 0;
+		for(const contact& c : contacts){
+			bool sa = w.asleep[c.a], sb = w.asleep[c.b];
+			if(!island_awake[find(c.a)] || (sa && sb)){
+				skipped++;
+				continue;
+			}
+			if(sa) hold(w, c.a);
+			if(sb) hold(w, c.b);
+			contacts[k++] = c;
+		}
+		contacts.resize(k);
+	}
+
+	/* after the solve: puts the held balls back, or wakes their island if
+	 * the solve pushed one of them hard enough, counts the quiet steps of
+	 * the awake balls and puts the islands that are all quiet to sleep */
+	void settle(world& w){
+		int n = w.size();
+		if(w.sleep_enabled){
+			float limit = w.sleep_speed * w.sleep_speed;
+			for(const held_ball& h : held){
+				int i = h.i;
+				if(w.vx[i]*w.vx[i] + w.vy[i]*w.vy[i] >= limit) island_wake[find(i)] = 1;
+			}
+			for(const held_ball& h : held){
+				int i = h.i;
+				if(!w.asleep[i] || island_wake[find(i)]) continue;
+				w.px[i] = h.px; w.py[i] = h.py;
+				w.vx[i] = 0.0f; w.vy[i] = 0.0f;
+			}
+			for(int i=0;i<n;i++){
+				if(w.alive[i] && w.asleep[i] && island_wake[find(i)]) wake(w, i);
+			}
+		}
+		for(int i=0;i<n;i++){
+			if(w.alive[i] && !w.asleep[i]) count_still(w, i);
+		}
+		if(!w.sleep_enabled) return;
+		island_quiet.assign(n, 1);
+		for(int i=0;i<n;i++){
+			if(w.alive[i] && !w.asleep[i] && w.still[i] < w.sleep_steps) island_quiet[find(i)] = 0;
+		}
+		for(int i=0;i<n;i++){
+			if(!w.alive[i] || w.asleep[i] || !island_quiet[find(i)]) continue;
+			w.asleep[i] = 1;
+			w.vx[i] = 0.0f; w.vy[i] = 0.0f;
+		}
+	}
+
+private:
+	void hold(world& w, int i){
+		if(is_held[i]) return;
+		is_held[i] = 1;
+		held.push_back({i, w.px[i], w.py[i]});
+	}
+};
+
+#endif
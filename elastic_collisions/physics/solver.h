@@ -0,0 +1,74 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "world.h"
+#include "grid.h"
+#include "thread_pool.h"
+#include "narrow.h"
+#include "sleep.h"
+#include <vector>
+
+/* resolves contacts in parallel. the contact list is split into colors so
+ * that no two contacts of the same color share a ball, then each color is
+ * handed to the pool. contacts of one color touch disjoint balls, so the
+ * result does not depend on how many threads run them or in which order */
+struct contact_solver{
+	std::vector<contact> contacts;   /* sorted by color */
+	std::vector<int> color_start;    /* color k is contacts[color_start[k] .. color_start[k+1]] */
+	std::vector<int> stamp;          /* last color that used each ball */
+	std::vector<contact> pending, deferred;
+	narrow_kernels kernels = narrow_select();
+	island_filter islands;
+
+	int colors() const{
+		return (int)color_start.size() - 1;
+	}
+
+	/* keeps the broad phase candidates that really overlap, drops the ones
+	 * inside sleeping islands (waking the rest) and colors them */
+	void build(world& w, const std::vector<contact>& candidates){
+		pending.resize(candidates.size());
+		pending.resize(kernels.overlap(w, candidates.data(), (int)candidates.size(), pending.data()));
+		islands.filter(w, pending);
+		color(w.size());
+	}
+
+	/* greedy coloring of pending in order: every pass takes each remaining
+	 * contact whose balls are still free in this color and defers the rest */
+	void color(int nballs){
+		contacts.clear();
+		color_start.assign(1, 0);
+		stamp.assign(nballs, -1);
+		int k = 0;
+		while(!pending.empty()){
+			deferred.clear();
+			for(const contact& c : pending){
+				if(stamp[c.a] == k || stamp[c.b] == k){
+					deferred.push_back(c);
+					continue;
+				}
+				stamp[c.a] = k; stamp[c.b] = k;
+				contacts.push_back(c);
+			}
+			color_start.push_back((int)contacts.size());
+			pending.swap(deferred);
+			k++;
+		}
+	}
+
+	/* returns how many contacts were actually touching when resolved */
+	int solve(world& w, thread_pool& pool){
+		std::vector<int> touching(pool.size(), 0);
+		for(int k=0;k<colors();k++){
+			int first = color_start[k];
+			pool.parallel_for(color_start[k + 1] - first, [&](int begin, int end, int t){
+				touching[t] += kernels.resolve(w, contacts.data() + first + begin, end - begin);
+			});
+		}
+		int total = 0;
+		for(int h : touching) total += h;
+		return total;
+	}
+};
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef SPH_H
+#define SPH_H
+
+#include "world.h"
+#include "grid.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPH_X86 1
+#endif
+
+/* smoothed particle hydrodynamics, the balls become particles of a fluid.
+ * explicit sph (muller et al.) needs a time step far below one frame once a
+ * column of fluid a few hundred pixels high presses on the floor, so the
+ * pressure is solved the way of position based fluids (macklin and muller,
+ * 2013): the sph density of every particle is a constraint rho <= rest
+ * density, and a few iterations project the particles back to it. it stays
+ * stable at the step the balls use. every step, after integrate() has moved
+ * the particles:
+ *
+ * density pass: rho = sum m W(r) with the poly6 kernel, and the gradient of
+ * rho / rest_density - 1 with the spiky kernel. a particle that is too dense
+ * gets lambda = -C / (|grad C|^2 + eps), the pressure of the constraint.
+ *
+ * pressure pass: every pair moves apart by (lambda_i + lambda_j + s) grad W,
+ * where s is the small repulsion of the paper that keeps particles at the
+ * surface from clumping. the new velocity is the distance moved.
+ *
+ * viscosity pass: xsph, each velocity is pulled towards the W weighted mean
+ * of its neighbors.
+ *
+ * every particle only gathers what its neighbors do to it (a jacobi
+ * sweep), so a pass runs in parallel without any writes to other particles
+ * and the result doesn't depend on the thread count. the fluid ignores the
+ * ball masses, every particle weighs the same.
+ *
+ * the neighbors come from the uniform grid of the broad phase, built with
+ * cells at least h wide. the particles are copied in cell order, so the
+ * neighbors of a particle are three contiguous runs (the row below, its own
+ * row and the row above, three cells each) and the kernels stream through
+ * them eight at a time. the scalar path keeps eight partial sums the way
+ * the avx2 one keeps its lanes and neither uses fma, so both give
+ * bit-identical results */
+struct sph_arrays{
+	const float *x, *y, *vx, *vy, *lambda;
+};
+
+/* the three rows of cells around a particle, as ranges of the cell order */
+struct sph_ranges{
+	int begin[3], end[3];
+	int n = 0;
+};
+
+/* the kernels are W(r) = poly6 (h^2 - r^2)^3 and
+ * grad W(r) = -spiky (h - r)^2 r/|r|, the 2d normalizations. the sums below
+ * are written over r = x_j - x_i, the opposite of the r_i - r_j of the
+ * paper, so grad W comes out positive */
+struct sph_params{
+	float h, h2;
+	float poly6, spiky;
+	float tensile;       /* k of the surface repulsion, divided by W(0.2 h)^4 */
+};
+
+/* what the density pass sums for one particle */
+struct sph_density{
+	float rho;
+	float gx, gy; /* sum of grad W, the gradient of rho at the particle itself */
+	float g2;     /* sum of |grad W|^2, the gradient at the neighbors */
+	int count;    /* neighbors closer than h */
+};
+
+struct sph_kernels{
+	const char* name;
+	int lanes;
+	void (*density)(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, sph_density& out);
+	/* sum over neighbors of (lambda_i + lambda_j + s(r)) grad W */
+	void (*pressure)(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& dx, float& dy);
+	/* sum over neighbors of (v_j - v_i) W */
+	void (*viscosity)(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& dx, float& dy);
+};
+
+/* the order the eight lanes are added in, the same as the avx2 reduction */
+inline float sph_reduce8(const float* s){
+	float a0 = s[0] + s[4], a1 = s[1] + s[5], a2 = s[2] + s[6], a3 = s[3] + s[7];
+	return (a0 + a2) + (a1 + a3);
+}
+
+/* runs term(j, lane) over the neighbor ranges. the lane is the place of j
+ * in its block of eight, the way the avx2 path sees it */
+template<class F>
+inline void sph_each_neighbor(const sph_ranges& r, F term){
+	for(int g=0;g<r.n;g++){
+		for(int j=r.begin[g];j<r.end[g];j++) term(j, (j - r.begin[g]) & 7);
+	}
+}
+
+inline void density_scalar(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, sph_density& out){
+	float rho[8] = {0}, gx[8] = {0}, gy[8] = {0}, g2[8] = {0};
+	int count = 0;
+	float xi = a.x[i], yi = a.y[i];
+	sph_each_neighbor(r, [&](int j, int l){
+		float dx = a.x[j] - xi, dy = a.y[j] - yi;
+		float d2 = dx*dx + dy*dy;
+		if(!(d2 < k.h2)) return;
+		float w = k.h2 - d2;
+		rho[l] += k.poly6 * (w * w * w);
+		if(!(d2 > 0.0f)) return;
+		float d = std::sqrt(d2);
+		float g = k.spiky * ((k.h - d) * (k.h - d)) / d;
+		gx[l] += g * dx;
+		gy[l] += g * dy;
+		g2[l] += g * g * d2;
+		count++;
+	});
+	out.rho = sph_reduce8(rho);
+	out.gx = sph_reduce8(gx);
+	out.gy = sph_reduce8(gy);
+	out.g2 = sph_reduce8(g2);
+	out.count = count;
+}
+
+inline void pressure_scalar(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& ox, float& oy){
+	float sx[8] = {0}, sy[8] = {0};
+	float xi = a.x[i], yi = a.y[i], li = a.lambda[i];
+	sph_each_neighbor(r, [&](int j, int l){
+		float dx = a.x[j] - xi, dy = a.y[j] - yi;
+		float d2 = dx*dx + dy*dy;
+		if(!(d2 < k.h2 && d2 > 0.0f)) return;
+		float d = std::sqrt(d2);
+		float w = k.h2 - d2;
+		float w3 = w * w * w;
+		float s = k.tensile * ((w3 * w3) * (w3 * w3));
+		float m = (li + a.lambda[j] - s) * (k.spiky * ((k.h - d) * (k.h - d)) / d);
+		sx[l] += m * dx;
+		sy[l] += m * dy;
+	});
+	ox = sph_reduce8(sx);
+	oy = sph_reduce8(sy);
+}
+
+inline void viscosity_scalar(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& ox, float& oy){
+	float sx[8] = {0}, sy[8] = {0};
+	float xi = a.x[i], yi = a.y[i], vxi = a.vx[i], vyi = a.vy[i];
+	sph_each_neighbor(r, [&](int j, int l){
+		float dx = a.x[j] - xi, dy = a.y[j] - yi;
+		float d2 = dx*dx + dy*dy;
+		if(!(d2 < k.h2)) return;
+		float w = k.h2 - d2;
+		float m = k.poly6 * (w * w * w);
+		sx[l] += m * (a.vx[j] - vxi);
+		sy[l] += m * (a.vy[j] - vyi);
+	});
+	ox = sph_reduce8(sx);
+	oy = sph_reduce8(sy);
+}
+
+#ifdef SPH_X86
+
+__attribute__((target("avx2")))
+inline float sph_reduce8_avx2(__m256 v){
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+/* the neighbors eight at a time. the last block of a range is loaded with
+ * a mask, its missing lanes are left out the same as the ones farther than h */
+#define SPH_BLOCKS8(body) \
+	for(int g=0;g<r.n;g++){ \
+		for(int j=r.begin[g];j<r.end[g];j+=8){ \
+			__m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(r.end[g] - j), lane); \
+			__m256 dx = _mm256_sub_ps(_mm256_maskload_ps(a.x + j, valid), xi); \
+			__m256 dy = _mm256_sub_ps(_mm256_maskload_ps(a.y + j, valid), yi); \
+			__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)); \
+			__m256 in = _mm256_and_ps(_mm256_cmp_ps(d2, h2, _CMP_LT_OQ), _mm256_castsi256_ps(valid)); \
+			if(_mm256_testz_ps(in, in)) continue; \
+			body \
+		} \
+	}
+
+#define SPH_LANE_INDEX const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+__attribute__((target("avx2")))
+inline void density_avx2(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, sph_density& out){
+	SPH_LANE_INDEX
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 h = _mm256_set1_ps(k.h), h2 = _mm256_set1_ps(k.h2);
+	const __m256 poly6 = _mm256_set1_ps(k.poly6), spiky = _mm256_set1_ps(k.spiky);
+	const __m256 xi = _mm256_set1_ps(a.x[i]), yi = _mm256_set1_ps(a.y[i]);
+	__m256 rho = zero, gx = zero, gy = zero, g2 = zero;
+	int count = 0;
+	SPH_BLOCKS8(
+		__m256 w = _mm256_sub_ps(h2, d2);
+		rho = _mm256_add_ps(rho, _mm256_and_ps(_mm256_mul_ps(poly6, _mm256_mul_ps(_mm256_mul_ps(w, w), w)), in));
+		in = _mm256_and_ps(in, _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+		__m256 d = _mm256_sqrt_ps(d2);
+		__m256 hd = _mm256_sub_ps(h, d);
+		__m256 gr = _mm256_and_ps(_mm256_div_ps(_mm256_mul_ps(spiky, _mm256_mul_ps(hd, hd)), d), in);
+		gx = _mm256_add_ps(gx, _mm256_mul_ps(gr, dx));
+		gy = _mm256_add_ps(gy, _mm256_mul_ps(gr, dy));
+		g2 = _mm256_add_ps(g2, _mm256_mul_ps(_mm256_mul_ps(gr, gr), d2));
+		count += __builtin_popcount(_mm256_movemask_ps(in));
+	)
+	out.rho = sph_reduce8_avx2(rho);
+	out.gx = sph_reduce8_avx2(gx);
+	out.gy = sph_reduce8_avx2(gy);
+	out.g2 = sph_reduce8_avx2(g2);
+	out.count = count;
+}
+
+__attribute__((target("avx2")))
+inline void pressure_avx2(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& ox, float& oy){
+	SPH_LANE_INDEX
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 h = _mm256_set1_ps(k.h), h2 = _mm256_set1_ps(k.h2);
+	const __m256 spiky = _mm256_set1_ps(k.spiky), tensile = _mm256_set1_ps(k.tensile);
+	const __m256 xi = _mm256_set1_ps(a.x[i]), yi = _mm256_set1_ps(a.y[i]);
+	const __m256 li = _mm256_set1_ps(a.lambda[i]);
+	__m256 sx = zero, sy = zero;
+	SPH_BLOCKS8(
+		in = _mm256_and_ps(in, _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+		__m256 d = _mm256_sqrt_ps(d2);
+		__m256 w = _mm256_sub_ps(h2, d2);
+		__m256 w3 = _mm256_mul_ps(_mm256_mul_ps(w, w), w);
+		__m256 w6 = _mm256_mul_ps(w3, w3);
+		__m256 s = _mm256_mul_ps(tensile, _mm256_mul_ps(w6, w6));
+		__m256 hd = _mm256_sub_ps(h, d);
+		__m256 gr = _mm256_div_ps(_mm256_mul_ps(spiky, _mm256_mul_ps(hd, hd)), d);
+		__m256 m = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(li, _mm256_maskload_ps(a.lambda + j, valid)), s), gr);
+		m = _mm256_and_ps(m, in);
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(m, dx));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(m, dy));
+	)
+	ox = sph_reduce8_avx2(sx);
+	oy = sph_reduce8_avx2(sy);
+}
+
+__attribute__((target("avx2")))
+inline void viscosity_avx2(const sph_arrays& a, int i, const sph_ranges& r, const sph_params& k, float& ox, float& oy){
+	SPH_LANE_INDEX
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 h2 = _mm256_set1_ps(k.h2), poly6 = _mm256_set1_ps(k.poly6);
+	const __m256 xi = _mm256_set1_ps(a.x[i]), yi = _mm256_set1_ps(a.y[i]);
+	const __m256 vxi = _mm256_set1_ps(a.vx[i]), vyi = _mm256_set1_ps(a.vy[i]);
+	__m256 sx = zero, sy = zero;
+	SPH_BLOCKS8(
+		__m256 w = _mm256_sub_ps(h2, d2);
+		__m256 m = _mm256_and_ps(_mm256_mul_ps(poly6, _mm256_mul_ps(_mm256_mul_ps(w, w), w)), in);
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(m, _mm256_sub_ps(_mm256_maskload_ps(a.vx + j, valid), vxi)));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(m, _mm256_sub_ps(_mm256_maskload_ps(a.vy + j, valid), vyi)));
+	)
+	ox = sph_reduce8_avx2(sx);
+	oy = sph_reduce8_avx2(sy);
+}
+
+#undef SPH_BLOCKS8
+#undef SPH_LANE_INDEX
+
+#endif
+
+/* every path this cpu can run, best first */
+inline std::vector<sph_kernels> sph_available(){
+	std::vector<sph_kernels> k;
+#ifdef SPH_X86
+	if(__builtin_cpu_supports("avx2")) k.push_back({"avx2", 8, density_avx2, pressure_avx2, viscosity_avx2});
+#endif
+	k.push_back({"scalar", 1, density_scalar, pressure_scalar, viscosity_scalar});
+	return k;
+}
+
+/* picks a path by name (avx2, scalar), falling back to the best one */
+inline sph_kernels sph_select(const char* name = nullptr){
+	std::vector<sph_kernels> k = sph_available();
+	if(name){
+		for(const sph_kernels& n : k){
+			if(std::strcmp(n.name, name) == 0) return n;
+		}
+	}
+	return k[0];
+}
+
+struct sph_fluid{
+	float smoothing = 2.0f;   /* h, in diameters of the biggest ball */
+	int iterations = 4;       /* density and pressure passes per step */
+	float relaxation = 1.0f;  /* eps of lambda, in 1 / h^2. softens the pressure of a particle with few neighbors */
+	float tensile = 0.1f;     /* k of the surface repulsion, 0 turns it off */
+	float viscosity = 0.1f;   /* c of xsph, how far a velocity moves to its neighbors' mean */
+	float push_limit = 0.1f;  /* most a particle moves in one pressure pass, in h */
+	sph_kernels kernels = sph_select();
+
+	uniform_grid grid;
+	std::vector<float> start_px, start_py; /* per ball, before integrate() */
+	std::vector<float> x, y, vx, vy;       /* per particle, in cell order */
+	std::vector<float> lambda, ox, oy;
+	std::vector<long long> found, visited; /* per thread */
+	sph_params k;
+	float rho0 = 0;                        /* rest density */
+	long long candidates = 0;              /* particles the density pass of the last step looked at */
+
+	/* density of a particle with neighbors in a hexagonal packing of spacing s */
+	static float hex_density(float s, const sph_params& k){
+		float rho = 0;
+		int n = (int)(k.h / s) + 1;
+		for(int b=-n;b<=n;b++){
+			for(int a=-n;a<=n;a++){
+				float x = s * (a + 0.5f * b), y = s * 0.8660254f * b;
+				float d2 = x*x + y*y;
+				if(d2 < k.h2) rho += k.poly6 * (k.h2 - d2) * (k.h2 - d2) * (k.h2 - d2);
+			}
+		}
+		return rho;
+	}
+
+	/* call before integrate(), the velocity after the step comes from how
+	 * far each particle moved */
+	void begin(const world& w){
+		start_px.assign(w.px.begin(), w.px.end());
+		start_py.assign(w.py.begin(), w.py.end());
+	}
+
+	sph_ranges ranges(int c) const{
+		sph_ranges r;
+		int cx = c % grid.cols, cy = c / grid.cols;
+		int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, grid.cols - 1);
+		for(int oy=std::max(cy - 1, 0);oy<=std::min(cy + 1, grid.rows - 1);oy++){
+			r.begin[r.n] = grid.cell_start[oy * grid.cols + x0];
+			r.end[r.n] = grid.cell_start[oy * grid.cols + x1 + 1];
+			r.n++;
+		}
+		return r;
+	}
+
+	/* f(j, ball, thread) for every particle j of the cell order */
+	template<class F>
+	void each_particle(thread_pool& pool, F f){
+		pool.parallel_for((int)grid.items.size(), [&](int begin, int end, int t){
+			for(int j=begin;j<end;j++) f(j, grid.items[j], t);
+		}, 512);
+	}
+
+	void set_kernel(float rmax){
+		k.h = 2.0f * rmax * smoothing;
+		k.h2 = k.h * k.h;
+		k.poly6 = 4.0f / ((float)M_PI * std::pow(k.h, 8.0f));
+		k.spiky = 30.0f / ((float)M_PI * std::pow(k.h, 5.0f));
+		rho0 = hex_density(2.0f * rmax, k);
+		/* s = k (W(r) / W(0.2 h))^4, and the constant parts of W cancel */
+		float wq = 0.96f * k.h2;
+		float wq3 = wq * wq * wq;
+		k.tensile = tensile / ((wq3 * wq3) * (wq3 * wq3));
+	}
+
+	/* the passes, after integrate(). returns the pairs closer than h */
+	int relax(world& w, thread_pool& pool){
+		float rmax = 1.0f;
+		for(int i=0;i<w.size();i++){
+			if(w.alive[i]) rmax = std::max(rmax, w.radius[i]);
+		}
+		set_kernel(rmax);
+		float eps = relaxation / k.h2;
+		float max_push = push_limit * k.h;
+
+		grid.build(w, k.h);
+		int n = (int)grid.items.size();
+		x.resize(n); y.resize(n); vx.resize(n); vy.resize(n);
+		lambda.resize(n); ox.resize(n); oy.resize(n);
+		found.assign(pool.size(), 0);
+		visited.assign(pool.size(), 0);
+		each_particle(pool, [&](int j, int i, int){
+			x[j] = w.px[i]; y[j] = w.py[i];
+		});
+		sph_arrays a = {x.data(), y.data(), vx.data(), vy.data(), lambda.data()};
+
+		/* the cells stay the ones of the positions after integrate(). a
+		 * particle the pressure pushed over a cell edge is still looked up in
+		 * its old cell, which at worst drops a pair until the next step */
+		for(int it=0;it<iterations;it++){
+			each_particle(pool, [&](int j, int i, int t){
+				sph_density d;
+				sph_ranges r = ranges(grid.cell_of[i]);
+				kernels.density(a, j, r, k, d);
+				if(it == 0){
+					found[t] += d.count;
+					for(int g=0;g<r.n;g++) visited[t] += r.end[g] - r.begin[g];
+				}
+				/* only a particle that is too dense pushes, a fluid doesn't pull */
+				float C = d.rho / rho0 - 1.0f;
+				float g2 = (d.gx*d.gx + d.gy*d.gy + d.g2) / (rho0 * rho0);
+				lambda[j] = C > 0 ? -C / (g2 + eps) : 0.0f;
+			});
+			each_particle(pool, [&](int j, int i, int){
+				kernels.pressure(a, j, ranges(grid.cell_of[i]), k, ox[j], oy[j]);
+			});
+			each_particle(pool, [&](int j, int i, int){
+				float dx = ox[j] / rho0, dy = oy[j] / rho0;
+				float d2 = dx*dx + dy*dy;
+				/* a sleeping particle only moves once it is pushed harder
+				 * than it would need to stay awake */
+				if(w.asleep[i]){
+					if(d2 < w.sleep_speed * w.sleep_speed) return;
+					wake(w, i);
+				}
+				if(d2 > max_push * max_push){
+					float f = max_push / std::sqrt(d2);
+					dx *= f; dy *= f;
+				}
+				w.px[i] += dx;
+				w.py[i] += dy;
+				fluid_walls(w, i);
+				x[j] = w.px[i]; y[j] = w.py[i];
+			});
+		}
+
+		each_particle(pool, [&](int j, int i, int){
+			if(!w.asleep[i]){
+				w.vx[i] = w.px[i] - start_px[i];
+				w.vy[i] = w.py[i] - start_py[i];
+			}
+			vx[j] = w.vx[i]; vy[j] = w.vy[i];
+		});
+		each_particle(pool, [&](int j, int i, int){
+			kernels.viscosity(a, j, ranges(grid.cell_of[i]), k, ox[j], oy[j]);
+		});
+		float c = viscosity / rho0;
+		each_particle(pool, [&](int j, int i, int){
+			if(w.asleep[i]) return;
+			w.vx[i] += c * ox[j];
+			w.vy[i] += c * oy[j];
+		});
+
+		long long pairs = 0;
+		candidates = 0;
+		for(int t=0;t<pool.size();t++){
+			pairs += found[t];
+			candidates += visited[t];
+		}
+		return (int)(pairs / 2);
+	}
+
+	/* walls only stop a particle, a fluid doesn't bounce off them */
+	static void fluid_walls(world& w, int i){
+		float r = w.radius[i];
+		w.px[i] = std::min(std::max(w.px[i], r), w.width - r);
+		w.py[i] = std::min(std::max(w.py[i], r), w.height - r);
+	}
+};
+
+#endif
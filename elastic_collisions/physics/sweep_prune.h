@@ -0,0 +1,259 @@
+#ifndef SWEEP_PRUNE_H
+#define SWEEP_PRUNE_H
+
+#include "world.h"
+#include "grid.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+
+/* incremental sweep and prune. the min and max endpoints of every ball are
+ * kept sorted on x and on y between frames and fixed up with an insertion
+ * sort, which is close to O(n) because balls only move a little each step.
+ * a swap of a min past a max (or the other way) is the only moment two boxes
+ * can start or stop overlapping, so the overlapping pairs are updated from
+ * the swaps alone instead of being searched for every frame. unlike the grid
+ * it does not care how different the radii are.
+ * a slot handed out again (a new generation) is a ball that appeared out
+ * of nowhere, often from a retired box parked past everything, and a
+ * retired ball's box jumps to that park. sorting either into place would be
+ * a swap with every ball on the way, so those slots are taken out with
+ * their pairs before the sort, and after it their endpoints are sorted
+ * among themselves and merged back in one pass per axis, and their pairs
+ * found with one sweep */
+struct sweep_prune{
+	struct endpoint{
+		float value;
+		int id; /* ball * 2, +1 for the max endpoint */
+	};
+	std::vector<endpoint> axis[2];
+	std::vector<float> lo[2], hi[2];                   /* current box of every ball */
+	std::vector<contact> overlaps;                     /* pairs whose boxes overlap */
+	std::unordered_map<unsigned long long, int> where; /* pair key -> index in overlaps */
+	std::vector<unsigned int> seen;                    /* generation of every slot at the last update */
+	std::vector<unsigned char> seen_alive;             /* and whether it was alive */
+	std::vector<int> reborn;                           /* slots handed out again or retired */
+	std::vector<unsigned char> is_reborn;
+	std::vector<endpoint> fresh;
+	std::vector<int> active, active_reborn, slot, slot_reborn;
+	int balls = -1;
+	long long swaps = 0; /* swaps done by the last update, for profiling */
+
+	static unsigned long long key(int a, int b){
+		return ((unsigned long long)a << 32) | (unsigned int)b;
+	}
+
+	void add_pair(int a, int b){
+		if(a > b) std::swap(a, b);
+		if(where.emplace(key(a, b), (int)overlaps.size()).second) overlaps.push_back({a, b});
+	}
+
+	/* nothing happens for a pair that is not stored */
+	void remove_pair(int a, int b){
+		if(a > b) std::swap(a, b);
+		auto it = where.find(key(a, b));
+		if(it == where.end()) return;
+		int i = it->second;
+		where.erase(it);
+		if(i != (int)overlaps.size() - 1){
+			overlaps[i] = overlaps.back();
+			where[key(overlaps[i].a, overlaps[i].b)] = i;
+		}
+		overlaps.pop_back();
+	}
+
+	/* touching boxes do not overlap, the same as in the grid */
+	bool overlap_on(int ax, int a, int b) const{
+		return lo[ax][a] < hi[ax][b] && lo[ax][b] < hi[ax][a];
+	}
+
+	/* on equal values a max goes before a min, so the order of the endpoints
+	 * always says the same as overlap_on */
+	static bool before(const endpoint& l, const endpoint& r){
+		return l.value < r.value || (l.value == r.value && (l.id & 1) && !(r.id & 1));
+	}
+
+	void refresh_boxes(const world& w){
+		for(int ax=0;ax<2;ax++){
+			lo[ax].resize(w.size());
+			hi[ax].resize(w.size());
+		}
+		for(int i=0;i<w.size();i++){
+			if(!w.alive[i]){
+				/* an empty box past everything else, it overlaps nothing */
+				lo[0][i] = hi[0][i] = lo[1][i] = hi[1][i] = FLT_MAX;
+				continue;
+			}
+			lo[0][i] = w.px[i] - w.radius[i]; hi[0][i] = w.px[i] + w.radius[i];
+			lo[1][i] = w.py[i] - w.radius[i]; hi[1][i] = w.py[i] + w.radius[i];
+		}
+	}
+
+	float value_of(int ax, int id) const{
+		return (id & 1) ? hi[ax][id >> 1] : lo[ax][id >> 1];
+	}
+
+	/* full sort and sweep, used when the number of slots changed */
+	void rebuild(const world& w){
+		balls = w.size();
+		seen = w.generation;
+		seen_alive = w.alive;
+		refresh_boxes(w);
+		for(int ax=0;ax<2;ax++){
+			axis[ax].resize(2 * balls);
+			for(int i=0;i<2*balls;i++) axis[ax][i] = {value_of(ax, i), i};
+			std::sort(axis[ax].begin(), axis[ax].end(), [](const endpoint& l, const endpoint& r){
+				return before(l, r) || (!before(r, l) && l.id < r.id);
+			});
+		}
+		overlaps.clear();
+		where.clear();
+		active.clear();
+		slot.resize(balls);
+		for(const endpoint& e : axis[0]){
+			int b = e.id >> 1;
+			/* a dead slot's empty box has its max before its min */
+			if(!w.alive[b]) continue;
+			if(e.id & 1){
+				int s = slot[b];
+				active[s] = active.back();
+				slot[active[s]] = s;
+				active.pop_back();
+			}
+			else{
+				for(int o : active){
+					if(overlap_on(1, o, b)) add_pair(o, b);
+				}
+				slot[b] = (int)active.size();
+				active.push_back(b);
+			}
+		}
+	}
+
+	/* insertion sort of one axis. a swap that ends the overlap on this axis
+	 * ends the pair whatever the other axis says. a swap that starts it adds
+	 * the pair if the boxes overlap on the other axis now: on y that is
+	 * already the final box, on x the y pass that follows catches any
+	 * change. a ball that passes right over another in one step swaps both
+	 * ways in the same pass, the add and then the remove */
+	void sort_axis(int ax, int other){
+		std::vector<endpoint>& v = axis[ax];
+		for(endpoint& e : v) e.value = value_of(ax, e.id);
+		for(int i=1;i<(int)v.size();i++){
+			endpoint e = v[i];
+			int j = i - 1;
+			while(j >= 0 && before(e, v[j])){
+				const endpoint& f = v[j];
+				int a = e.id >> 1, b = f.id >> 1;
+				bool e_max = e.id & 1, f_max = f.id & 1;
+				if(!e_max && f_max){
+					/* min moved left of a max: the boxes start overlapping on this axis */
+					if(overlap_on(other, a, b)) add_pair(a, b);
+				}
+				else if(e_max && !f_max){
+					/* max moved left of a min: they separate on this axis */
+					remove_pair(a, b);
+				}
+				v[j + 1] = f;
+				j--;
+				swaps++;
+			}
+			v[j + 1] = e;
+		}
+	}
+
+	/* the endpoints and the pairs of the reborn slots */
+	void take_out(){
+		for(int ax=0;ax<2;ax++){
+			std::vector<endpoint>& v = axis[ax];
+			v.erase(std::remove_if(v.begin(), v.end(), [this](const endpoint& e){
+				return is_reborn[e.id >> 1];
+			}), v.end());
+		}
+		for(int k=(int)overlaps.size()-1;k>=0;k--){
+			contact c = overlaps[k];
+			if(is_reborn[c.a] || is_reborn[c.b]) remove_pair(c.a, c.b);
+		}
+	}
+
+	/* the reborn endpoints back into the sorted axes, then a sweep along x
+	 * that pairs every reborn box with the boxes open where it starts, and
+	 * every other box with the reborn ones open where it starts */
+	void put_in(const world& w){
+		for(int ax=0;ax<2;ax++){
+			fresh.clear();
+			for(int b : reborn){
+				fresh.push_back({value_of(ax, 2 * b), 2 * b});
+				fresh.push_back({value_of(ax, 2 * b + 1), 2 * b + 1});
+			}
+			std::sort(fresh.begin(), fresh.end(), before);
+			std::vector<endpoint>& v = axis[ax];
+			size_t kept = v.size();
+			v.insert(v.end(), fresh.begin(), fresh.end());
+			std::inplace_merge(v.begin(), v.begin() + kept, v.end(), before);
+		}
+		bool any = false;
+		for(int b : reborn) any = any || w.alive[b];
+		if(!any) return;
+		active.clear();
+		active_reborn.clear();
+		slot.resize(balls);
+		slot_reborn.resize(balls);
+		auto drop = [](std::vector<int>& list, std::vector<int>& at, int b){
+			int s = at[b];
+			list[s] = list.back();
+			at[list[s]] = s;
+			list.pop_back();
+		};
+		for(const endpoint& e : axis[0]){
+			int b = e.id >> 1;
+			if(!w.alive[b]) continue;
+			if(e.id & 1){
+				drop(active, slot, b);
+				if(is_reborn[b]) drop(active_reborn, slot_reborn, b);
+				continue;
+			}
+			for(int o : is_reborn[b] ? active : active_reborn){
+				if(overlap_on(1, o, b)) add_pair(o, b);
+			}
+			slot[b] = (int)active.size();
+			active.push_back(b);
+			if(is_reborn[b]){
+				slot_reborn[b] = (int)active_reborn.size();
+				active_reborn.push_back(b);
+			}
+		}
+	}
+
+	/* brings the overlapping pairs up to date with the current positions */
+	void update(const world& w){
+		swaps = 0;
+		if(balls != w.size()){
+			rebuild(w);
+			return;
+		}
+		refresh_boxes(w);
+		reborn.clear();
+		is_reborn.assign(balls, 0);
+		for(int i=0;i<balls;i++){
+			if(w.generation[i] != seen[i] || w.alive[i] != seen_alive[i]){
+				reborn.push_back(i);
+				is_reborn[i] = 1;
+				seen[i] = w.generation[i];
+				seen_alive[i] = w.alive[i];
+			}
+		}
+		if(!reborn.empty()) take_out();
+		sort_axis(0, 1);
+		sort_axis(1, 0);
+		if(!reborn.empty()) put_in(w);
+	}
+
+	void pairs(const world& w, std::vector<contact>& out){
+		update(w);
+		out.insert(out.end(), overlaps.begin(), overlaps.end());
+	}
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+/* fixed set of workers that split a range [0, n) into one chunk per thread.
+ * the calling thread runs chunk 0 and parallel_for only returns once every
+ * chunk is done, so consecutive calls act as a barrier between passes */
+class thread_pool{
+public:
+	explicit thread_pool(int threads = 0){
+		if(threads <= 0) threads = (int)std::thread::hardware_concurrency();
+		if(threads <= 0) threads = 1;
+		nthreads = threads;
+		for(int t=1;t<nthreads;t++){
+			workers.emplace_back([this, t]{ worker_loop(t); });
+		}
+	}
+
+	~thread_pool(){
+		{
+			std::lock_guard<std::mutex> lock(m);
+			quit = true;
+		}
+		start_cv.notify_all();
+		for(auto& th : workers) th.join();
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	int size() const{
+		return nthreads;
+	}
+
+	/* fn(begin, end, thread) is called once per non empty chunk. ranges
+	 * smaller than min_chunk per thread are run on the calling thread */
+	void parallel_for(int n, const std::function<void(int, int, int)>& fn, int min_chunk = 64){
+		if(n <= 0) return;
+		int used = nthreads;
+		if(used > 1 && n / used < min_chunk) used = n / min_chunk;
+		if(used <= 1){
+			fn(0, n, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m);
+			job = &fn;
+			job_n = n;
+			job_threads = used;
+			pending = used - 1;
+			generation++;
+		}
+		start_cv.notify_all();
+		run_chunk(0);
+		std::unique_lock<std::mutex> lock(m);
+		done_cv.wait(lock, [this]{ return pending == 0; });
+		job = nullptr;
+	}
+
+private:
+	int nthreads = 1;
+	std::vector<std::thread> workers;
+	std::mutex m;
+	std::condition_variable start_cv, done_cv;
+	const std::function<void(int, int, int)>* job = nullptr;
+	int job_n = 0;
+	int job_threads = 0;
+	int pending = 0;
+	unsigned long generation = 0;
+	bool quit = false;
+
+	void run_chunk(int t){
+		int begin = (int)((long long)job_n * t / job_threads);
+		int end = (int)((long long)job_n * (t + 1) / job_threads);
+		if(begin < end) (*job)(begin, end, t);
+	}
+
+	void worker_loop(int t){
+		unsigned long seen = 0;
+		for(;;){
+			{
+				std::unique_lock<std::mutex> lock(m);
+				start_cv.wait(lock, [&]{ return quit || generation != seen; });
+				if(quit) return;
+				seen = generation;
+				if(t >= job_threads) continue;
+			}
+			run_chunk(t);
+			std::lock_guard<std::mutex> lock(m);
+			if(--pending == 0) done_cv.notify_one();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <cmath>
+
+/* every ball lives in these parallel arrays (one slot per ball) so the
+ * collision passes can stream over them instead of chasing per ball vectors.
+ * velocity is stored in the same frame as position, in pixels per step.
+ * the arrays work as a pool: retired slots go on a free list and are handed
+ * out again by add(), and once reserve() was called adding balls does not
+ * allocate. indices of live balls only move when world_reorder sorts the
+ * slots (see reorder.h), which tells the owners of per slot data. a slot
+ * handed out again gets a new generation, so whoever keeps state per slot
+ * across steps can tell a new ball from the one that lived there before */
+struct world{
+	float width = 1354;
+	float height = 724;
+	std::vector<float> px, py;
+	std::vector<float> vx, vy;
+	std::vector<float> radius;
+	std::vector<float> mass;
+	std::vector<unsigned char> alive;
+	std::vector<unsigned int> generation;
+	std::vector<int> free_slots;
+	int live = 0;
+	int high_water = 0; /* most balls alive at the same time */
+
+	/* a ball slower than sleep_speed for sleep_steps steps in a row falls
+	 * asleep, together with every ball it touches, and is not integrated
+	 * until something wakes it */
+	std::vector<unsigned char> asleep;
+	std::vector<int> still;
+	bool sleep_enabled = true;
+	float sleep_speed = 0.5f;
+	int sleep_steps = 60;
+
+	/* number of slots in use, live or retired. loops run over slots and skip
+	 * the dead ones */
+	int size() const{
+		return (int)px.size();
+	}
+
+	int capacity() const{
+		return (int)px.capacity();
+	}
+
+	void reserve(int n){
+		px.reserve(n); py.reserve(n);
+		vx.reserve(n); vy.reserve(n);
+		radius.reserve(n);
+		mass.reserve(n);
+		alive.reserve(n);
+		generation.reserve(n);
+		asleep.reserve(n);
+		still.reserve(n);
+		free_slots.reserve(n);
+	}
+
+	int add(float x, float y, float r = 20.0f, float m = 2.0f){
+		int i;
+		if(!free_slots.empty()){
+			i = free_slots.back();
+			free_slots.pop_back();
+			px[i] = x; py[i] = y;
+			vx[i] = 0.0f; vy[i] = 0.0f;
+			radius[i] = r;
+			mass[i] = m;
+			alive[i] = 1;
+			generation[i]++;
+			asleep[i] = 0;
+			still[i] = 0;
+		}
+		else{
+			px.push_back(x); py.push_back(y);
+			vx.push_back(0.0f); vy.push_back(0.0f);
+			radius.push_back(r);
+			mass.push_back(m);
+			alive.push_back(1);
+			generation.push_back(0);
+			asleep.push_back(0);
+			still.push_back(0);
+			i = size() - 1;
+		}
+		live++;
+		if(live > high_water) high_water = live;
+		return i;
+	}
+
+	void retire(int i){
+		if(!alive[i]) return;
+		alive[i] = 0;
+		vx[i] = 0.0f; vy[i] = 0.0f;
+		free_slots.push_back(i);
+		live--;
+	}
+
+	void clear(){
+		px.clear(); py.clear();
+		vx.clear(); vy.clear();
+		radius.clear();
+		mass.clear();
+		alive.clear();
+		generation.clear();
+		free_slots.clear();
+		asleep.clear();
+		still.clear();
+		live = 0;
+		high_water = 0;
+	}
+
+	int awake_count() const{
+		int n = 0;
+		for(int i=0;i<size();i++) n += alive[i] && !asleep[i];
+		return n;
+	}
+};
+
+/* fnv-1a over the state of every slot, to check that two runs that should
+ * agree bit for bit do. recordings store it, so it must not change */
+inline unsigned long long hash_world(const world& w){
+	unsigned long long h = 1469598103934665603ull;
+	auto mix = [&](const void* data, size_t bytes){
+		const unsigned char* p = (const unsigned char*)data;
+		for(size_t i=0;i<bytes;i++) h = (h ^ p[i]) * 1099511628211ull;
+	};
+	mix(w.px.data(), w.px.size() * sizeof(float));
+	mix(w.py.data(), w.py.size() * sizeof(float));
+	mix(w.vx.data(), w.vx.size() * sizeof(float));
+	mix(w.vy.data(), w.vy.size() * sizeof(float));
+	mix(w.alive.data(), w.alive.size());
+	mix(w.asleep.data(), w.asleep.size());
+	return h;
+}
+
+/* the quiet steps only start over if the ball is fast, so a ball woken
+ * while still slow can go back to sleep with its island */
+inline void wake(world& w, int i){
+	w.asleep[i] = 0;
+	if(w.vx[i]*w.vx[i] + w.vy[i]*w.vy[i] >= w.sleep_speed*w.sleep_speed) w.still[i] = 0;
+}
+
+/* counts the steps a ball has been slow, also with sleeping turned off */
+inline void count_still(world& w, int i){
+	float v2 = w.vx[i]*w.vx[i] + w.vy[i]*w.vy[i];
+	if(v2 >= w.sleep_speed*w.sleep_speed) w.still[i] = 0;
+	else w.still[i]++;
+}
+
+/* puts a ball to sleep on its own after sleep_steps quiet steps. only for
+ * the fluid, the contact solvers put whole islands to sleep (see sleep.h) */
+inline void update_sleep(world& w, int i){
+	if(!w.alive[i] || w.asleep[i]) return;
+	count_still(w, i);
+	if(w.sleep_enabled && w.still[i] >= w.sleep_steps){
+		w.asleep[i] = 1;
+		w.vx[i] = 0.0f; w.vy[i] = 0.0f;
+	}
+}
+
+inline void updateAccel(world& w, int i, float x, float y){
+	w.vx[i] += (x / 50.0f); // the 50.0f is for scalling
+	w.vy[i] += (y / 50.0f);
+}
+
+inline void updatePos(world& w, int i){
+	w.px[i] += w.vx[i];
+	w.py[i] += w.vy[i];
+}
+
+/* bounce off the window edges */
+inline void checkColision(world& w, int i){
+	float r = w.radius[i];
+	if(w.py[i] < 0 + r){
+		w.py[i] = 0 + r;
+		w.vy[i] *= -1;
+	}
+	else if(w.py[i] > w.height - r){
+		w.py[i] = w.height - r;
+		w.vy[i] *= -1;
+	}
+	if(w.px[i] < 0 + r){
+		w.px[i] = 0 + r;
+		w.vx[i] *= -1;
+	}
+	else if(w.px[i] > w.width - r){
+		w.px[i] = w.width - r;
+		w.vx[i] *= -1;
+	}
+}
+
+inline void movementMode(world& w, int i, int mode, float xm, float ym, float x, float y){
+	if(mode == 0){
+		/* if mode is 0 (norma) then just use mouse coordinates as velocity vector values and ignore the rest */
+		updateAccel(w, i, xm, ym);
+	}
+	else if(mode == 1){
+		/* the attractor pulls every ball, sleeping or not */
+		wake(w, i);
+		float xd, yd, distance;
+		xd = xm-w.px[i];
+		yd = ym-w.py[i];
+		distance = std::sqrt(xd*xd + yd*yd);
+		if(distance == 0.0f) return;
+		float xn = xd/ distance, yn = yd/distance;
+
+		float vm = (x*x) + (y*y);
+
+		updateAccel(w, i, vm*xn, vm*yn);
+	}
+}
+
+/* resolves the overlap and the elastic impulse between balls a and b, returns
+ * false if they are not touching */
+inline bool ball_collision(world& w, int a, int b){
+	float x_distance = w.px[a] - w.px[b];
+	float y_distance = w.py[a] - w.py[b];
+	float center_distance = w.radius[a] + w.radius[b];
+	float d2 = x_distance*x_distance + y_distance*y_distance;
+	if(d2 >= center_distance*center_distance || d2 == 0.0f) return false;
+
+	float distance = std::sqrt(d2);
+	float xdirection = x_distance / distance;
+	float ydirection = y_distance / distance;
+
+	float overlap = center_distance - distance;
+	float separationX = xdirection * overlap / 2.0f;
+	float separationY = ydirection * overlap / 2.0f;
+
+	// Move balls apart to resolve overlap
+	w.px[a] += separationX;
+	w.py[a] += separationY;
+	w.px[b] -= separationX;
+	w.py[b] -= separationY;
+
+	// componente normal
+	float v1n = (w.vx[a] * xdirection) + (w.vy[a] * ydirection);
+	float v2n = (w.vx[b] * xdirection) + (w.vy[b] * ydirection);
+
+	// choque elastico, only the normal component changes so the tangential one is kept implicitly
+	float ma = w.mass[a], mb = w.mass[b];
+	float u1n = (((ma - mb)*v1n) + (2*mb*v2n)) / (ma + mb);
+	float u2n = (((mb - ma)*v2n) + (2*ma*v1n)) / (ma + mb);
+
+	w.vx[a] += (u1n - v1n) * xdirection;
+	w.vy[a] += (u1n - v1n) * ydirection;
+	w.vx[b] += (u2n - v2n) * xdirection;
+	w.vy[b] += (u2n - v2n) * ydirection;
+	return true;
+}
+
+/* one step of a single ball: gravity (mode 0), the mouse attractor at
+ * (mx, my) (mode 1) or no force at all (any other mode), then position,
+ * then walls. the velocity is updated before the position (semi implicit
+ * euler), otherwise a ball resting on the floor gains height on every
+ * bounce and never settles. sleeping balls are skipped unless the
+ * attractor is on, which wakes them. whether a ball sleeps is decided
+ * after the contacts, see update_sleep() and island_filter::settle() */
+inline void integrate(world& w, int i, int mode, float mx, float my){
+	if(!w.alive[i] || (w.asleep[i] && mode != 1)) return;
+	if(mode == 0){
+		movementMode(w, i, 0,0, -9.81, 0,0);
+	}
+	else if(mode == 1){
+		movementMode(w, i, 1, mx, my, 2,-8.2);
+	}
+	updatePos(w, i);
+	checkColision(w, i);
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef XPBD_H
+#define XPBD_H
+
+#include "world.h"
+#include "grid.h"
+#include "solver.h"
+#include "thread_pool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/* iterative contact solver in the style of xpbd, for piles. the impulse
+ * solver resolves every contact once per step, which is right for bouncing
+ * balls but a deep pile keeps sinking into itself and never comes to rest.
+ * here every step runs two iterated passes over the colored contacts, like
+ * the velocity and position solves of xpbd:
+ *
+ * the velocity pass accumulates a normal impulse per contact until the
+ * contact stops closing, or bounces back with restitution times its impact
+ * speed if it hit faster than rest_speed. the impulse is clamped at zero,
+ * so a later iteration can take back what an earlier one pushed too far.
+ * a resting pile needs about the same impulses every step, so the last
+ * step's impulses are applied up front (warm start) and the iterations
+ * only fix the difference. the balls then move by the change in velocity,
+ * since integrate() already moved them with the old one.
+ *
+ * the position pass then projects the balls apart (and out of the walls).
+ * if pushing out overlap became velocity, as in plain xpbd, the overlap a
+ * deep pile carries from step to step would throw its top layers back up,
+ * so velocity is only ever taken away: a ball that was pushed keeps none of
+ * its velocity against the push.
+ *
+ * a few iterations only carry the floor a few layers up a pile. under
+ * gravity the position pass weighs the lower ball of a contact exp(stack)
+ * times the upper one when they sit on top of each other (the mass scaling
+ * of macklin et al. for stacking), so a correction goes up the pile and
+ * not down into the floor. the velocity pass keeps the real masses, made
+ * up ones there could add energy.
+ *
+ * the contacts come colored from contact_solver::build(), each color runs
+ * in parallel and the result doesn't depend on the thread count */
+struct xpbd_solver{
+	int iterations = 8;           /* velocity iterations */
+	int position_iterations = 4;
+	float restitution = 1.0f;     /* normal velocity kept after an impact */
+	float rest_speed = 0.5f;      /* impacts slower than this don't bounce, so piles come to rest */
+	float warm = 1.0f;            /* fraction of last step's impulses applied up front */
+	float slop = 0.01f;           /* overlap left alone, so resting contacts stay found */
+	float stack = 2.0f;           /* log of the lower to upper mass ratio under gravity, 0 turns it off */
+
+	std::vector<float> impulse, bias;          /* per colored contact */
+	std::vector<float> start_vx, start_vy;     /* per ball, velocity before the solve */
+	std::vector<float> start_px, start_py;     /* per ball, position before the position pass */
+	std::vector<unsigned long long> prev_keys; /* last step's contacts, sorted */
+	std::vector<float> prev_impulse;
+	std::vector<std::pair<unsigned long long, float>> next;
+	int warm_started = 0;                      /* contacts that found last step's impulse */
+	float scale = 0;                           /* stack in a step with gravity, else 0 */
+
+	static unsigned long long key(int a, int b){
+		return ((unsigned long long)(unsigned)a << 32) | (unsigned)b;
+	}
+
+	static bool normal(const world& w, const contact& c, float& nx, float& ny, float& d){
+		float dx = w.px[c.b] - w.px[c.a], dy = w.py[c.b] - w.py[c.a];
+		d = std::sqrt(dx*dx + dy*dy);
+		if(d == 0) return false;
+		nx = dx / d; ny = dy / d;
+		return true;
+	}
+
+	/* a sleeping ball doesn't move, the island filter drops the contacts
+	 * where both are asleep */
+	static void weights(const world& w, const contact& c, float& wa, float& wb){
+		wa = w.asleep[c.a] ? 0.0f : 1.0f / w.mass[c.a];
+		wb = w.asleep[c.b] ? 0.0f : 1.0f / w.mass[c.b];
+	}
+
+	/* the same for the position pass, where the lower ball is made heavier
+	 * under gravity. ny is how much b sits above a */
+	void stacked_weights(const world& w, const contact& c, float ny, float& wa, float& wb) const{
+		weights(w, c, wa, wb);
+		if(scale > 0){
+			float k = std::exp(0.5f * scale * ny);
+			wa /= k;
+			wb *= k;
+		}
+	}
+
+	static void apply(world& w, const contact& c, float nx, float ny, float wa, float wb, float p){
+		w.vx[c.a] -= nx * wa * p; w.vy[c.a] -= ny * wa * p;
+		w.vx[c.b] += nx * wb * p; w.vy[c.b] += ny * wb * p;
+	}
+
+	/* one velocity iteration of contact j */
+	void push(world& w, const contact& c, int j){
+		float nx, ny, d, wa, wb;
+		if(!normal(w, c, nx, ny, d)) return;
+		weights(w, c, wa, wb);
+		float vn = (w.vx[c.b] - w.vx[c.a]) * nx + (w.vy[c.b] - w.vy[c.a]) * ny;
+		float p = -vn / (wa + wb);
+		float total = std::max(impulse[j] + p, 0.0f);
+		p = total - impulse[j];
+		impulse[j] = total;
+		if(p != 0) apply(w, c, nx, ny, wa, wb, p);
+	}
+
+	/* one position iteration of a contact, split by inverse mass */
+	void project(world& w, const contact& c) const{
+		float nx, ny, d, wa, wb;
+		if(!normal(w, c, nx, ny, d)) return;
+		float C = d - (w.radius[c.a] + w.radius[c.b]) + slop;
+		if(C >= 0) return;
+		stacked_weights(w, c, ny, wa, wb);
+		float l = -C / (wa + wb);
+		w.px[c.a] -= nx * wa * l; w.py[c.a] -= ny * wa * l;
+		w.px[c.b] += nx * wb * l; w.py[c.b] += ny * wb * l;
+	}
+
+	/* a ball pressed against a wall by the pile stops moving into it */
+	static void walls(world& w, int i){
+		float r = w.radius[i];
+		if(w.px[i] <= r){ w.px[i] = r; w.vx[i] = std::max(w.vx[i], 0.0f); }
+		else if(w.px[i] >= w.width - r){ w.px[i] = w.width - r; w.vx[i] = std::min(w.vx[i], 0.0f); }
+		if(w.py[i] <= r){ w.py[i] = r; w.vy[i] = std::max(w.vy[i], 0.0f); }
+		else if(w.py[i] >= w.height - r){ w.py[i] = w.height - r; w.vy[i] = std::min(w.vy[i], 0.0f); }
+	}
+
+	/* checkColision() has already bounced balls off the walls at full speed.
+	 * a ball left exactly on a wall and moving away from it was just
+	 * reflected there, so that bounce gets the same rest_speed and
+	 * restitution as a contact, or the floor keeps kicking the pile up */
+	void wall_bounce(world& w, int i) const{
+		float r = w.radius[i];
+		auto damp = [&](float v){ return v < rest_speed ? 0.0f : restitution * v; };
+		if(w.py[i] == r && w.vy[i] > 0) w.vy[i] = damp(w.vy[i]);
+		else if(w.py[i] == w.height - r && w.vy[i] < 0) w.vy[i] = -damp(-w.vy[i]);
+		if(w.px[i] == r && w.vx[i] > 0) w.vx[i] = damp(w.vx[i]);
+		else if(w.px[i] == w.width - r && w.vx[i] < 0) w.vx[i] = -damp(-w.vx[i]);
+	}
+
+	template<class F>
+	void each_color(const contact_solver& s, thread_pool& pool, F f){
+		for(int k=0;k<s.colors();k++){
+			int first = s.color_start[k];
+			pool.parallel_for(s.color_start[k + 1] - first, [&](int begin, int end, int){
+				for(int j=first+begin;j<first+end;j++) f(j);
+			});
+		}
+	}
+
+	template<class F>
+	void each_ball(world& w, thread_pool& pool, F f){
+		pool.parallel_for(w.size(), [&](int begin, int end, int){
+			for(int i=begin;i<end;i++){
+				if(w.alive[i] && !w.asleep[i]) f(i);
+			}
+		}, 1024);
+	}
+
+	/* returns the number of contacts that ended with an impulse. gravity
+	 * turns on the mass scaling */
+	int solve(world& w, const contact_solver& s, thread_pool& pool, bool gravity){
+		const std::vector<contact>& cs = s.contacts;
+		int n = (int)cs.size();
+		scale = gravity ? stack : 0.0f;
+		impulse.assign(n, 0.0f);
+		bias.resize(n);
+		each_ball(w, pool, [&](int i){ wall_bounce(w, i); });
+		start_vx.assign(w.vx.begin(), w.vx.end());
+		start_vy.assign(w.vy.begin(), w.vy.end());
+
+		/* the target normal velocity comes from the speed before the solve */
+		warm_started = 0;
+		for(int j=0;j<n;j++){
+			const contact& c = cs[j];
+			float nx, ny, d;
+			float vn = normal(w, c, nx, ny, d) ? (w.vx[c.b] - w.vx[c.a]) * nx + (w.vy[c.b] - w.vy[c.a]) * ny : 0.0f;
+			bias[j] = vn < -rest_speed ? -restitution * vn : 0.0f;
+			if(warm <= 0) continue;
+			unsigned long long k = key(c.a, c.b);
+			auto it = std::lower_bound(prev_keys.begin(), prev_keys.end(), k);
+			if(it != prev_keys.end() && *it == k){
+				impulse[j] = warm * prev_impulse[it - prev_keys.begin()];
+				warm_started++;
+			}
+		}
+		each_color(s, pool, [&](int j){
+			float nx, ny, d, wa, wb;
+			if(impulse[j] <= 0 || !normal(w, cs[j], nx, ny, d)) return;
+			weights(w, cs[j], wa, wb);
+			apply(w, cs[j], nx, ny, wa, wb, impulse[j]);
+		});
+
+		for(int it=0;it<iterations;it++){
+			each_color(s, pool, [&](int j){ push(w, cs[j], j); });
+			each_ball(w, pool, [&](int i){ walls(w, i); });
+		}
+		/* restitution once at the end, only for contacts that hit hard and
+		 * needed an impulse */
+		each_color(s, pool, [&](int j){
+			if(bias[j] <= 0 || impulse[j] <= 0) return;
+			float nx, ny, d, wa, wb;
+			const contact& c = cs[j];
+			if(!normal(w, c, nx, ny, d)) return;
+			weights(w, c, wa, wb);
+			float vn = (w.vx[c.b] - w.vx[c.a]) * nx + (w.vy[c.b] - w.vy[c.a]) * ny;
+			float p = std::max((bias[j] - vn) / (wa + wb), -impulse[j]);
+			impulse[j] += p;
+			apply(w, c, nx, ny, wa, wb, p);
+		});
+		each_ball(w, pool, [&](int i){
+			w.px[i] += w.vx[i] - start_vx[i];
+			w.py[i] += w.vy[i] - start_vy[i];
+			walls(w, i);
+		});
+		start_px.assign(w.px.begin(), w.px.end());
+		start_py.assign(w.py.begin(), w.py.end());
+		for(int it=0;it<position_iterations;it++){
+			each_color(s, pool, [&](int j){ project(w, cs[j]); });
+			each_ball(w, pool, [&](int i){ walls(w, i); });
+		}
+		/* or a ball held up by the pile would keep falling in velocity only */
+		each_ball(w, pool, [&](int i){
+			float dx = w.px[i] - start_px[i], dy = w.py[i] - start_py[i];
+			float along = w.vx[i]*dx + w.vy[i]*dy, d2 = dx*dx + dy*dy;
+			if(along >= 0 || d2 == 0) return;
+			w.vx[i] -= along / d2 * dx;
+			w.vy[i] -= along / d2 * dy;
+		});
+
+		/* remember the impulses for the next step */
+		next.clear();
+		for(int j=0;j<n;j++){
+			if(impulse[j] > 0) next.push_back({key(cs[j].a, cs[j].b), impulse[j]});
+		}
+		keep();
+		return (int)next.size();
+	}
+
+	/* renames the remembered contacts after the world's slots were
+	 * reordered, where maps an old slot to its new one */
+	void remap(const std::vector<int>& where){
+		next.clear();
+		for(int j=0;j<(int)prev_keys.size();j++){
+			int a = where[(int)(prev_keys[j] >> 32)], b = where[(int)(prev_keys[j] & 0xffffffffu)];
+			next.push_back({key(std::min(a, b), std::max(a, b)), prev_impulse[j]});
+		}
+		keep();
+	}
+
+	/* sorts next and keeps it as last step's contacts */
+	void keep(){
+		std::sort(next.begin(), next.end());
+		prev_keys.resize(next.size());
+		prev_impulse.resize(next.size());
+		for(int j=0;j<(int)next.size();j++){
+			prev_keys[j] = next[j].first;
+			prev_impulse[j] = next[j].second;
+		}
+	}
+
+	/* forgets the warm start, used when a recording starts */
+	void reset(){
+		prev_keys.clear();
+		prev_impulse.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,22 @@
+#version 330 core
+in vec2 texCoord;
+out vec4 FragColor;
+
+/* r is the number of balls in the pixel, g their mean speed */
+uniform sampler2D uHeat;
+uniform float uMaxCount;
+
+void main(){
+	vec2 h = texture(uHeat, texCoord).rg;
+	if(h.r <= 0.0){
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+	/* log density sets the brightness, mean speed the hue from blue
+	 * (at rest) to orange, and the densest pixels go white */
+	float d = log(1.0 + h.r) / log(1.0 + max(uMaxCount, 1.0));
+	float s = clamp(h.g / 4.0, 0.0, 1.0);
+	vec3 hue = mix(vec3(0.1, 0.3, 0.9), vec3(1.0, 0.45, 0.1), s);
+	vec3 color = mix(hue * (0.25 + 0.75 * d), vec3(1.0), d * d * 0.5);
+	FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 particleColor;
+out vec4 FragColor;
+
+void main(){
+	/* round points, the corners of the square sprite are dropped */
+	vec2 p = gl_PointCoord * 2.0 - 1.0;
+	if(dot(p, p) > 1.0) discard;
+	FragColor = vec4(particleColor, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in float aRadius;
+layout (location = 2) in vec3 aColor;
+out vec3 particleColor;
+
+uniform mat4 uProjection;
+
+void main(){
+	gl_Position = uProjection * vec4(aPos, 0.0, 1.0);
+	gl_PointSize = max(2.0 * aRadius, 1.0);
+	particleColor = aColor;
+}